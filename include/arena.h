@@ -0,0 +1,133 @@
+#ifndef DC_SHELL_ARENA_H
+#define DC_SHELL_ARENA_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dc_posix/dc_posix_env.h>
+#include <stddef.h>
+
+/**
+ * The size of the first block when no size is given.
+ */
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+
+/*! \struct arena_block
+    \brief A chunk of memory that allocations are carved out of.
+*/
+struct arena_block
+{
+  struct arena_block *next; /**< the block that was filled before this one */
+  size_t size;              /**< the number of bytes in data */
+  size_t used;              /**< the number of bytes handed out from data */
+  max_align_t data[];       /**< the memory handed out */
+};
+
+/*! \struct arena
+    \brief A bump pointer allocator, everything it hands out is released at once by arena_reset.
+*/
+struct arena
+{
+  struct arena_block *blocks;   /**< the block being allocated from, followed by the full ones */
+  size_t block_size;            /**< the smallest block to allocate */
+  size_t allocated;             /**< the bytes handed out since the last reset */
+  size_t high_water_mark;       /**< the most bytes handed out between two resets */
+  size_t block_allocations;     /**< the number of blocks allocated over the life of the arena */
+  void *last;                   /**< the most recent allocation, it can grow in place */
+};
+
+/**
+ * Create an arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param block_size the size of the first block, 0 for ARENA_DEFAULT_BLOCK_SIZE.
+ * @return the arena, destroy it with arena_destroy.
+ */
+struct arena *arena_create(const struct dc_posix_env *env, struct dc_error *err, size_t block_size);
+
+/**
+ * Allocate memory from the arena. The memory is suitably aligned for any type and is not initialized.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param size the number of bytes.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_alloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, size_t size);
+
+/**
+ * Allocate zeroed memory for an array from the arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param count the number of elements.
+ * @param size the size of each element.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_calloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, size_t count,
+                   size_t size);
+
+/**
+ * Grow an allocation. The most recent allocation grows in place when the block has room,
+ * anything else is copied to a new allocation.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param ptr the memory to grow, may be NULL.
+ * @param old_size the current size of ptr.
+ * @param new_size the size required.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_realloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, void *ptr,
+                    size_t old_size, size_t new_size);
+
+/**
+ * Copy a string into the arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param str the string to copy.
+ * @param length the number of characters to copy.
+ * @return the NUL terminated copy, valid until the next arena_reset.
+ */
+char *arena_strndup(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, const char *str,
+                    size_t length);
+
+/**
+ * Release everything allocated from the arena. If the allocations spilled over into more than
+ * one block the blocks are freed and the next block is made big enough to hold them all, so a
+ * steady workload settles on one block and no allocations.
+ *
+ * @param env the posix environment.
+ * @param arena the arena.
+ */
+void arena_reset(const struct dc_posix_env *env, struct arena *arena);
+
+/**
+ * Free the arena and all of its blocks and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param parena the arena to destroy, may point at NULL.
+ */
+void arena_destroy(const struct dc_posix_env *env, struct arena **parena);
+
+#endif // DC_SHELL_ARENA_H
@@ -19,20 +19,291 @@
  */
 
 #include "execute.h"
+#include "path_cache.h"
+#include "state.h"
 #include <dc_posix/dc_posix_env.h>
 
+/**
+ * The builtin changes the shell itself, so it must run in the shell process rather than a child.
+ * pipeline_run refuses to start it in a pipeline or in the background.
+ */
+#define BUILTIN_PARENT 0x01
+
+/**
+ * The builtin only reads its arguments and writes to its streams, so it can run in a pipeline stage.
+ */
+#define BUILTIN_PIPELINE 0x02
+
+/**
+ * The shell exits after the builtin runs.
+ */
+#define BUILTIN_EXIT 0x04
+
+/**
+ * The builtin applies the redirections of the command itself, builtin_run leaves them alone.
+ */
+#define BUILTIN_REDIRECTS 0x08
+
+/**
+ * A function that runs a builtin. The state gives it the streams to use and the shell data it
+ * may change. On failure the builtin prints its own message and sets command->exit_code, err is
+ * only left set for errors that should stop the shell.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell the command runs in
+ */
+typedef void (*builtin_handler)(const struct dc_posix_env *env, struct dc_error *err,
+                                struct command *command, struct state *state);
+
+/*! \struct builtin
+    \brief A command the shell runs itself instead of searching the path.
+*/
+struct builtin
+{
+  const char *name;             /**< the command name */
+  builtin_handler handler;      /**< the function that runs it */
+  unsigned int flags;           /**< BUILTIN_PARENT, BUILTIN_PIPELINE, BUILTIN_EXIT and BUILTIN_REDIRECTS */
+};
+
+/**
+ * Find the builtin for a command name.
+ * The builtins are kept in one array sorted by name, so adding one is a single entry there.
+ *
+ * @param env the posix environment.
+ * @param name the command name.
+ * @return the builtin or NULL if name is not a builtin.
+ */
+const struct builtin *builtin_find(const struct dc_posix_env *env, const char *name);
+
+/**
+ * Get every builtin, sorted by name.
+ *
+ * @param count set to the number of builtins.
+ * @return the builtins.
+ */
+const struct builtin *builtin_list(size_t *count);
+
+/**
+ * Run a builtin in the shell process. The stdout and stderr redirections of the command are
+ * opened and given to the builtin as state->stdout and state->stderr, and put back afterwards,
+ * so no child is needed. A stdin redirection is opened so a missing file fails like it would
+ * for a program.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only left set for errors that should stop the shell.
+ * @param builtin the builtin to run.
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_run(const struct dc_posix_env *env, struct dc_error *err, const struct builtin *builtin,
+                 struct command *command, struct state *state);
+
 /**
  * Change the working directory.
  * ~ is converted to the users home directory.
  * - no arguments is converted to the users home directory.
- * The command->exit_code is set to 0 on success or error->errno_code on failure.
+ * The command->exit_code is set to 0 on success or 1 on failure, a failure is not an err.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param command the command information
- * @param errstream the stream to print error messages to
+ * @param state the shell, error messages are printed to state->stderr and the new directory is kept in state->cwd,
+ *              the relative directories of state->path are opened again in state->path_cache
  */
 void builtin_cd(const struct dc_posix_env *env, struct dc_error *err,
-                struct command *command, FILE *errstream);
+                struct command *command, struct state *state);
+
+/**
+ * Show or change the command path cache.
+ * - no arguments lists the cached commands and their hit counts.
+ * - -r empties the cache.
+ * - -s shows the hits, misses and number of entries, and the same for names that were not found.
+ * - names are looked up and added to the cache.
+ * The command->exit_code is set to 0 on success, 1 if a name was not found or 2 for a bad option.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, names are searched for in state->path and kept in state->path_cache
+ */
+void builtin_hash(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Apply the redirections of the command to the shell itself, for every command after it.
+ * - n>file, n>>file and n<file open the file once and keep it on n for the rest of the session.
+ * - n>&m copies m to n, n>&- closes n.
+ * The descriptors are left open across exec, so every child inherits them and >&n in a later
+ * command is a dup2 instead of an open. They are listed in state->fds. A descriptor the shell
+ * uses itself, such as the one it reads commands from, is not changed. Running a program in
+ * place of the shell is not supported.
+ * The command->exit_code is set to 0 on success, 1 if a redirection failed or 2 for an argument.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the descriptors that were changed are kept in state->fds
+ */
+void builtin_exec(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Leave the shell, the command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_exit(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Do nothing successfully, the command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_true(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Do nothing unsuccessfully, the command->exit_code is set to 1.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_false(const struct dc_posix_env *env, struct dc_error *err,
+                   struct command *command, struct state *state);
+
+/**
+ * Print the arguments separated by spaces and followed by a newline to state->stdout.
+ * A first argument of -n leaves off the newline. The command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_echo(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Print the arguments to state->stdout under the control of the format (the first argument).
+ * The escapes \\ \a \b \f \n \r \t \v and \NNN and the conversions %d %i %o %u %x %X %c %s
+ * %b and %% are understood, with the - + space # and 0 flags, a width and a precision.
+ * The format is used again while arguments are left, missing arguments are "" or 0.
+ * The command->exit_code is set to 0, 1 if an argument was not a number or the format was bad,
+ * or 2 if there was no format.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_printf(const struct dc_posix_env *env, struct dc_error *err,
+                    struct command *command, struct state *state);
+
+/**
+ * Print the working directory to state->stdout, the one of the prompt (see current_directory).
+ * The command->exit_code is set to 0, or 1 if the directory could not be found.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, state->cwd is set if the directory was read again
+ */
+void builtin_pwd(const struct dc_posix_env *env, struct dc_error *err,
+                 struct command *command, struct state *state);
+
+/**
+ * Evaluate a conditional expression of the arguments (see test(1)).
+ * The command->exit_code is set to 0 if it is true, 1 if it is false or 2 if it is not valid.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_test(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * The [ form of builtin_test, the last argument must be ].
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_bracket(const struct dc_posix_env *env, struct dc_error *err,
+                     struct command *command, struct state *state);
+
+/**
+ * Show or change the shell options, the only option is pipefail.
+ * - no arguments or -o lists the options and if they are on.
+ * - -o name turns the option on, +o name turns it off.
+ * The command->exit_code is set to 0 on success or 2 for a bad option.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the options are in state->settings
+ */
+void builtin_set(const struct dc_posix_env *env, struct dc_error *err,
+                 struct command *command, struct state *state);
+
+/**
+ * List the jobs started with & and their state, Running, Done or Exit and the code.
+ * The jobs that finished are forgotten once they are listed. The command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the jobs are in state->jobs
+ */
+void builtin_jobs(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
+
+/**
+ * Run a command once for each input, up to a number at a time (see parallel_run).
+ * parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]
+ * - the inputs are the words after :::, or else the lines of the file of -a, the stdin
+ *   redirection of the command or the stdin of the shell.
+ * - -j is how many run at once, the number of online CPUs by default.
+ * - -v prints the exit code and resource usage of each command to stderr.
+ * The command is a program, {} in a word is replaced by the input, without one the input is
+ * added as the last argument. The command->exit_code is set to the number that failed (up to
+ * PARALLEL_MAX_FAILED), or 2 for bad arguments.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_parallel(const struct dc_posix_env *env, struct dc_error *err,
+                      struct command *command, struct state *state);
+
+/**
+ * Wait for jobs started with & and forget them.
+ * - no arguments waits for every job, the command->exit_code is set to 0.
+ * - -n waits for the next job to finish, or takes one that already finished, and sets the
+ *   command->exit_code to its exit code, or 127 if there are no jobs.
+ * - %id or pid waits for each job and sets the command->exit_code to the exit code of the last,
+ *   or 127 if one is not a job.
+ *
+ * @param env the posix environment.
+ * @param err the error object, set if waiting failed.
+ * @param command the command information
+ * @param state the shell, the jobs are in state->jobs
+ */
+void builtin_wait(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state);
 
 #endif // DC_SHELL_BUILTINS_H
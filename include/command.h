@@ -21,42 +21,116 @@
 #include "state.h"
 #include <dc_posix/dc_posix_env.h>
 
+struct path_cache_entry;
+
+/*! \enum command_separator
+    \brief What ends a command on the line, and so how it joins the command after it.
+*/
+enum command_separator
+{
+  SEPARATOR_END,        /**< the command is the last on the line */
+  SEPARATOR_PIPE,       /**< | the output of the command is the input of the next */
+  SEPARATOR_SEQUENCE,   /**< ; the next pipeline runs after this one */
+  SEPARATOR_AND,        /**< && the next pipeline runs if this one succeeded */
+  SEPARATOR_OR,         /**< || the next pipeline runs if this one failed */
+  SEPARATOR_BACKGROUND, /**< & the pipeline is a job, the next one runs without waiting for it */
+};
+
+/*! \enum redirection_type
+    \brief What a redirection does to its descriptor.
+*/
+enum redirection_type
+{
+  REDIRECT_INPUT,       /**< n<file open the file for reading */
+  REDIRECT_OUTPUT,      /**< n>file create or truncate the file */
+  REDIRECT_APPEND,      /**< n>>file create or append to the file */
+  REDIRECT_DUP,         /**< n>&m or n<&m make n a copy of m */
+  REDIRECT_CLOSE,       /**< n>&- or n<&- close n */
+  REDIRECT_HERE_DOC,    /**< n<<word read the lines after the command line up to one that is the word */
+  REDIRECT_HERE_STRING, /**< n<<<word read the word and a newline */
+};
+
+/*! \struct redirection
+    \brief One redirection of a command, they are applied in the order they are on the line.
+*/
+struct redirection
+{
+  enum redirection_type type; /**< what is done to fd */
+  int fd;                   /**< the descriptor that is redirected */
+  char *target;             /**< the file or here-string, the text of the descriptor for REDIRECT_DUP, the
+                                 delimiter of REDIRECT_HERE_DOC until parse_commands replaces it with the body */
+  int target_fd;            /**< REDIRECT_DUP the descriptor fd becomes a copy of, -1 otherwise */
+};
+
+/**
+ * The err_code raised when a command line cannot be parsed (the exit status sh uses for syntax errors).
+ */
+#define PARSE_ERROR 2
+
 /*! \struct command
-    \brief The commands to enter, currently there is only one.
+    \brief One command of the line, a stage of a pipeline.
 
-    The state passed around to the FSM functions.
+    The separator says how it joins the next command in state->command.
 */
 struct command
 {
-  char *line;               /**< the current command line */
+  char *line;               /**< the current command line, the buffer the parsed fields point into */
   char *command;            /**< the program/builtin to run */
+  const struct path_cache_entry *program; /**< where command was found, NULL to search the path (see path_cache_lookup) */
   size_t argc;              /**< the number of arguments to the command */
   char **argv;              /**< the arguments to the command, arg[0] must be NULL */
-  char *stdin_file;         /**< the file to redirect stdin from */
-  char *stdout_file;        /**< the file to redirect stdout to */
-  bool stdout_overwrite;    /**< append or overwrite the stdout file (true = overwrite) */
-  char *stderr_file;        /**< the file to redirect strderr to */
-  bool stderr_overwrite;    /**< append or overwrite the strerr file (true = overwrite) */
+  struct redirection *redirections; /**< the redirections, in the order they are applied */
+  size_t redirection_count; /**< the number of redirections */
   int exit_code;            /**< the exit code from the program/builtin */
+  enum command_separator separator; /**< what follows the command on the line */
+  struct arena *arena;      /**< the arena that owns the fields, NULL if destroy_command must free them */
 };
 
 /**
  * Parse the command. Take the command->line and use it to fill in all of the fields.
+ * The line is scanned once by the lexer (see lexer_next), words become the command and
+ * its arguments, and the word after a redirection operator becomes the redirection target.
+ * A leading ~ in a redirection target is expanded to the users home directory. The word after <<
+ * is the delimiter of a here-document, the body is read later by parse_commands.
+ * Nothing is copied: the words are unquoted and NUL terminated in place, so command->command,
+ * command->argv and the redirection targets point into command->line, which no longer holds the
+ * original text afterwards. argv, the redirections and expanded file names are allocated from
+ * state->arena and live until the next reset_state.
+ * A malformed line, or a >& or <& that is not followed by a descriptor or -, raises a PARSE_ERROR
+ * user error. A ~ that cannot be expanded (no HOME or no such user) only fails the command: the
+ * error is printed to state->stderr and command->exit_code is set to 1, so pipeline_run skips it.
  *
  * @param env the posix environment.
  * @param err the error object.
- * @param state the current state, to set the fatal_error and access the command line and regex for redirection.
+ * @param state the current state, to set the fatal_error.
  * @param command the command to parse.
  */
 void parse_command(const struct dc_posix_env *env, struct dc_error *err,
                    struct state *state, struct command *command);
 
-char* trim(const char* str);
+/**
+ * Add a redirection after the ones the command has. The redirections of a parsed command grow in
+ * command->arena, a command built by hand with command->arena set to NULL owns them and the target.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param command the command.
+ * @param type what the redirection does.
+ * @param fd the descriptor that is redirected.
+ * @param target the file or here-string, NULL for REDIRECT_DUP and REDIRECT_CLOSE.
+ * @param target_fd the descriptor REDIRECT_DUP copies, -1 otherwise.
+ */
+void command_add_redirection(const struct dc_posix_env *env, struct dc_error *err, struct command *command,
+                             enum redirection_type type, int fd, char *target, int target_fd);
 
 /**
+ * Free the fields of the command and set them to NULL, 0 or false.
+ * A parsed command owns nothing: line, argv and the redirections belong to command->arena, and
+ * command, the arguments and the redirection targets point into line, so the fields are only cleared.
+ * A command built by hand with command->arena set to NULL owns each field, and they are freed.
  *
- * @param env
- * @param command
+ * @param env the posix environment.
+ * @param command the command to destroy, may be NULL.
  */
 void destroy_command(const struct dc_posix_env *env, struct command *command);
 
@@ -20,42 +20,167 @@
 
 #include "command.h"
 #include <dc_posix/dc_posix_env.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
+#include <sys/types.h>
+
+struct path_cache_entry;
+
+/*! \struct exec_dup
+    \brief A dup2 the child makes before the exec.
+*/
+struct exec_dup
+{
+  int from;                 /**< the open descriptor, -1 to close to */
+  int to;                   /**< the descriptor the program gets it on */
+  bool opened;              /**< from was opened for a redirection, the plan closes it */
+};
+
+/*! \struct exec_plan
+    \brief Everything a child needs to exec a command, worked out by the shell before it starts the child.
+
+    The shell resolves the program, opens the redirections and lists the dup2s, so the child only
+    sets its signal mask, makes the dup2s and execs (see exec_plan_run). The dup2s are the std_fds
+    followed by the redirections of the command in order, so 2>&1 after >file copies the file. Nothing in the child
+    allocates or takes a lock, so it is safe after fork in a threaded process and after vfork, and
+    it touches as few pages of the shell as it can.
+*/
+struct exec_plan
+{
+  const struct path_cache_entry *program; /**< the entry of a command found by the path cache, or NULL */
+  char file[PATH_MAX];      /**< the file to exec */
+  char **argv;              /**< the arguments, argv[0] is the command */
+  char **envp;              /**< the environment */
+  struct exec_dup *dups;    /**< the dup2s, in order */
+  size_t dup_count;         /**< the number of dup2s */
+  sigset_t mask;            /**< the signal mask of the child */
+  int error;                /**< the errno if there is nothing to exec, ENOENT if the command was not found */
+};
 
 /**
  * Create a child process, exec the command with any redirection, set the exit code.
- * If there is an err executing the command print an err message.
- * If the command cannot be found set the command->exit_code to 127.
+ * If there is an err executing the command print an err message to stderr.
+ * If the command cannot be found set the command->exit_code to 127, 126 if it cannot be run.
+ * A command->program that was already resolved is exec'd without searching the path.
+ *
+ * Every backend runs a plan made by the shell (see exec_plan_init). SPAWN_POSIX_SPAWN and
+ * SPAWN_VFORK start the child without copying the page tables of the shell, SPAWN_FORK copies them.
  *
  * @param env the posix environment.
  * @param err the err object
  * @param command the command to execute
  * @param path the directories to search for the command
+ * @param backend how to create the child process
  */
-void execute(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path);
+void execute(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path,
+             enum spawn_backend backend);
 
 /**
+ * Start a child for the command without waiting for it, so the stages of a pipeline run at the
+ * same time. The child reads from std_fds[0] and writes to std_fds[1] and std_fds[2], unless the
+ * command redirects them to a file. The std_fds are left open, they should be O_CLOEXEC so only
+ * the copies on 0, 1 and 2 reach the program.
+ * If the command could not be started the command->exit_code is set and -1 is returned.
  *
- * @param err
- * @return
+ * @param env the posix environment.
+ * @param err the err object
+ * @param command the command to execute
+ * @param path the directories to search for the command
+ * @param backend how to create the child process
+ * @param std_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ * @param messages where to print why the command could not be started, the state->stderr of the shell.
+ * @return the child to pass to execute_wait, or -1.
  */
-int handle_run_error(struct dc_error *err);
+pid_t execute_start(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path,
+                    enum spawn_backend backend, const int std_fds[3], FILE *messages);
 
 /**
+ * Wait for the child and set the command->exit_code, 128 + the signal if it was killed.
  *
- * @param env
- * @param err
- * @param command
+ * @param env the posix environment.
+ * @param err the err object
+ * @param command the command that the child is running.
+ * @param pid the child.
+ */
+void execute_wait(const struct dc_posix_env *env, struct dc_error *err, struct command *command, pid_t pid);
+
+/**
+ * Print why a command could not be run and get its exit code.
+ *
+ * @param messages the stream to print to.
+ * @param name the command.
+ * @param error the errno from resolving or starting the command.
+ * @return 127 if the command was not found, 126 if it was found but could not be run.
+ */
+int handle_run_error(FILE *messages, const char *name, int error);
+
+/**
+ * Plan the exec of a command: open its redirections, find the file to exec and list the dup2s,
+ * a redirection wins over std_fds. A command that is not found sets plan->error, the
+ * plan is still destroyed with exec_plan_destroy.
+ *
+ * @param env the posix environment.
+ * @param err the err object, set if a redirection could not be opened (nothing is left open).
+ * @param plan the plan to fill in.
+ * @param command the command, command->argv[0] is set to command->command.
+ * @param path the directories to search for a command without a / that has no command->program.
+ * @param std_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ */
+void exec_plan_init(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan,
+                    struct command *command, char **path, const int std_fds[3]);
+
+/**
+ * Carry out a plan in a child: set the signal mask, make the dup2s and exec. Only makes
+ * async-signal-safe calls. Only returns if something failed.
+ *
+ * @param plan the plan.
+ * @return the errno of what failed.
+ */
+int exec_plan_run(const struct exec_plan *plan);
+
+/**
+ * Close the redirections a plan opened, once the child has started.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param plan the plan.
+ */
+void exec_plan_destroy(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan);
+
+/**
+ * List the dup2s for std_fds and the redirections of the command, in order, opening the files and
+ * the text of here-documents and here-strings with O_CLOEXEC so only the copies the child dup2s
+ * survive the exec. They are opened above every descriptor that is redirected, so no dup2
+ * overwrites one before it is copied.
+ *
+ * @param env the posix environment.
+ * @param err the err object, set if a file could not be opened or a >&m copies a descriptor that
+ *            is not open (nothing is left open).
+ * @param command the command.
+ * @param std_fds the stdin, stdout and stderr of the child, -1 or NULL to use the ones of the shell.
+ * @param plan set to the dup2s, close them with close_redirections.
+ */
+void open_redirections(const struct dc_posix_env *env, struct dc_error *err, const struct command *command,
+                       const int std_fds[3], struct exec_plan *plan);
+
+/**
+ * Close the files opened by open_redirections and forget the dup2s.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param plan the plan.
  */
-void redirect(const struct dc_posix_env *env, struct dc_error *err, struct command *command);
+void close_redirections(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan);
 
 /**
+ * Follow the dup2s of a plan back to the descriptor of the shell that a descriptor ends up as,
+ * for a builtin that runs in the shell without making them.
  *
- * @param env
- * @param err
- * @param command
- * @param path
+ * @param plan the plan.
+ * @param fd the descriptor.
+ * @return the descriptor of the shell, fd itself if it is not redirected, -1 if it is closed.
  */
-void run(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path);
+int redirected_fd(const struct exec_plan *plan, int fd);
 
 #endif // DC_SHELL_EXECUTE_H
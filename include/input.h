@@ -20,17 +20,176 @@
 
 #include <dc_posix/dc_posix_env.h>
 #include <dc_posix/dc_stdlib.h>
+#include <stdbool.h>
 #include <stdio.h>
 
+/*! \struct script
+    \brief A script file mapped read-only, read a line at a time as views into the mapping.
+
+    Nothing is copied or allocated per line and the file is not read through stdio, the pages are
+    faulted in as the lines are reached, so a large script starts running at once.
+*/
+struct script
+{
+  char *data;                   /**< the mapped file, PROT_READ, NULL if it is empty */
+  size_t length;                /**< the size of the file */
+  size_t offset;                /**< where the next line starts */
+};
+
+/**
+ * The first size of the buffer of a line_reader, it grows for a longer line.
+ */
+#define LINE_READER_CAPACITY 65536
+
+/*! \struct line_reader
+    \brief The lines of a descriptor, read a buffer at a time and returned as views into the buffer.
+
+    The buffer is kept from line to line, so nothing is allocated per line, and a line is found
+    with memchr over the bytes that were not searched yet. What is left of a line at the end of
+    the buffer is moved to the front before the next read, the buffer only grows for a line
+    longer than it.
+*/
+struct line_reader
+{
+  int fd;                       /**< the descriptor, not closed by line_reader_destroy */
+  char *buffer;                 /**< the bytes read and not returned yet are from start to end */
+  size_t capacity;              /**< the size of buffer */
+  size_t start;                 /**< where the next line starts */
+  size_t scanned;               /**< there is no newline from start up to here */
+  size_t end;                   /**< the end of the bytes read */
+  bool eof;                     /**< the descriptor was read to the end */
+};
+
 /**
  * Read the command line from the user.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param stream The stream to read from (eg. stdin)
- * @param line_size the maximum characters to read.
- * @return The command line that the user entered.
+ * @param line_size set to the length of the line.
+ * @return The command line that the user entered, trimmed, empty at the end of the stream.
  */
 char *read_command_line(const struct dc_posix_env *env, struct dc_error *err, FILE *stream, size_t *line_size);
 
+/**
+ * Read the body of a here-document, the lines up to one that is only the delimiter. The lines are
+ * kept as they are, newlines included, and the end of the stream ends the body like the delimiter.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param stream the stream the command line was read from.
+ * @param delimiter the word after the <<.
+ * @param prompt the stream to print "> " on before each line, NULL for none.
+ * @param length set to the number of characters in the body.
+ * @return the body, NUL terminated, free it with dc_free.
+ */
+char *read_here_document(const struct dc_posix_env *env, struct dc_error *err, FILE *stream, const char *delimiter,
+                         FILE *prompt, size_t *length);
+
+/**
+ * Create a reader for the lines of a descriptor.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param fd the descriptor.
+ * @param capacity the first size of the buffer, LINE_READER_CAPACITY unless there is a reason.
+ * @return the reader, destroy it with line_reader_destroy.
+ */
+struct line_reader *line_reader_create(const struct dc_posix_env *env, struct dc_error *err, int fd, size_t capacity);
+
+/**
+ * Free a reader and set it to NULL. The descriptor is left open.
+ *
+ * @param env the posix environment.
+ * @param preader the reader, may point at NULL.
+ */
+void line_reader_destroy(const struct dc_posix_env *env, struct line_reader **preader);
+
+/**
+ * Get the next line as it was read, with its newline unless it is the last and has none.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, valid until the next call on the reader, NULL at the end or on error.
+ */
+const char *line_reader_next_line(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                  size_t *length);
+
+/**
+ * Get the next line trimmed like read_command_line, without copying it.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, valid until the next call on the reader, NULL at the end or on error.
+ */
+const char *line_reader_read_line(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                  size_t *length);
+
+/**
+ * Read the body of a here-document from a reader, as read_here_document does from a stream.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader the command line was read from.
+ * @param delimiter the word after the <<.
+ * @param prompt the stream to print "> " on before each line, NULL for none.
+ * @param length set to the number of characters in the body.
+ * @return the body, NUL terminated, free it with dc_free.
+ */
+char *line_reader_read_here_document(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                     const char *delimiter, FILE *prompt, size_t *length);
+
+/**
+ * Check if the next line can be had without waiting for the descriptor.
+ *
+ * @param reader the reader.
+ * @return true if a whole line is buffered or the descriptor was read to the end.
+ */
+bool line_reader_has_line(const struct line_reader *reader);
+
+/**
+ * Map a script file read-only.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param path the file.
+ * @return the script, close it with script_close, NULL on error.
+ */
+struct script *script_open(const struct dc_posix_env *env, struct dc_error *err, const char *path);
+
+/**
+ * Unmap a script and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param pscript the script, may point at NULL.
+ */
+void script_close(const struct dc_posix_env *env, struct script **pscript);
+
+/**
+ * Get the next line of a script, trimmed like read_command_line, without copying it.
+ *
+ * @param script the script.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, inside the mapping, or NULL at the end of the script.
+ */
+const char *script_read_line(struct script *script, size_t *length);
+
+/**
+ * Get the body of a here-document from a script, the lines up to one that is only the delimiter,
+ * as read_here_document does for a stream. The body is the lines as they are in the file, so it
+ * is not copied.
+ *
+ * @param env the posix environment.
+ * @param script the script, the line with the << was read already.
+ * @param delimiter the word after the <<.
+ * @param length set to the number of characters in the body.
+ * @return the body, inside the mapping and not NUL terminated.
+ */
+const char *script_read_here_document(const struct dc_posix_env *env, struct script *script, const char *delimiter,
+                                     size_t *length);
+
 #endif // DC_SHELL_INPUT_H
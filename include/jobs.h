@@ -0,0 +1,227 @@
+#ifndef DC_SHELL_JOBS_H
+#define DC_SHELL_JOBS_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dc_posix/dc_posix_env.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+struct reactor;
+
+/**
+ * The number of jobs there is room for in a new table, it doubles as the table fills.
+ */
+#define JOB_TABLE_INITIAL_CAPACITY 8
+
+/**
+ * The exit code of a stage that has not been reaped yet.
+ */
+#define JOB_RUNNING (-1)
+
+/*! \struct job
+    \brief A pipeline started with & and the exit code of each of its stages.
+*/
+struct job
+{
+  int id;                   /**< the number jobs prints and wait takes as %id */
+  char *text;               /**< the commands of the pipeline, for jobs */
+  pid_t *pids;              /**< the process of each stage, -1 for a stage that never started */
+  int *exit_codes;          /**< the exit code of each stage, JOB_RUNNING until it is reaped */
+  int *pidfds;              /**< a pidfd for each running stage, -1 where there is none */
+  size_t count;             /**< the number of stages */
+  size_t running;           /**< the number of stages that have not been reaped */
+  bool pipefail;            /**< the status is the last stage that failed, not the last stage */
+};
+
+/*! \struct job_table
+    \brief The jobs of the shell, in the order they were started.
+
+    The table blocks SIGCHLD while it exists and reads it from a signalfd (where there is one),
+    so a finished child is noticed without a signal handler and reaped the next time the shell
+    looks (see job_table_reap), never while it is waiting for a line. Only the pids of jobs are
+    waited for, a pipeline running in the foreground reaps its own children.
+
+    Once the table watches a reactor each stage of a job gets a pidfd in it, so the shell waiting
+    for a line wakes for the child that exited and reaps just that one (see job_table_reap_pid).
+    Where there are no pidfds the SIGCHLD signalfd is watched instead.
+*/
+struct job_table
+{
+  struct job *jobs;         /**< the jobs */
+  size_t count;             /**< the number of jobs */
+  size_t capacity;          /**< the number of jobs there is room for */
+  size_t max_running;       /**< the most jobs that run at once, 0 for no limit */
+  int signal_fd;            /**< readable when SIGCHLD is pending, -1 if there is no signalfd */
+  struct reactor *reactor;  /**< where the pidfds are watched, NULL to not open them */
+  bool watching_sigchld;    /**< the reactor watches signal_fd, there are no pidfds */
+  sigset_t old_mask;        /**< the signal mask before SIGCHLD was blocked */
+};
+
+/**
+ * Create an empty table and block SIGCHLD.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param max_running the most jobs that run at once, 0 for no limit.
+ * @return the table, destroy it with job_table_destroy.
+ */
+struct job_table *job_table_create(const struct dc_posix_env *env, struct dc_error *err, size_t max_running);
+
+/**
+ * Free the table, without waiting for the jobs, restore the signal mask and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param ptable the table to destroy, may point at NULL.
+ */
+void job_table_destroy(const struct dc_posix_env *env, struct job_table **ptable);
+
+/**
+ * Watch the stages of the jobs added from now on in a reactor, with a pidfd each.
+ *
+ * @param table the table.
+ * @param reactor the reactor, it must outlive the table.
+ */
+void job_table_watch(struct job_table *table, struct reactor *reactor);
+
+/**
+ * Forget every job without waiting for it. A forked child calls this, the jobs are not its children.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ */
+void job_table_clear(const struct dc_posix_env *env, struct job_table *table);
+
+/**
+ * Add a job for the stages of a pipeline that was started.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @param text the commands of the pipeline, copied.
+ * @param pids the process of each stage, -1 for a stage that never started.
+ * @param exit_codes the exit code of each stage that never started, the others are ignored.
+ * @param count the number of stages.
+ * @param pipefail the status of the job is the last stage that failed.
+ * @return the id of the job, 0 if it could not be added.
+ */
+int job_table_add(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                  const char *text, const pid_t *pids, const int *exit_codes, size_t count, bool pipefail);
+
+/**
+ * Remove a job from the table.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ * @param job the job, a pointer into table->jobs that is not valid afterwards.
+ */
+void job_table_remove(const struct dc_posix_env *env, struct job_table *table, struct job *job);
+
+/**
+ * Find a job by %id, or by the pid of one of its stages.
+ *
+ * @param table the table.
+ * @param spec %id or a pid.
+ * @return the job, NULL if there is none.
+ */
+struct job *job_table_find(struct job_table *table, const char *spec);
+
+/**
+ * Find the job that was started first of the ones that finished.
+ *
+ * @param table the table.
+ * @return the job, NULL if every job is running.
+ */
+struct job *job_table_find_done(struct job_table *table);
+
+/**
+ * Count the jobs that have a stage that has not been reaped.
+ *
+ * @param table the table.
+ * @return the number of running jobs.
+ */
+size_t job_table_running(const struct job_table *table);
+
+/**
+ * Reap every stage of every job that finished, without blocking.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @return the number of processes reaped.
+ */
+size_t job_table_reap(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table);
+
+/**
+ * Reap the stage of a job with the pid if it finished, without blocking.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @param pid the stage, -1 to reap every stage that finished (see job_table_reap).
+ * @return the number of processes reaped.
+ */
+size_t job_table_reap_pid(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table, pid_t pid);
+
+/**
+ * Block until a stage of a job finishes and reap it, nothing is done if no job is running.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table);
+
+/**
+ * Block until a SIGCHLD arrives and read it. One that arrived since the last read returns at once,
+ * so a child that exits after its WNOHANG check is not missed. The caller checks its children again.
+ *
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait_sigchld(struct dc_error *err, const struct job_table *table);
+
+/**
+ * Block until there are fewer than max_running jobs running, so another can start.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait_for_slot(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table);
+
+/**
+ * Print each job with its state, Running, Done or Exit and the code, and forget the ones that finished.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ * @param stream where to print.
+ */
+void job_table_report(const struct dc_posix_env *env, struct job_table *table, FILE *stream);
+
+/**
+ * Get the exit code of a job that finished, the last stage or the last that failed with pipefail.
+ *
+ * @param job the job.
+ * @return the exit code.
+ */
+int job_status(const struct job *job);
+
+#endif // DC_SHELL_JOBS_H
@@ -0,0 +1,137 @@
+#ifndef DC_SHELL_LEXER_H
+#define DC_SHELL_LEXER_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*! \enum token_type
+    \brief The kinds of token the lexer produces.
+*/
+enum token_type
+{
+  TOKEN_END,            /**< there are no more tokens on the line */
+  TOKEN_ERROR,          /**< the line is malformed (eg. an unterminated quote) */
+  TOKEN_WORD,           /**< a command, argument or redirection target */
+  TOKEN_REDIRECT_IN,    /**< < or n< */
+  TOKEN_REDIRECT_OUT,   /**< > or n> (but not 2>) */
+  TOKEN_APPEND_OUT,     /**< >> or n>> (but not 2>>) */
+  TOKEN_REDIRECT_ERR,   /**< 2> */
+  TOKEN_APPEND_ERR,     /**< 2>> */
+  TOKEN_DUP_IN,         /**< <& or n<& */
+  TOKEN_DUP_OUT,        /**< >& or n>& */
+  TOKEN_HERE_DOC,       /**< << or n<< */
+  TOKEN_HERE_STRING,    /**< <<< or n<<< */
+  TOKEN_PIPE,           /**< | */
+  TOKEN_SEQUENCE,       /**< ; */
+  TOKEN_AND,            /**< && */
+  TOKEN_OR,             /**< || */
+  TOKEN_BACKGROUND,     /**< & */
+};
+
+/*! \enum lexer_scanner
+    \brief How the lexer finds the end of the plain run of characters in a word.
+*/
+enum lexer_scanner
+{
+  LEXER_SCAN_SCALAR,    /**< a character at a time, on any CPU */
+  LEXER_SCAN_SSE2,      /**< 16 characters at a time (x86-64) */
+  LEXER_SCAN_AVX2,      /**< 32 characters at a time, if the CPU has AVX2 (x86-64) */
+};
+
+/*! \struct token
+    \brief A token is a view into the line being scanned, nothing is copied.
+*/
+struct token
+{
+  enum token_type type; /**< the kind of token */
+  const char *text;     /**< the first character of the token in the line */
+  size_t length;        /**< the number of characters in the token, quotes included */
+};
+
+/*! \struct lexer
+    \brief The position of a single pass scan over a command line.
+*/
+struct lexer
+{
+  const char *line;     /**< the line being scanned */
+  size_t length;        /**< the number of characters in the line */
+  size_t position;      /**< the offset of the first character that has not been scanned */
+  enum lexer_scanner scanner; /**< how words are scanned, lexer_best_scanner unless it is set after lexer_init */
+};
+
+/**
+ * Get the scanner lexer_init uses. AVX2 is not picked even if the CPU has it, the plain runs of a
+ * command line are too short for 32 characters at a time to beat 16 (see lexer_benchmark).
+ *
+ * @return LEXER_SCAN_SSE2 on x86-64, LEXER_SCAN_SCALAR anywhere else.
+ */
+enum lexer_scanner lexer_best_scanner(void);
+
+/**
+ * Check if the CPU can run a scanner, AVX2 is looked up once.
+ *
+ * @param scanner the scanner.
+ * @return true if the scanner can be set in a lexer.
+ */
+bool lexer_has_scanner(enum lexer_scanner scanner);
+
+/**
+ * Start scanning a line with lexer_best_scanner.
+ *
+ * @param lexer the lexer to initialize.
+ * @param line the line to scan, it must outlive the lexer and the tokens.
+ * @param length the number of characters in the line.
+ */
+void lexer_init(struct lexer *lexer, const char *line, size_t length);
+
+/**
+ * Scan the next token. Blanks between tokens are skipped, < > >> <& >& << <<< | ; & && and || are
+ * operators and everything else is a word. A redirection operator may follow the number of the
+ * descriptor it redirects (eg. 2> or 3<), the number is part of the token. Quotes and backslashes
+ * keep blanks and operators inside a word.
+ *
+ * @param lexer the lexer.
+ * @param token set to the token that was scanned.
+ * @return the type of the token.
+ */
+enum token_type lexer_next(struct lexer *lexer, struct token *token);
+
+/**
+ * Copy the text of a word, removing the quotes and backslashes, and NUL terminate it.
+ * The result is never longer than the word, so dest may be the word itself.
+ *
+ * @param dest where to write the word, at least length + 1 characters.
+ * @param text the text of the word.
+ * @param length the number of characters in the word.
+ * @return the number of characters written, not counting the NUL.
+ */
+size_t lexer_unquote(char *dest, const char *text, size_t length);
+
+/**
+ * Remove the quotes and backslashes from a word without writing past it. The word is not NUL
+ * terminated, the characters after the returned length are left as they were.
+ *
+ * @param text the text of the word.
+ * @param length the number of characters in the word.
+ * @return the number of characters left in the word.
+ */
+size_t lexer_unquote_in_place(char *text, size_t length);
+
+#endif // DC_SHELL_LEXER_H
@@ -0,0 +1,64 @@
+#ifndef DC_SHELL_PARALLEL_H
+#define DC_SHELL_PARALLEL_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "state.h"
+#include <dc_posix/dc_posix_env.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * The exit code of parallel is the number of commands that failed, up to this.
+ */
+#define PARALLEL_MAX_FAILED 101
+
+/*! \struct parallel_options
+    \brief The command parallel runs for each input and how many run at once.
+*/
+struct parallel_options
+{
+  char **words;             /**< the command and its arguments, {} in a word is replaced by the input */
+  size_t word_count;        /**< the number of words, the input is added after them if no word has {} */
+  char **inputs;            /**< the inputs after :::, NULL to read lines from input */
+  size_t input_count;       /**< the number of inputs */
+  FILE *input;              /**< where to read an input per line when inputs is NULL */
+  struct line_reader *reader; /**< the reader to take the lines from instead of input, NULL for input */
+  size_t max_procs;         /**< the most children that run at once */
+  bool verbose;             /**< print the exit code and resource usage of each child to stderr */
+};
+
+/**
+ * Run the command once for each input, keeping up to max_procs children running.
+ *
+ * The stdout and stderr of each child go to unlinked temporary files, and are copied to
+ * state->stdout and state->stderr when it exits, so the output of one child is never mixed
+ * with another. A child reads /dev/null when the inputs are read from a stream. Only the
+ * children of parallel are reaped (with wait4 for their resource usage), waiting for the
+ * SIGCHLD of state->jobs between them, so a job started with & is left alone.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only set for errors that should stop the shell.
+ * @param state the shell, the commands are found through state->path_cache.
+ * @param options the command, inputs and limits.
+ * @return the number of children that failed, at most PARALLEL_MAX_FAILED.
+ */
+int parallel_run(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                 const struct parallel_options *options);
+
+#endif // DC_SHELL_PARALLEL_H
@@ -0,0 +1,156 @@
+#ifndef DC_SHELL_PATH_CACHE_H
+#define DC_SHELL_PATH_CACHE_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dc_posix/dc_posix_env.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * The number of buckets in a new cache, it doubles as the cache fills.
+ */
+#define PATH_CACHE_INITIAL_BUCKETS 64
+
+/**
+ * The most names remembered as not found, so a script full of typos cannot grow the cache forever.
+ */
+#define PATH_CACHE_MAX_NEGATIVE 1024
+
+/*! \struct path_cache_entry
+    \brief A command name and the file it was found in, or a name that was not found.
+*/
+struct path_cache_entry
+{
+  char *name;                       /**< the command name */
+  char *path;                       /**< the file to exec, NULL if the name is not in any directory */
+  int dir_fd;                       /**< the open directory the name was found in, exec name relative to it */
+  size_t hits;                      /**< the number of times the entry was used */
+  struct path_cache_entry *next;    /**< the next entry in the bucket */
+};
+
+/*! \struct path_cache
+    \brief Command names resolved against PATH, so the search happens once per name.
+
+    The cache opens each PATH directory once and resolves names relative to the directory fds, so
+    a rename of a parent directory cannot send a lookup somewhere else. It remembers the PATH and
+    the mtime of each directory, and empties itself when either changes (see path_cache_validate).
+*/
+struct path_cache
+{
+  struct path_cache_entry **buckets;    /**< the hash table */
+  size_t bucket_count;                  /**< the number of buckets, a power of 2 */
+  size_t count;                         /**< the number of entries, found or not */
+  size_t negative_count;                /**< the number of entries for names that were not found */
+  size_t hits;                          /**< lookups answered from the cache with a file */
+  size_t negative_hits;                 /**< lookups answered from the cache with not found */
+  size_t misses;                        /**< lookups that searched the path */
+  char *path_value;                     /**< the PATH the entries were found with, NULL before the first validate */
+  int *dir_fds;                         /**< each PATH directory opened O_PATH, -1 if it could not be opened */
+  struct timespec *mtimes;              /**< the mtime of each PATH directory when it was opened */
+  size_t dir_count;                     /**< the number of dir_fds and mtimes */
+};
+
+/**
+ * Create an empty cache.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the cache, destroy it with path_cache_destroy.
+ */
+struct path_cache *path_cache_create(const struct dc_posix_env *env, struct dc_error *err);
+
+/**
+ * Free the cache and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param pcache the cache to destroy, may point at NULL.
+ */
+void path_cache_destroy(const struct dc_posix_env *env, struct path_cache **pcache);
+
+/**
+ * Remove every entry, the hit and miss counts are kept.
+ *
+ * @param env the posix environment.
+ * @param cache the cache.
+ */
+void path_cache_clear(const struct dc_posix_env *env, struct path_cache *cache);
+
+/**
+ * Check if PATH is different to the one the cache was filled from.
+ *
+ * @param env the posix environment.
+ * @param cache the cache.
+ * @param path_value the current PATH, NULL if it is not set.
+ * @return true if the directories need to be parsed again.
+ */
+bool path_cache_path_changed(const struct dc_posix_env *env, const struct path_cache *cache,
+                             const char *path_value);
+
+/**
+ * Empty the cache if PATH changed or a directory in it was modified since the last call, so a
+ * command that was added, removed or shadowed is searched for again. The directories are opened
+ * again when that happens.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param path_value the current PATH, NULL if it is not set.
+ * @param dirs the directories of path_value.
+ */
+void path_cache_validate(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache,
+                         const char *path_value, char **dirs);
+
+/**
+ * Open the directories again after the working directory changed, if any of them is relative
+ * (like . or bin). A relative directory was opened from the old working directory, and its
+ * mtime does not change with a cd, so path_cache_validate would keep using it. The cache is
+ * emptied when that happens, nothing is done for a PATH of absolute directories.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param dirs the directories of the last path_cache_validate.
+ */
+void path_cache_chdir(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache, char **dirs);
+
+/**
+ * Find the file for a command name, searching dirs and remembering the result the first time.
+ * A name that is not in any directory is remembered too, so asking again costs no syscalls
+ * until path_cache_validate sees a directory change.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param dirs the directories of the last path_cache_validate.
+ * @param name the command name, without a /.
+ * @return the entry, owned by the cache until it is cleared, or NULL if no directory has an executable name.
+ */
+const struct path_cache_entry *path_cache_lookup(const struct dc_posix_env *env, struct dc_error *err,
+                                                 struct path_cache *cache, char **dirs, const char *name);
+
+/**
+ * Print the entries that were found with their hit counts.
+ *
+ * @param cache the cache.
+ * @param stream where to print.
+ */
+void path_cache_print(const struct path_cache *cache, FILE *stream);
+
+#endif // DC_SHELL_PATH_CACHE_H
@@ -0,0 +1,54 @@
+#ifndef DC_SHELL_PIPELINE_H
+#define DC_SHELL_PIPELINE_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "state.h"
+#include <dc_posix/dc_posix_env.h>
+#include <stdbool.h>
+
+/**
+ * Run the commands as a pipeline and set state->exit_code to the exit code of the last command,
+ * or of the last command that failed if state->settings.pipefail is set.
+ *
+ * Every stage is started before any is waited for, each connected to the next by a pipe2
+ * (O_CLOEXEC) pipe, and then they are all reaped. A command without a / is resolved through
+ * state->path_cache, one that is not found prints an error and exits 127 without a child. A command
+ * that already has an exit_code failed to parse (see parse_command) and is not started.
+ * A builtin that is the only command runs in the shell. In a longer pipeline a builtin runs in a
+ * forked child, like a subshell, except the last stage if it is BUILTIN_PIPELINE, which runs in
+ * the shell once the other stages have started. A BUILTIN_PARENT builtin is never forked, the
+ * change it makes would be lost with the child, it prints an error and exits 1 instead.
+ *
+ * In the background the stages are added to state->jobs instead of being waited for, and the
+ * exit_code is 0. Every builtin runs in a child, so a BUILTIN_PARENT one is refused, the first
+ * stage reads /dev/null unless it redirects stdin, and the pipeline waits for a job to finish first
+ * if state->jobs is at its limit.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only set for errors that should stop the shell.
+ * @param state the shell.
+ * @param commands the parsed commands, part of state->command.
+ * @param count the number of commands.
+ * @param background start the pipeline as a job.
+ * @return true if a BUILTIN_EXIT builtin ran in the shell.
+ */
+bool pipeline_run(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                  struct command *commands, size_t count, bool background);
+
+#endif // DC_SHELL_PIPELINE_H
@@ -0,0 +1,163 @@
+#ifndef DC_SHELL_REACTOR_H
+#define DC_SHELL_REACTOR_H
+
+/*
+ * This file is part of dc_shell.
+ *
+ *  dc_shell is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Foobar is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <dc_posix/dc_posix_env.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * The most events one call to reactor_wait returns.
+ */
+#define REACTOR_MAX_EVENTS 64
+
+/*! \enum reactor_source
+    \brief What a watched file descriptor is.
+*/
+enum reactor_source
+{
+  REACTOR_NONE,         /**< the descriptor is not watched */
+  REACTOR_INPUT,        /**< the commands of the shell, readable when there is a line (or the end) */
+  REACTOR_SIGNAL,       /**< the signalfd of the reactor, readable when a watched signal is pending */
+  REACTOR_CHILD,        /**< a pidfd, readable when the child exits, or a SIGCHLD signalfd for any child */
+};
+
+/*! \struct reactor_event
+    \brief A descriptor that is ready.
+*/
+struct reactor_event
+{
+  enum reactor_source source; /**< what the descriptor is */
+  int fd;                   /**< the descriptor */
+  pid_t pid;                /**< REACTOR_CHILD the child that exited, -1 if it could be any child */
+  int signal;               /**< REACTOR_SIGNAL the signal that was read */
+};
+
+/*! \struct reactor_handler
+    \brief What the reactor knows about a watched descriptor.
+*/
+struct reactor_handler
+{
+  enum reactor_source source; /**< what the descriptor is, REACTOR_NONE if it is not watched */
+  pid_t pid;                /**< the child of a pidfd */
+};
+
+/*! \struct reactor
+    \brief An epoll instance over the descriptors the shell waits on.
+
+    The handlers are indexed by descriptor, so an event finds what it is for without a search, and
+    a wait costs the same however many children are watched. Where there is no epoll the reactor
+    polls the watched descriptors instead. The epoll instance is shared with a forked child, so the
+    reactor does nothing in any process but the one that created it.
+*/
+struct reactor
+{
+  int epoll_fd;             /**< the epoll instance, -1 to use poll */
+  struct reactor_handler *handlers; /**< the handler of each descriptor below handler_count */
+  size_t handler_count;     /**< the number of handlers */
+  size_t watched;           /**< the number of watched descriptors */
+  int signal_fd;            /**< the signalfd of the watched signals, -1 if none are watched */
+  sigset_t signals;         /**< the watched signals, blocked while the reactor exists */
+  sigset_t old_mask;        /**< the signal mask before the first signal was watched */
+  pid_t owner;              /**< the process that created the reactor */
+};
+
+/**
+ * Create a reactor that watches nothing.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the reactor, destroy it with reactor_destroy.
+ */
+struct reactor *reactor_create(const struct dc_posix_env *env, struct dc_error *err);
+
+/**
+ * Close the reactor, restore the signal mask and set it to NULL. The watched descriptors are not closed.
+ *
+ * @param env the posix environment.
+ * @param preactor the reactor to destroy, may point at NULL.
+ */
+void reactor_destroy(const struct dc_posix_env *env, struct reactor **preactor);
+
+/**
+ * Watch a descriptor until it is removed.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ * @param source what the descriptor is.
+ * @param pid the child of a pidfd, -1 for anything else.
+ */
+void reactor_add(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor, int fd,
+                 enum reactor_source source, pid_t pid);
+
+/**
+ * Stop watching a descriptor, before it is closed. Nothing is done if it is not watched.
+ *
+ * @param env the posix environment.
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ */
+void reactor_remove(const struct dc_posix_env *env, struct reactor *reactor, int fd);
+
+/**
+ * Check if a descriptor is watched.
+ *
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ * @return true if the descriptor is watched.
+ */
+bool reactor_watches(const struct reactor *reactor, int fd);
+
+/**
+ * Block a signal and watch for it, through a signalfd, where there is one.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param reactor the reactor.
+ * @param signal_number the signal.
+ */
+void reactor_watch_signal(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                          int signal_number);
+
+/**
+ * Throw away the watched signals that are pending, they were for a child in the foreground.
+ *
+ * @param reactor the reactor.
+ */
+void reactor_drain_signals(const struct reactor *reactor);
+
+/**
+ * Wait for watched descriptors to be ready. A signal is read from the signalfd, so each
+ * REACTOR_SIGNAL event is a signal that was delivered, the other descriptors are left to the caller.
+ *
+ * @param env the posix environment.
+ * @param err the error object, EINTR is not an error.
+ * @param reactor the reactor.
+ * @param events where to put the events.
+ * @param max the room in events.
+ * @param timeout the milliseconds to wait, -1 to wait until there is an event.
+ * @return the number of events, 0 if the wait timed out or was interrupted.
+ */
+size_t reactor_wait(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                    struct reactor_event *events, size_t max, int timeout);
+
+#endif // DC_SHELL_REACTOR_H
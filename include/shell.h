@@ -22,6 +22,8 @@
 #include <dc_posix/dc_posix_env.h>
 #include <stdio.h>
 
+struct shell_settings;
+
 /*! \enum state
     \brief The possible FSM states.
 
@@ -39,6 +41,7 @@ enum shell_states
   RESET_STATE,                    /**< reset the state */               //  8
   ERROR,                          /**< handle errors */                 //  9
   DESTROY_STATE,                  /**< destroy the state */             // 10
+  WAIT_FOR_INPUT,                 /**< wait for a line, a job or ^C */  // 11
 };
 
 /**
@@ -46,12 +49,14 @@ enum shell_states
  *
  * @param env the posix environment.
  * @param error the error object
- * @param in the keyboard (stdin) file
+ * @param settings how the shell was started, NULL for the defaults
+ * @param in the keyboard (stdin) file, the commands are read from settings->script instead if it is set
  * @param out the keyboard (stdout) file
  * @param err the keyboard (stderr) file
  *
- * @return the exit code from the shell.
+ * @return the exit code from the shell, 127 if the script could not be opened.
  */
-int run_shell(const struct dc_posix_env *env, struct dc_error *error, FILE *in, FILE *out, FILE *err);
+int run_shell(const struct dc_posix_env *env, struct dc_error *error, const struct shell_settings *settings,
+              FILE *in, FILE *out, FILE *err);
 
 #endif // DC_SHELL_SHELL_H
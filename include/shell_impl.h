@@ -23,12 +23,11 @@
 
 /**
  * Set up the initial state:
- *  - in_redirect_regex  "[ \t\f\v]<.*"
- *  - out_redirect_regex "[ \t\f\v][1^2]?>[>]?.*"
- *  - err_redirect_regex "[ \t\f\v]2>[>]?.*"
  *  - path the PATH environ var separated into directories
  *  - prompt the PS1 environ var or "$" if PS1 not set
  *  - max_line_length the value of _SC_ARG_MAX (see sysconf)
+ *  - arena the per-line allocator, its first block is settings.arena_block_size bytes
+ *  - path_cache an empty cache of the files commands are found in
  *
  * @param env the posix environment.
  * @param err the error object
@@ -37,17 +36,9 @@
  */
 int init_state(const struct dc_posix_env *env, struct dc_error *err, void *arg);
 
-/**
- * Prints out the error message from regcomp.
- * @param env the posix environment.
- * @param err the error object
- * @param a status code of regcomp
- * @param reg regex_t.
- */
-void error_r(const struct dc_posix_env *env, struct dc_error *err, int a, regex_t reg);
-
 /**
  * Free any dynamically allocated memory in the state and sets variables to NULL, 0 or false.
+ * The descriptors exec opened above stderr are closed.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -70,19 +61,38 @@ int reset_state(const struct dc_posix_env *env, struct dc_error *err,
 
 /**
  * Prompt the user and read the command line (see read_command_line).
- * Sets the state->current_line and current_line_length.
+ * Sets the state->current_line, allocated from state->arena, and current_line_length.
+ * If state->reactor watches the input and no line is buffered the line is read by wait_for_input.
+ * With state->settings.batch there is no prompt, and no working directory to show in it.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param arg the current struct state
- * @return SEPARATE_COMMANDS
+ * @return SEPARATE_COMMANDS, RESET_STATE for an empty line, EXIT at the end of the input, WAIT_FOR_INPUT or ERROR
  */
 int read_commands(const struct dc_posix_env *env, struct dc_error *err,
                   void *arg);
 
 /**
- * Separate the commands. In the current implementation there is only one command.
- * Sets the state->command.
+ * Wait on state->reactor for the input, the jobs and SIGINT. A job that exits is reaped at once,
+ * and the shell goes on waiting. SIGINT drops the line being typed and prompts again. Input that
+ * is ready is read as in read_commands.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param arg the current struct state
+ * @return SEPARATE_COMMANDS, RESET_STATE, EXIT, READ_COMMANDS after SIGINT, WAIT_FOR_INPUT or ERROR
+ */
+int wait_for_input(const struct dc_posix_env *env, struct dc_error *err,
+                   void *arg);
+
+/**
+ * Separate the commands of the line, joined by | ; && and ||. The line is copied once into
+ * state->arena and each operator outside of quotes is overwritten with NULs, so every command
+ * gets its own piece of the copy to parse in place and remembers the operator after it as its
+ * separator. A ; at the end of the line is allowed. Sets state->command to the commands and
+ * state->command_count to how many there are. The state->current_line is left intact for error
+ * messages.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -93,7 +103,9 @@ int separate_commands(const struct dc_posix_env *env, struct dc_error *err,
                       void *arg);
 
 /**
- * Parse the commands (see parse_command)
+ * Parse each command of the pipeline (see parse_command), then read the bodies of its
+ * here-documents from state->stdin (or state->script), in the order they are on the line. A "> " is
+ * printed before each line of a body if state->stdin is a terminal.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -106,12 +118,15 @@ int parse_commands(const struct dc_posix_env *env, struct dc_error *err,
 
 /**
  * Run the command (see execute).
- * If the command->command is cd run builtin_cd
+ * Run each pipeline of the line in order (see pipeline_run) and set state->exit_code.
+ * A pipeline after && only runs if the exit_code is 0, one after || only if it is not, so the
+ * whole line is run from one parse without going back to read_commands.
+ * A change to PATH is picked up before the commands are looked up.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param arg the current struct state
- * @return EXIT (if command->command is exit), RESET_STATE or EXECUTE_ERROR
+ * @return EXIT (if a builtin with BUILTIN_EXIT ran in the shell), RESET_STATE or EXECUTE_ERROR
  */
 int execute_commands(const struct dc_posix_env *env, struct dc_error *err,
                      void *arg);
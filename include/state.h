@@ -18,12 +18,42 @@
  *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <regex.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/types.h>
 #include <dc_posix/dc_posix_env.h>
 
+struct arena;
 struct command;
+struct job_table;
+struct line_reader;
+struct path_cache;
+struct reactor;
+struct script;
+
+/*! \enum spawn_backend
+    \brief How execute creates the child process for a command.
+*/
+enum spawn_backend
+{
+  SPAWN_VFORK,          /**< vfork, the child shares the memory of the shell until it execs (the default) */
+  SPAWN_POSIX_SPAWN,    /**< posix_spawn with file actions for the redirections, execs the full path of a cached program */
+  SPAWN_FORK,           /**< fork, the fallback that works everywhere */
+};
+
+/*! \struct shell_settings
+    \brief How the shell was started and the options set since (see builtin_set). A zeroed struct gives the defaults.
+*/
+struct shell_settings
+{
+  size_t arena_block_size;      /**< the initial size of the per-line arena, 0 for ARENA_DEFAULT_BLOCK_SIZE */
+  enum spawn_backend spawn_backend; /**< how commands are started */
+  bool pipefail;                /**< the status of a pipeline is the last stage that failed, not the last stage */
+  size_t max_jobs;              /**< the most jobs started with & that run at once, 0 for no limit */
+  bool batch;                   /**< the input is a script, no prompt is printed and stdout is not flushed per line */
+  const char *script;           /**< the file to read the commands from instead of stdin, NULL for stdin */
+  bool verbose;                 /**< print the arena use of each line to stderr (see do_reset_state) */
+};
 
 /*! \struct state
     \brief The current FSM state.
@@ -33,17 +63,29 @@ struct command;
 struct state
 {
   FILE *stdin;                  /** stream to read commands from */
+  struct line_reader *input;    /**< the lines of the descriptor of stdin, NULL to read stdin with stdio */
+  struct script *script;        /**< the mapped file of settings.script, read instead of stdin, NULL for stdin */
   FILE *stdout;                 /** stream to print the prompt to */
   FILE *stderr;                 /** stream to print error messages to */
-  regex_t *in_redirect_regex;   /**< stdin regex */
-  regex_t *out_redirect_regex;  /**< stdout regex */
-  regex_t *err_redirect_regex;  /**< stderr regex */
+  struct shell_settings settings; /**< how the shell was started, set before init_state */
+  struct arena *arena;          /**< every allocation for the current line, released by reset_state */
   char **path;                  /**< PATH environ var broken up */
+  struct path_cache *path_cache; /**< the files command names were found in */
   char *prompt;                 /**< Prompt to display before a command is entered */
+  char *cwd;                    /**< the working directory shown in the prompt, NULL until it is first needed */
+  int cwd_fd;                   /**< the working directory, open so its inode is not reused while cwd names it */
+  dev_t cwd_dev;                /**< the device of cwd_fd */
+  ino_t cwd_ino;                /**< the inode of cwd_fd, "." is compared with it to tell if cwd is still right */
   size_t max_line_length;       /**< the largest possible line */
   char *current_line;           /**< the line the user most recently entered */
   size_t current_line_length;   /**< the length of the most recently line */
-  struct command *command;      /**< the commands to execute - currently only one */
+  struct command *command;      /**< the stages of the pipeline to execute, command_count of them */
+  size_t command_count;         /**< the number of commands */
+  int exit_code;                /**< the exit status of the last pipeline */
+  struct job_table *jobs;       /**< the pipelines started with & */
+  struct reactor *reactor;      /**< what the shell waits on for a line, stdin, SIGINT and the jobs */
+  int *fds;                     /**< the descriptors exec redirected in the shell, sorted, inherited by every child */
+  size_t fd_count;              /**< the number of fds */
   bool fatal_error;             /**< should the error terminate the shell (true = terminate) */
 };
 
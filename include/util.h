@@ -23,6 +23,11 @@
 #include <dc_posix/dc_posix_env.h>
 #include <stdio.h>
 
+/**
+ * The lowest descriptor the shell keeps open for itself, those below it belong to exec n>file.
+ */
+#define SHELL_FD_FLOOR 10
+
 /**
  * Get the prompt to use.
  *
@@ -55,13 +60,53 @@ char **parse_path(const struct dc_posix_env *env, struct dc_error *err,
                   const char *path_str);
 
 /**
- * Reset the state for the next read, freeing any dynamically allocated memory.
+ * Free the directories made by parse_path and set them to NULL.
+ *
+ * @param env the posix environment.
+ * @param ppath the directories, may point at NULL.
+ */
+void free_path(const struct dc_posix_env *env, char ***ppath);
+
+/**
+ * Reset the state for the next read, releasing everything allocated for the line in one
+ * go by resetting the state->arena. With state->settings.verbose the bytes the line took from
+ * the arena and its high-water mark are printed to state->stderr first.
  *
  * @param env the posix environment.
  * @param err the error object
  */
 void do_reset_state(const struct dc_posix_env *env, struct dc_error *err, struct state *state);
 
+/**
+ * Get the working directory from state->cwd. It is only read again, with getcwd, if "." is no
+ * longer the directory state->cwd_fd has open, so a prompt costs a stat instead of a getcwd and
+ * an allocation.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell, state->cwd is set if it was read again.
+ * @return state->cwd, NULL on error.
+ */
+const char *current_directory(const struct dc_posix_env *env, struct dc_error *err, struct state *state);
+
+/**
+ * Read the working directory into state->cwd and open it as state->cwd_fd, releasing the old ones.
+ * Call it after a chdir.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell, state->cwd is left as it was on error.
+ */
+void update_current_directory(const struct dc_posix_env *env, struct dc_error *err, struct state *state);
+
+/**
+ * Release state->cwd and close state->cwd_fd, so the working directory is read again when it is next needed.
+ *
+ * @param env the posix environment.
+ * @param state the shell.
+ */
+void forget_current_directory(const struct dc_posix_env *env, struct state *state);
+
 /**
  * Display the state values to the given stream.
  *
@@ -73,6 +118,8 @@ void display_state(const struct dc_posix_env *env, const struct state *state, FI
 
 /**
  * Display the state values to the given stream.
+ * The descriptors exec redirected are listed after the line, if there are any, then the
+ * high-water mark of the state->arena, if there is one.
  *
  * @param env the posix environment.
  * @param state the state to display.
@@ -88,5 +135,23 @@ char *state_to_string(const struct dc_posix_env *env,  struct dc_error *err, con
  */
 size_t count(const char *str, int  c);
 
+/**
+ * Create an unlinked file for output that is kept until it is read back, O_TMPFILE where there is one.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the file, O_CLOEXEC so only the child it is given to gets it.
+ */
+int open_temp(const struct dc_posix_env *env, struct dc_error *err);
+
+/**
+ * Move a descriptor the shell keeps open to SHELL_FD_FLOOR or above, keeping O_CLOEXEC, so the
+ * descriptors below it are left for exec n>file.
+ *
+ * @param fd the descriptor, it is closed if it was moved.
+ * @return the descriptor to use, fd itself if it is -1, already high enough or could not be moved.
+ */
+int move_shell_fd(int fd);
+
 
 #endif // DC_SHELL_UTIL_H
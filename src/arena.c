@@ -0,0 +1,268 @@
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <stdint.h>
+#include "arena.h"
+
+static size_t align_size(size_t size);
+static struct arena_block *add_block(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                                     size_t size);
+
+/**
+ * Create an arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param block_size the size of the first block, 0 for ARENA_DEFAULT_BLOCK_SIZE.
+ * @return the arena, destroy it with arena_destroy.
+ */
+struct arena *arena_create(const struct dc_posix_env *env, struct dc_error *err, size_t block_size){
+    struct arena *arena;
+
+    arena = dc_calloc(env, err, 1, sizeof(struct arena));
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    arena->block_size = block_size == 0 ? ARENA_DEFAULT_BLOCK_SIZE : align_size(block_size);
+    add_block(env, err, arena, arena->block_size);
+
+    if(dc_error_has_error(err)){
+        dc_free(env, arena, sizeof(struct arena));
+        return NULL;
+    }
+
+    return arena;
+}
+
+/**
+ * Allocate memory from the arena. The memory is suitably aligned for any type and is not initialized.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param size the number of bytes.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_alloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, size_t size){
+    struct arena_block *block;
+    size_t aligned;
+    void *ptr;
+
+    aligned = align_size(size);
+
+    if(aligned < size){
+        DC_ERROR_RAISE_ERRNO(err, ENOMEM);
+        return NULL;
+    }
+
+    block = arena->blocks;
+
+    if(block == NULL || block->size - block->used < aligned){
+        block = add_block(env, err, arena, aligned > arena->block_size ? aligned : arena->block_size);
+
+        if(dc_error_has_error(err)){
+            return NULL;
+        }
+    }
+
+    ptr = (unsigned char *)block->data + block->used;
+    block->used += aligned;
+    arena->allocated += aligned;
+    arena->last = ptr;
+
+    if(arena->allocated > arena->high_water_mark){
+        arena->high_water_mark = arena->allocated;
+    }
+
+    return ptr;
+}
+
+/**
+ * Allocate zeroed memory for an array from the arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param count the number of elements.
+ * @param size the size of each element.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_calloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, size_t count,
+                   size_t size){
+    void *ptr;
+
+    if(size != 0 && count > SIZE_MAX / size){
+        DC_ERROR_RAISE_ERRNO(err, ENOMEM);
+        return NULL;
+    }
+
+    ptr = arena_alloc(env, err, arena, count * size);
+
+    if(ptr != NULL){
+        dc_memset(env, ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+/**
+ * Grow an allocation. The most recent allocation grows in place when the block has room,
+ * anything else is copied to a new allocation.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param ptr the memory to grow, may be NULL.
+ * @param old_size the current size of ptr.
+ * @param new_size the size required.
+ * @return the memory, valid until the next arena_reset.
+ */
+void *arena_realloc(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, void *ptr,
+                    size_t old_size, size_t new_size){
+    void *new_ptr;
+
+    if(ptr != NULL && ptr == arena->last){
+        struct arena_block *block = arena->blocks;
+        size_t old_aligned = align_size(old_size);
+        size_t new_aligned = align_size(new_size);
+
+        if(new_aligned <= old_aligned){
+            return ptr;
+        }
+
+        if(new_aligned - old_aligned <= block->size - block->used){
+            block->used += new_aligned - old_aligned;
+            arena->allocated += new_aligned - old_aligned;
+
+            if(arena->allocated > arena->high_water_mark){
+                arena->high_water_mark = arena->allocated;
+            }
+
+            return ptr;
+        }
+    }
+
+    new_ptr = arena_alloc(env, err, arena, new_size);
+
+    if(new_ptr != NULL && ptr != NULL){
+        dc_memcpy(env, new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    }
+
+    return new_ptr;
+}
+
+/**
+ * Copy a string into the arena.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param str the string to copy.
+ * @param length the number of characters to copy.
+ * @return the NUL terminated copy, valid until the next arena_reset.
+ */
+char *arena_strndup(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena, const char *str,
+                    size_t length){
+    char *copy;
+
+    copy = arena_alloc(env, err, arena, length + 1);
+
+    if(copy != NULL){
+        dc_memcpy(env, copy, str, length);
+        copy[length] = '\0';
+    }
+
+    return copy;
+}
+
+/**
+ * Release everything allocated from the arena. If the allocations spilled over into more than
+ * one block the blocks are freed and the next block is made big enough to hold them all, so a
+ * steady workload settles on one block and no allocations.
+ *
+ * @param env the posix environment.
+ * @param arena the arena.
+ */
+void arena_reset(const struct dc_posix_env *env, struct arena *arena){
+    if(arena->blocks != NULL && arena->blocks->next != NULL){
+        size_t total = 0;
+
+        while(arena->blocks != NULL){
+            struct arena_block *next = arena->blocks->next;
+
+            total += arena->blocks->size;
+            dc_free(env, arena->blocks, sizeof(struct arena_block) + arena->blocks->size);
+            arena->blocks = next;
+        }
+
+        arena->block_size = total;
+    } else if(arena->blocks != NULL){
+        arena->blocks->used = 0;
+    }
+
+    arena->allocated = 0;
+    arena->last = NULL;
+}
+
+/**
+ * Free the arena and all of its blocks and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param parena the arena to destroy, may point at NULL.
+ */
+void arena_destroy(const struct dc_posix_env *env, struct arena **parena){
+    struct arena *arena = *parena;
+
+    if(arena != NULL){
+        while(arena->blocks != NULL){
+            struct arena_block *next = arena->blocks->next;
+
+            dc_free(env, arena->blocks, sizeof(struct arena_block) + arena->blocks->size);
+            arena->blocks = next;
+        }
+
+        dc_free(env, arena, sizeof(struct arena));
+        *parena = NULL;
+    }
+}
+
+/**
+ * Round a size up so the next allocation stays aligned.
+ *
+ * @param size the size.
+ * @return the aligned size, smaller than size if it overflowed.
+ */
+static size_t align_size(size_t size){
+    size_t alignment = _Alignof(max_align_t);
+
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Allocate a block and make it the one being allocated from.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param arena the arena.
+ * @param size the number of usable bytes in the block.
+ * @return the block.
+ */
+static struct arena_block *add_block(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                                     size_t size){
+    struct arena_block *block;
+
+    block = dc_malloc(env, err, sizeof(struct arena_block) + size);
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    block->next = arena->blocks;
+    block->size = size;
+    block->used = 0;
+    arena->blocks = block;
+    arena->block_allocations++;
+
+    return block;
+}
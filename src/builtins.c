@@ -3,35 +3,382 @@
 #include <dc_util/filesystem.h>
 #include <dc_util/path.h>
 #include <dc_posix/dc_string.h>
+#include <dc_posix/dc_stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "builtins.h"
+#include "input.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "util.h"
+
+/*! \struct test_parser
+    \brief The arguments of a test expression and how far through them the parse is.
+*/
+struct test_parser
+{
+  const struct dc_posix_env *env;   /**< the posix environment */
+  char **args;                      /**< the arguments after test or [ */
+  size_t count;                     /**< the number of args */
+  size_t pos;                       /**< the next argument to parse */
+  const char *error;                /**< the argument the parse failed at, NULL if it has not failed */
+};
+
+/*! \struct print_spec
+    \brief The flags, width and precision of a printf conversion.
+*/
+struct print_spec
+{
+  bool left;                        /**< - pad on the right */
+  bool zero;                        /**< 0 pad numbers with zeros */
+  bool plus;                        /**< + print a + on positive numbers */
+  bool space;                       /**< space print a space on positive numbers */
+  bool alternate;                   /**< # prefix octal with 0 and hex with 0x */
+  int width;                        /**< the minimum width, 0 for none */
+  int precision;                    /**< the minimum digits or maximum characters, -1 for none */
+};
+
+static bool is_unary_operator(const char *arg);
+static bool is_binary_operator(const struct dc_posix_env *env, const char *arg);
+static bool test_unary(const char *op, const char *arg);
+static bool test_binary(struct test_parser *parser, const char *left, const char *op, const char *right);
+static bool parse_integer(const char *text, intmax_t *value);
+static FILE *redirected_stream(const struct dc_posix_env *env, struct dc_error *err, const struct exec_plan *plan,
+                               FILE *shell_streams[3], int fd, bool *owned);
+static bool exec_busy(const struct state *state, int fd);
+static void remember_fd(const struct dc_posix_env *env, struct dc_error *err, struct state *state, int fd);
+static void forget_fd(const struct dc_posix_env *env, struct state *state, int fd);
+static bool test_count(struct test_parser *parser, size_t start, size_t count);
+static bool test_or(struct test_parser *parser);
+static bool test_and(struct test_parser *parser);
+static bool test_not(struct test_parser *parser);
+static bool test_primary(struct test_parser *parser);
+static void run_test(const struct dc_posix_env *env, struct command *command, struct state *state,
+                     const char *name, char **args, size_t count);
+static const char *print_escape(const char *text, FILE *stream, bool octal_zero, bool *stop);
+static bool print_format(const struct dc_posix_env *env, const char *format, char **args, size_t count,
+                         size_t *next, FILE *outstream, FILE *errstream);
+static const char *parse_print_spec(const char *text, struct print_spec *spec);
+static void print_string(const struct print_spec *spec, char conversion, const char *arg, FILE *stream,
+                         bool *stop);
+static bool print_number(const struct print_spec *spec, char conversion, const char *arg, FILE *outstream,
+                         FILE *errstream);
+static void print_padded(const struct print_spec *spec, const char *prefix, size_t zeros, const char *text,
+                         size_t length, FILE *stream);
+
+/**
+ * Every builtin, sorted by name so builtin_find can binary search it.
+ */
+static const struct builtin builtins[] = {
+    {"[",       builtin_bracket,    BUILTIN_PIPELINE},
+    {"cd",      builtin_cd,         BUILTIN_PARENT},
+    {"echo",    builtin_echo,       BUILTIN_PIPELINE},
+    {"exec",    builtin_exec,       BUILTIN_PARENT | BUILTIN_REDIRECTS},
+    {"exit",    builtin_exit,       BUILTIN_PARENT | BUILTIN_EXIT},
+    {"false",   builtin_false,      BUILTIN_PIPELINE},
+    {"hash",    builtin_hash,       BUILTIN_PARENT},
+    {"jobs",    builtin_jobs,       BUILTIN_PARENT},
+    {"parallel", builtin_parallel,  0},
+    {"printf",  builtin_printf,     BUILTIN_PIPELINE},
+    {"pwd",     builtin_pwd,        BUILTIN_PIPELINE},
+    {"set",     builtin_set,        BUILTIN_PARENT},
+    {"test",    builtin_test,       BUILTIN_PIPELINE},
+    {"true",    builtin_true,       BUILTIN_PIPELINE},
+    {"wait",    builtin_wait,       BUILTIN_PARENT},
+};
+
+/**
+ * Find the builtin for a command name.
+ * The builtins are kept in one array sorted by name, so adding one is a single entry there.
+ *
+ * @param env the posix environment.
+ * @param name the command name.
+ * @return the builtin or NULL if name is not a builtin.
+ */
+const struct builtin *builtin_find(const struct dc_posix_env *env, const char *name){
+    size_t low;
+    size_t high;
+
+    low = 0;
+    high = sizeof(builtins) / sizeof(builtins[0]);
+
+    while(low < high){
+        size_t middle;
+        int result;
+
+        middle = low + (high - low) / 2;
+        result = dc_strcmp(env, name, builtins[middle].name);
+
+        if(result == 0){
+            return &builtins[middle];
+        }
+
+        if(result < 0){
+            high = middle;
+        } else{
+            low = middle + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Get every builtin, sorted by name.
+ *
+ * @param count set to the number of builtins.
+ * @return the builtins.
+ */
+const struct builtin *builtin_list(size_t *count){
+    *count = sizeof(builtins) / sizeof(builtins[0]);
+
+    return builtins;
+}
+
+/**
+ * Run a builtin in the shell process. The redirections of the command are opened and followed
+ * to where stdin, stdout and stderr end up, which are given to the builtin as state->stdin,
+ * state->stdout and state->stderr and put back afterwards, so no child is needed. A descriptor
+ * that is copied from 0, 1 or 2 (eg. 2>&1) is the stream of the shell for it, and one that is
+ * closed reads and writes /dev/null. A BUILTIN_REDIRECTS builtin is given the redirections as they are.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only left set for errors that should stop the shell.
+ * @param builtin the builtin to run.
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_run(const struct dc_posix_env *env, struct dc_error *err, const struct builtin *builtin,
+                 struct command *command, struct state *state){
+    struct exec_plan plan;
+    FILE *shell_streams[3];
+    FILE *streams[3];
+    bool owned[3] = {false, false, false};
+
+    if((builtin->flags & BUILTIN_REDIRECTS) != 0){
+        builtin->handler(env, err, command, state);
+
+        if(!state->settings.batch){
+            fflush(state->stdout);
+            fflush(state->stderr);
+        }
+
+        return;
+    }
+
+    open_redirections(env, err, command, NULL, &plan);
+
+    if(dc_error_has_error(err)){
+        fprintf(state->stderr, "%s\n", err->message);
+        dc_error_reset(err);
+        command->exit_code = 1;
+        return;
+    }
+
+    shell_streams[STDIN_FILENO] = state->stdin;
+    shell_streams[STDOUT_FILENO] = state->stdout;
+    shell_streams[STDERR_FILENO] = state->stderr;
+
+    for(int i = 0; i < 3; i++){
+        streams[i] = shell_streams[i];
+    }
+
+    for(int i = 0; i < 3 && dc_error_has_no_error(err); i++){
+        streams[i] = redirected_stream(env, err, &plan, shell_streams, i, &owned[i]);
+    }
+
+    if(dc_error_has_error(err)){
+        fprintf(state->stderr, "%s\n", err->message);
+        dc_error_reset(err);
+        command->exit_code = 1;
+    } else{
+        state->stdin = streams[STDIN_FILENO];
+        state->stdout = streams[STDOUT_FILENO];
+        state->stderr = streams[STDERR_FILENO];
+        builtin->handler(env, err, command, state);
+    }
+
+    for(int i = 0; i < 3; i++){
+        if(owned[i]){
+            fclose(streams[i]);
+        }
+    }
+
+    state->stdin = shell_streams[STDIN_FILENO];
+    state->stdout = shell_streams[STDOUT_FILENO];
+    state->stderr = shell_streams[STDERR_FILENO];
+    close_redirections(env, err, &plan);
+
+    // anything a child prints next must come after the output of the builtin, in a script
+    // pipeline_run flushes right before it forks or spawns one, so the output of builtins in a row
+    // is written at once
+    if(!state->settings.batch){
+        fflush(state->stdout);
+        fflush(state->stderr);
+    }
+}
+
+/**
+ * Get the stream for where a descriptor of a builtin ends up after the redirections.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param plan the redirections of the builtin.
+ * @param shell_streams the stdin, stdout and stderr of the shell.
+ * @param fd STDIN_FILENO, STDOUT_FILENO or STDERR_FILENO.
+ * @param owned set to true if the stream was opened for the builtin and must be closed.
+ * @return the stream, NULL if it could not be opened.
+ */
+static FILE *redirected_stream(const struct dc_posix_env *env, struct dc_error *err, const struct exec_plan *plan,
+                               FILE *shell_streams[3], int fd, bool *owned){
+    const char *mode = fd == STDIN_FILENO ? "r" : "w";
+    FILE *stream;
+    int target;
+    int copy;
+
+    target = redirected_fd(plan, fd);
+    *owned = false;
+
+    if(target >= STDIN_FILENO && target <= STDERR_FILENO){
+        return shell_streams[target];
+    }
+
+    if(target == -1){
+        stream = dc_fopen(env, err, "/dev/null", mode);
+    } else{
+        // the plan closes the descriptor it opened, the stream closes its own copy
+        copy = fcntl(target, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+
+        if(copy == -1){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+            return NULL;
+        }
+
+        stream = dc_fdopen(env, err, copy, mode);
+
+        if(dc_error_has_error(err)){
+            close(copy);
+        }
+    }
+
+    *owned = dc_error_has_no_error(err);
+
+    return *owned ? stream : NULL;
+}
+
+/**
+ * Check if exec must leave a descriptor alone: it is the one the shell reads commands from, or it is
+ * open, at or above SHELL_FD_FLOOR and not one exec opened, so the shell uses it (see move_shell_fd).
+ *
+ * @param state the shell.
+ * @param fd the descriptor.
+ * @return true if the descriptor belongs to the shell.
+ */
+static bool exec_busy(const struct state *state, int fd){
+    if(state->stdin != NULL && fileno(state->stdin) == fd){
+        return true;
+    }
+
+    if(fd < SHELL_FD_FLOOR || fcntl(fd, F_GETFD) == -1){
+        return false;
+    }
+
+    for(size_t i = 0; i < state->fd_count; i++){
+        if(state->fds[i] == fd){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Add a descriptor to state->fds, keeping it sorted. Nothing is done if it is there.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param state the shell.
+ * @param fd the descriptor.
+ */
+static void remember_fd(const struct dc_posix_env *env, struct dc_error *err, struct state *state, int fd){
+    int *fds;
+    size_t i;
+
+    for(i = 0; i < state->fd_count && state->fds[i] < fd; i++){
+    }
+
+    if(i < state->fd_count && state->fds[i] == fd){
+        return;
+    }
+
+    fds = dc_realloc(env, err, state->fds, (state->fd_count + 1) * sizeof(int));
+
+    if(dc_error_has_error(err)){
+        return;
+    }
+
+    dc_memmove(env, &fds[i + 1], &fds[i], (state->fd_count - i) * sizeof(int));
+    fds[i] = fd;
+    state->fds = fds;
+    state->fd_count++;
+}
+
+/**
+ * Remove a descriptor from state->fds. Nothing is done if it is not there.
+ *
+ * @param env the posix environment.
+ * @param state the shell.
+ * @param fd the descriptor.
+ */
+static void forget_fd(const struct dc_posix_env *env, struct state *state, int fd){
+    for(size_t i = 0; i < state->fd_count; i++){
+        if(state->fds[i] == fd){
+            dc_memmove(env, &state->fds[i], &state->fds[i + 1], (state->fd_count - i - 1) * sizeof(int));
+            state->fd_count--;
+            break;
+        }
+    }
+
+    if(state->fd_count == 0 && state->fds != NULL){
+        dc_free(env, state->fds, sizeof(int));
+        state->fds = NULL;
+    }
+}
 
 /**
  * Change the working directory.
  * ~ is converted to the users home directory.
  * - no arguments is converted to the users home directory.
- * The command->exit_code is set to 0 on success or error->errno_code on failure.
+ * The command->exit_code is set to 0 on success or 1 on failure, a failure is not an err.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param command the command information
- * @param errstream the stream to print error messages to
+ * @param state the shell, error messages are printed to state->stderr and the new directory is kept in state->cwd,
+ *              the relative directories of state->path are opened again in state->path_cache
  */
-void builtin_cd(const struct dc_posix_env *env, struct dc_error *err, struct command *command, FILE *errstream){
-    char *path;
+void builtin_cd(const struct dc_posix_env *env, struct dc_error *err, struct command *command, struct state *state){
+    FILE *errstream;
+    const char *path;
+    char *home = NULL;
 
-    if(command->argv[1] == NULL) {
-        char *s;
+    errstream = state->stderr;
 
-        dc_expand_path(env, err, &s, "~/");
+    if(command->argv[1] == NULL) {
+        dc_expand_path(env, err, &home, "~/");
 
-        dc_chdir(env, err, s);
+        dc_chdir(env, err, home);
 
-        path = dc_strdup(env, err, s);
+        path = home;
     } else{
 
         dc_chdir(env, err, command->argv[1]);
 
-        path = dc_strdup(env, err, command->argv[1]);
+        path = command->argv[1];
     }
 
     if(dc_error_has_error(err)){
@@ -50,9 +397,1273 @@ void builtin_cd(const struct dc_posix_env *env, struct dc_error *err, struct com
         if(dc_error_is_errno(err, ENOTDIR)){
             fprintf(errstream, "%s: is not a directory\n", path);
         }
+        // the message is printed, the shell carries on
+        dc_error_reset(err);
         command->exit_code = 1;
     } else{
+        update_current_directory(env, err, state);
+
+        // the prompt reads it again instead
+        if(dc_error_has_error(err)){
+            forget_current_directory(env, state);
+            dc_error_reset(err);
+        }
+
+        // a . in PATH is the new directory now
+        if(state->path_cache != NULL){
+            path_cache_chdir(env, err, state->path_cache, state->path);
+        }
+
         command->exit_code = 0;
     }
+
+    free(home);
+}
+
+/**
+ * Show or change the command path cache.
+ * - no arguments lists the cached commands and their hit counts.
+ * - -r empties the cache.
+ * - -s shows the hits, misses and number of entries, and the same for names that were not found.
+ * - names are looked up and added to the cache.
+ * The command->exit_code is set to 0 on success, 1 if a name was not found or 2 for a bad option.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, names are searched for in state->path and kept in state->path_cache
+ */
+void builtin_hash(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    struct path_cache *cache;
+    char **path;
+    FILE *outstream;
+    FILE *errstream;
+
+    cache = state->path_cache;
+    path = state->path;
+    outstream = state->stdout;
+    errstream = state->stderr;
+    command->exit_code = 0;
+
+    if(command->argv[1] == NULL){
+        path_cache_print(cache, outstream);
+    } else if(dc_strcmp(env, command->argv[1], "-r") == 0){
+        path_cache_clear(env, cache);
+    } else if(dc_strcmp(env, command->argv[1], "-s") == 0){
+        fprintf(outstream, "hits %zu, misses %zu, entries %zu, not found hits %zu, not found entries %zu\n",
+                cache->hits, cache->misses, cache->count - cache->negative_count, cache->negative_hits,
+                cache->negative_count);
+    } else if(command->argv[1][0] == '-'){
+        fprintf(errstream, "hash: %s: invalid option\nhash: usage: hash [-rs] [name ...]\n", command->argv[1]);
+        command->exit_code = 2;
+    } else{
+        for(size_t i = 1; command->argv[i] != NULL && dc_error_has_no_error(err); i++){
+            if(dc_strchr(env, command->argv[i], '/') != NULL){
+                continue;
+            }
+
+            if(path_cache_lookup(env, err, cache, path, command->argv[i]) == NULL && dc_error_has_no_error(err)){
+                fprintf(errstream, "hash: %s: not found\n", command->argv[i]);
+                command->exit_code = 1;
+            }
+        }
+    }
+}
+
+/**
+ * Apply the redirections of the command to the shell itself, for every command after it.
+ * - n>file, n>>file and n<file open the file once and keep it on n for the rest of the session.
+ * - n>&m copies m to n, n>&- closes n.
+ * The descriptors are left open across exec, so every child inherits them and >&n in a later
+ * command is a dup2 instead of an open. They are listed in state->fds. A descriptor the shell
+ * uses itself, such as the one it reads commands from, is not changed. Running a program in
+ * place of the shell is not supported.
+ * The command->exit_code is set to 0 on success, 1 if a redirection failed or 2 for an argument.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the descriptors that were changed are kept in state->fds
+ */
+void builtin_exec(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    struct exec_plan plan;
+
+    if(command->argv[1] != NULL){
+        fprintf(state->stderr, "exec: usage: exec [n]>file [n]>&m [n]>&- ...\n");
+        command->exit_code = 2;
+        return;
+    }
+
+    command->exit_code = 0;
+
+    for(size_t i = 0; i < command->redirection_count; i++){
+        if(exec_busy(state, command->redirections[i].fd)){
+            fprintf(state->stderr, "exec: %d: the descriptor is used by the shell\n", command->redirections[i].fd);
+            command->exit_code = 1;
+            return;
+        }
+    }
+
+    // what the shell printed so far goes where 1 and 2 were
+    fflush(state->stdout);
+    fflush(state->stderr);
+    open_redirections(env, err, command, NULL, &plan);
+
+    if(dc_error_has_error(err)){
+        fprintf(state->stderr, "%s\n", err->message);
+        dc_error_reset(err);
+        command->exit_code = 1;
+        return;
+    }
+
+    // in order, as a child would, but without FD_CLOEXEC so the children get them
+    for(size_t i = 0; i < plan.dup_count && dc_error_has_no_error(err); i++){
+        const struct exec_dup *dup = &plan.dups[i];
+
+        if(dup->from == -1){
+            if(close(dup->to) == -1 && errno != EBADF){
+                DC_ERROR_RAISE_ERRNO(err, errno);
+            } else{
+                forget_fd(env, state, dup->to);
+            }
+        } else{
+            if(dup->from == dup->to){
+                if(fcntl(dup->to, F_SETFD, 0) == -1){
+                    DC_ERROR_RAISE_ERRNO(err, errno);
+                }
+            } else if(dup2(dup->from, dup->to) == -1){
+                DC_ERROR_RAISE_ERRNO(err, errno);
+            }
+
+            if(dc_error_has_no_error(err)){
+                remember_fd(env, err, state, dup->to);
+            }
+        }
+    }
+
+    if(dc_error_has_error(err)){
+        fprintf(state->stderr, "exec: %s\n", err->message);
+        dc_error_reset(err);
+        command->exit_code = 1;
+    }
+
+    close_redirections(env, err, &plan);
+}
+
+/**
+ * Leave the shell, the command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_exit(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    (void)env;
+    (void)err;
+    (void)state;
+    command->exit_code = 0;
+}
+
+/**
+ * Do nothing successfully, the command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_true(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    (void)env;
+    (void)err;
+    (void)state;
+    command->exit_code = 0;
+}
+
+/**
+ * Do nothing unsuccessfully, the command->exit_code is set to 1.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_false(const struct dc_posix_env *env, struct dc_error *err,
+                   struct command *command, struct state *state){
+    (void)env;
+    (void)err;
+    (void)state;
+    command->exit_code = 1;
+}
+
+/**
+ * Print the arguments separated by spaces and followed by a newline to state->stdout.
+ * A first argument of -n leaves off the newline. The command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_echo(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    size_t first;
+    bool newline;
+
+    (void)err;
+    first = 1;
+    newline = true;
+
+    if(command->argv[1] != NULL && dc_strcmp(env, command->argv[1], "-n") == 0){
+        first = 2;
+        newline = false;
+    }
+
+    for(size_t i = first; command->argv[i] != NULL; i++){
+        if(i > first){
+            fputc(' ', state->stdout);
+        }
+
+        fputs(command->argv[i], state->stdout);
+    }
+
+    if(newline){
+        fputc('\n', state->stdout);
+    }
+
+    command->exit_code = 0;
+}
+
+/**
+ * Print the arguments to state->stdout under the control of the format (the first argument).
+ * The escapes \\ \a \b \f \n \r \t \v and \NNN and the conversions %d %i %o %u %x %X %c %s
+ * %b and %% are understood, with the - + space # and 0 flags, a width and a precision.
+ * The format is used again while arguments are left, missing arguments are "" or 0.
+ * The command->exit_code is set to 0, 1 if an argument was not a number or the format was bad,
+ * or 2 if there was no format.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_printf(const struct dc_posix_env *env, struct dc_error *err,
+                    struct command *command, struct state *state){
+    size_t count;
+    size_t next;
+
+    (void)err;
+    if(command->argv[1] == NULL){
+        fprintf(state->stderr, "printf: usage: printf format [arguments]\n");
+        command->exit_code = 2;
+        return;
+    }
+
+    count = 0;
+
+    while(command->argv[count + 2] != NULL){
+        count++;
+    }
+
+    next = 0;
+    command->exit_code = 0;
+
+    do{
+        size_t before;
+
+        before = next;
+
+        if(!print_format(env, command->argv[1], &command->argv[2], count, &next, state->stdout, state->stderr)){
+            command->exit_code = 1;
+        }
+
+        // a format without conversions would never use up the arguments
+        if(next == before){
+            break;
+        }
+    } while(next < count);
+}
+
+/**
+ * Print the working directory to state->stdout, the one of the prompt (see current_directory).
+ * The command->exit_code is set to 0, or 1 if the directory could not be found.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, state->cwd is set if the directory was read again
+ */
+void builtin_pwd(const struct dc_posix_env *env, struct dc_error *err,
+                 struct command *command, struct state *state){
+    const char *working_dir;
+
+    working_dir = current_directory(env, err, state);
+
+    if(dc_error_has_error(err)){
+        fprintf(state->stderr, "pwd: %s\n", err->message);
+        dc_error_reset(err);
+        command->exit_code = 1;
+        return;
+    }
+
+    fprintf(state->stdout, "%s\n", working_dir);
+    command->exit_code = 0;
+}
+
+/**
+ * Evaluate a conditional expression of the arguments (see test(1)).
+ * The command->exit_code is set to 0 if it is true, 1 if it is false or 2 if it is not valid.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_test(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    (void)err;
+
+    run_test(env, command, state, "test", &command->argv[1], command->argc - 1);
 }
 
+/**
+ * The [ form of builtin_test, the last argument must be ].
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_bracket(const struct dc_posix_env *env, struct dc_error *err,
+                     struct command *command, struct state *state){
+    (void)err;
+
+    if(command->argc < 2 || dc_strcmp(env, command->argv[command->argc - 1], "]") != 0){
+        fprintf(state->stderr, "[: missing ]\n");
+        command->exit_code = 2;
+        return;
+    }
+
+    run_test(env, command, state, "[", &command->argv[1], command->argc - 2);
+}
+
+/**
+ * Show or change the shell options, the only option is pipefail.
+ * - no arguments or -o lists the options and if they are on.
+ * - -o name turns the option on, +o name turns it off.
+ * The command->exit_code is set to 0 on success or 2 for a bad option.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the options are in state->settings
+ */
+void builtin_set(const struct dc_posix_env *env, struct dc_error *err,
+                 struct command *command, struct state *state){
+    const char *name;
+    bool on;
+
+    (void)err;
+    command->exit_code = 0;
+
+    if(command->argv[1] == NULL || (command->argv[2] == NULL && dc_strcmp(env, command->argv[1], "-o") == 0)){
+        fprintf(state->stdout, "pipefail\t%s\n", state->settings.pipefail ? "on" : "off");
+        return;
+    }
+
+    if(command->argv[2] == NULL || command->argv[3] != NULL ||
+       (dc_strcmp(env, command->argv[1], "-o") != 0 && dc_strcmp(env, command->argv[1], "+o") != 0)){
+        fprintf(state->stderr, "set: usage: set [-o|+o] [option]\n");
+        command->exit_code = 2;
+        return;
+    }
+
+    name = command->argv[2];
+    on = command->argv[1][0] == '-';
+
+    if(dc_strcmp(env, name, "pipefail") == 0){
+        state->settings.pipefail = on;
+    } else{
+        fprintf(state->stderr, "set: %s: invalid option name\n", name);
+        command->exit_code = 2;
+    }
+}
+
+/**
+ * List the jobs started with & and their state, Running, Done or Exit and the code.
+ * The jobs that finished are forgotten once they are listed. The command->exit_code is set to 0.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell, the jobs are in state->jobs
+ */
+void builtin_jobs(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    job_table_reap(env, err, state->jobs);
+    job_table_report(env, state->jobs, state->stdout);
+    command->exit_code = 0;
+}
+
+/**
+ * Run a command once for each input, up to a number at a time (see parallel_run).
+ * parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]
+ * - the inputs are the words after :::, or else the lines of the file of -a, the stdin
+ *   redirection of the command or the stdin of the shell.
+ * - -j is how many run at once, the number of online CPUs by default.
+ * - -v prints the exit code and resource usage of each command to stderr.
+ * The command is a program, {} in a word is replaced by the input, without one the input is
+ * added as the last argument. The command->exit_code is set to the number that failed (up to
+ * PARALLEL_MAX_FAILED), 1 if the inputs cannot be read or 2 for bad arguments.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param command the command information
+ * @param state the shell
+ */
+void builtin_parallel(const struct dc_posix_env *env, struct dc_error *err,
+                      struct command *command, struct state *state){
+    struct parallel_options options;
+    const char *file;
+    FILE *input;
+    long procs;
+    size_t i;
+    size_t end;
+    bool bad;
+
+    dc_memset(env, &options, 0, sizeof(options));
+    procs = sysconf(_SC_NPROCESSORS_ONLN);
+    options.max_procs = procs > 0 ? (size_t)procs : 1;
+    file = NULL;
+    bad = false;
+
+    for(i = 1; command->argv[i] != NULL && command->argv[i][0] == '-' && !bad; i++){
+        const char *arg = command->argv[i];
+        const char *value;
+        intmax_t count;
+
+        if(dc_strcmp(env, arg, "--") == 0){
+            i++;
+            break;
+        }
+
+        if(dc_strcmp(env, arg, "-v") == 0){
+            options.verbose = true;
+            continue;
+        }
+
+        // -j4 or -j 4
+        value = arg[1] == '\0' || arg[2] != '\0' ? &arg[2] : command->argv[++i];
+
+        if((arg[1] != 'j' && arg[1] != 'a') || value == NULL){
+            bad = true;
+        } else if(arg[1] == 'a'){
+            file = value;
+        } else if(parse_integer(value, &count) && count > 0){
+            options.max_procs = (size_t)count;
+        } else{
+            bad = true;
+        }
+    }
+
+    for(end = i; command->argv[end] != NULL && dc_strcmp(env, command->argv[end], ":::") != 0; end++){
+    }
+
+    if(bad || end == i){
+        fprintf(state->stderr, "parallel: usage: parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]\n");
+        command->exit_code = 2;
+        return;
+    }
+
+    options.words = &command->argv[i];
+    options.word_count = end - i;
+
+    if(command->argv[end] != NULL){
+        options.inputs = &command->argv[end + 1];
+        options.input_count = command->argc - end - 1;
+    }
+
+    input = NULL;
+
+    if(options.inputs == NULL){
+        if(file != NULL){
+            input = fopen(file, "r");
+
+            if(input == NULL){
+                fprintf(state->stderr, "parallel: %s: %s\n", file, strerror(errno));
+                command->exit_code = 1;
+                return;
+            }
+        }
+
+        options.input = input != NULL ? input : state->stdin;
+
+        // the stdin of the shell is read by its line reader, which may hold the lines already
+        if(input == NULL && state->input != NULL && fileno(state->stdin) == state->input->fd){
+            options.reader = state->input;
+        }
+    }
+
+    command->exit_code = parallel_run(env, err, state, &options);
+
+    if(input != NULL){
+        fclose(input);
+    }
+}
+
+/**
+ * Wait for jobs started with & and forget them.
+ * - no arguments waits for every job, the command->exit_code is set to 0.
+ * - -n waits for the next job to finish, or takes one that already finished, and sets the
+ *   command->exit_code to its exit code, or 127 if there are no jobs.
+ * - %id or pid waits for each job and sets the command->exit_code to the exit code of the last,
+ *   or 127 if one is not a job.
+ *
+ * @param env the posix environment.
+ * @param err the error object, set if waiting failed.
+ * @param command the command information
+ * @param state the shell, the jobs are in state->jobs
+ */
+void builtin_wait(const struct dc_posix_env *env, struct dc_error *err,
+                  struct command *command, struct state *state){
+    struct job_table *jobs;
+
+    jobs = state->jobs;
+    command->exit_code = 0;
+
+    if(command->argv[1] == NULL){
+        while(job_table_running(jobs) > 0 && dc_error_has_no_error(err)){
+            job_table_wait(env, err, jobs);
+        }
+
+        job_table_clear(env, jobs);
+    } else if(dc_strcmp(env, command->argv[1], "-n") == 0){
+        struct job *job;
+
+        job_table_reap(env, err, jobs);
+        job = job_table_find_done(jobs);
+
+        while(job == NULL && job_table_running(jobs) > 0 && dc_error_has_no_error(err)){
+            job_table_wait(env, err, jobs);
+            job = job_table_find_done(jobs);
+        }
+
+        if(job == NULL){
+            command->exit_code = 127;
+        } else{
+            command->exit_code = job_status(job);
+            job_table_remove(env, jobs, job);
+        }
+    } else{
+        for(size_t i = 1; command->argv[i] != NULL && dc_error_has_no_error(err); i++){
+            struct job *job;
+
+            job = job_table_find(jobs, command->argv[i]);
+
+            if(job == NULL){
+                fprintf(state->stderr, "wait: %s: no such job\n", command->argv[i]);
+                command->exit_code = 127;
+                continue;
+            }
+
+            while(job->running > 0 && dc_error_has_no_error(err)){
+                job_table_wait(env, err, jobs);
+            }
+
+            command->exit_code = job_status(job);
+            job_table_remove(env, jobs, job);
+        }
+    }
+}
+
+/**
+ * Evaluate a test expression and set the exit code.
+ *
+ * @param env the posix environment.
+ * @param command the command information
+ * @param state the shell
+ * @param name the name to use in error messages.
+ * @param args the expression.
+ * @param count the number of args.
+ */
+static void run_test(const struct dc_posix_env *env, struct command *command, struct state *state,
+                     const char *name, char **args, size_t count){
+    struct test_parser parser;
+    bool result;
+
+    parser.env = env;
+    parser.args = args;
+    parser.count = count;
+    parser.pos = 0;
+    parser.error = NULL;
+    result = test_count(&parser, 0, count);
+
+    if(parser.error != NULL){
+        fprintf(state->stderr, "%s: %s: unexpected argument\n", name, parser.error);
+        command->exit_code = 2;
+    } else{
+        command->exit_code = result ? 0 : 1;
+    }
+}
+
+/**
+ * Evaluate count arguments from start using the rules test has for 4 or fewer arguments,
+ * so that an operand that looks like an operator is still an operand (eg. [ = = = ]).
+ * More arguments are parsed as an expression with ! ( ) -a and -o.
+ *
+ * @param parser the arguments.
+ * @param start the first argument.
+ * @param count the number of arguments.
+ * @return the value of the expression.
+ */
+static bool test_count(struct test_parser *parser, size_t start, size_t count){
+    const struct dc_posix_env *env;
+    char **args;
+    bool result;
+
+    env = parser->env;
+    args = &parser->args[start];
+
+    switch(count){
+        case 0:
+            return false;
+        case 1:
+            return args[0][0] != '\0';
+        case 2:
+            if(dc_strcmp(env, args[0], "!") == 0){
+                return !test_count(parser, start + 1, 1);
+            }
+
+            if(is_unary_operator(args[0])){
+                return test_unary(args[0], args[1]);
+            }
+
+            parser->error = args[0];
+            return false;
+        case 3:
+            if(is_binary_operator(env, args[1])){
+                return test_binary(parser, args[0], args[1], args[2]);
+            }
+
+            if(dc_strcmp(env, args[0], "!") == 0){
+                return !test_count(parser, start + 1, 2);
+            }
+
+            if(dc_strcmp(env, args[0], "(") == 0 && dc_strcmp(env, args[2], ")") == 0){
+                return test_count(parser, start + 1, 1);
+            }
+
+            break;
+        case 4:
+            if(dc_strcmp(env, args[0], "!") == 0){
+                return !test_count(parser, start + 1, 3);
+            }
+
+            if(dc_strcmp(env, args[0], "(") == 0 && dc_strcmp(env, args[3], ")") == 0){
+                return test_count(parser, start + 1, 2);
+            }
+
+            break;
+        default:
+            break;
+    }
+
+    parser->pos = start;
+    result = test_or(parser);
+
+    if(parser->error == NULL && parser->pos != start + count){
+        parser->error = parser->args[parser->pos];
+    }
+
+    return result;
+}
+
+/**
+ * expression: and [-o expression]
+ *
+ * @param parser the arguments.
+ * @return the value of the expression.
+ */
+static bool test_or(struct test_parser *parser){
+    bool result;
+
+    result = test_and(parser);
+
+    while(parser->error == NULL && parser->pos < parser->count &&
+          dc_strcmp(parser->env, parser->args[parser->pos], "-o") == 0){
+        bool right;
+
+        parser->pos++;
+        right = test_and(parser);
+        result = result || right;
+    }
+
+    return result;
+}
+
+/**
+ * and: not [-a and]
+ *
+ * @param parser the arguments.
+ * @return the value of the expression.
+ */
+static bool test_and(struct test_parser *parser){
+    bool result;
+
+    result = test_not(parser);
+
+    while(parser->error == NULL && parser->pos < parser->count &&
+          dc_strcmp(parser->env, parser->args[parser->pos], "-a") == 0){
+        bool right;
+
+        parser->pos++;
+        right = test_not(parser);
+        result = result && right;
+    }
+
+    return result;
+}
+
+/**
+ * not: ! not | primary
+ *
+ * @param parser the arguments.
+ * @return the value of the expression.
+ */
+static bool test_not(struct test_parser *parser){
+    if(parser->pos < parser->count && dc_strcmp(parser->env, parser->args[parser->pos], "!") == 0){
+        parser->pos++;
+
+        return !test_not(parser);
+    }
+
+    return test_primary(parser);
+}
+
+/**
+ * primary: ( expression ) | unary-operator operand | operand binary-operator operand | operand
+ *
+ * @param parser the arguments.
+ * @return the value of the expression.
+ */
+static bool test_primary(struct test_parser *parser){
+    const struct dc_posix_env *env;
+    char **args;
+    size_t left;
+    bool result;
+
+    env = parser->env;
+    args = &parser->args[parser->pos];
+    left = parser->count - parser->pos;
+
+    if(left == 0){
+        parser->error = parser->count > 0 ? parser->args[parser->count - 1] : "";
+        return false;
+    }
+
+    if(dc_strcmp(env, args[0], "(") == 0){
+        parser->pos++;
+        result = test_or(parser);
+
+        if(parser->error == NULL){
+            if(parser->pos >= parser->count || dc_strcmp(env, parser->args[parser->pos], ")") != 0){
+                parser->error = args[0];
+            } else{
+                parser->pos++;
+            }
+        }
+
+        return result;
+    }
+
+    if(left >= 3 && is_binary_operator(env, args[1])){
+        parser->pos += 3;
+
+        return test_binary(parser, args[0], args[1], args[2]);
+    }
+
+    if(left >= 2 && is_unary_operator(args[0])){
+        parser->pos += 2;
+
+        return test_unary(args[0], args[1]);
+    }
+
+    parser->pos++;
+
+    return args[0][0] != '\0';
+}
+
+/**
+ * Check for a test operator that takes one operand.
+ *
+ * @param arg the argument.
+ * @return true if arg is -b -c -d -e -f -g -h -L -n -p -r -s -S -t -u -w -x or -z.
+ */
+static bool is_unary_operator(const char *arg){
+    return arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0' && strchr("bcdefghLnprsStuwxz", arg[1]) != NULL;
+}
+
+/**
+ * Check for a test operator that takes two operands.
+ *
+ * @param env the posix environment.
+ * @param arg the argument.
+ * @return true if arg is = != -eq -ne -gt -ge -lt or -le.
+ */
+static bool is_binary_operator(const struct dc_posix_env *env, const char *arg){
+    static const char *operators[] = {"=", "!=", "-eq", "-ne", "-gt", "-ge", "-lt", "-le"};
+
+    for(size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++){
+        if(dc_strcmp(env, arg, operators[i]) == 0){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Apply a unary operator, a file that cannot be stat'd fails every file test.
+ *
+ * @param op the operator (see is_unary_operator).
+ * @param arg the operand.
+ * @return the result.
+ */
+static bool test_unary(const char *op, const char *arg){
+    struct stat info;
+    intmax_t fd;
+
+    switch(op[1]){
+        case 'n':
+            return arg[0] != '\0';
+        case 'z':
+            return arg[0] == '\0';
+        case 't':
+            return parse_integer(arg, &fd) && fd >= 0 && fd <= INT_MAX && isatty((int) fd);
+        case 'r':
+            return faccessat(AT_FDCWD, arg, R_OK, AT_EACCESS) == 0;
+        case 'w':
+            return faccessat(AT_FDCWD, arg, W_OK, AT_EACCESS) == 0;
+        case 'x':
+            return faccessat(AT_FDCWD, arg, X_OK, AT_EACCESS) == 0;
+        case 'h':
+        case 'L':
+            return lstat(arg, &info) == 0 && S_ISLNK(info.st_mode);
+        default:
+            break;
+    }
+
+    if(stat(arg, &info) != 0){
+        return false;
+    }
+
+    switch(op[1]){
+        case 'b':
+            return S_ISBLK(info.st_mode);
+        case 'c':
+            return S_ISCHR(info.st_mode);
+        case 'd':
+            return S_ISDIR(info.st_mode);
+        case 'f':
+            return S_ISREG(info.st_mode);
+        case 'g':
+            return (info.st_mode & S_ISGID) != 0;
+        case 'p':
+            return S_ISFIFO(info.st_mode);
+        case 's':
+            return info.st_size > 0;
+        case 'S':
+            return S_ISSOCK(info.st_mode);
+        case 'u':
+            return (info.st_mode & S_ISUID) != 0;
+        default:
+            // -e
+            return true;
+    }
+}
+
+/**
+ * Apply a binary operator.
+ *
+ * @param parser the arguments, the error is set if an integer comparison has a non integer.
+ * @param left the left operand.
+ * @param op the operator (see is_binary_operator).
+ * @param right the right operand.
+ * @return the result.
+ */
+static bool test_binary(struct test_parser *parser, const char *left, const char *op, const char *right){
+    intmax_t left_value;
+    intmax_t right_value;
+
+    if(op[0] == '='){
+        return dc_strcmp(parser->env, left, right) == 0;
+    }
+
+    if(op[0] == '!'){
+        return dc_strcmp(parser->env, left, right) != 0;
+    }
+
+    if(!parse_integer(left, &left_value)){
+        parser->error = left;
+        return false;
+    }
+
+    if(!parse_integer(right, &right_value)){
+        parser->error = right;
+        return false;
+    }
+
+    switch(op[1]){
+        case 'e':
+            return left_value == right_value;
+        case 'n':
+            return left_value != right_value;
+        case 'g':
+            return op[2] == 't' ? left_value > right_value : left_value >= right_value;
+        default:
+            return op[2] == 't' ? left_value < right_value : left_value <= right_value;
+    }
+}
+
+/**
+ * Convert a whole argument to an integer, blanks are allowed around it.
+ *
+ * @param text the argument.
+ * @param value set to the integer.
+ * @return false if the argument is not an integer or is out of range.
+ */
+static bool parse_integer(const char *text, intmax_t *value){
+    char *end;
+
+    errno = 0;
+    *value = strtoimax(text, &end, 10);
+
+    if(end == text || errno != 0){
+        return false;
+    }
+
+    while(*end == ' ' || *end == '\t'){
+        end++;
+    }
+
+    return *end == '\0';
+}
+
+/**
+ * Print one format of builtin_printf.
+ *
+ * @param env the posix environment.
+ * @param format the format.
+ * @param args the arguments.
+ * @param count the number of args.
+ * @param next the next argument to use, advanced by each conversion.
+ * @param outstream where to print.
+ * @param errstream where to print error messages.
+ * @return false if an argument or the format was bad.
+ */
+static bool print_format(const struct dc_posix_env *env, const char *format, char **args, size_t count,
+                         size_t *next, FILE *outstream, FILE *errstream){
+    const char *p;
+    bool ok;
+    bool stop;
+
+    ok = true;
+    stop = false;
+    p = format;
+
+    while(*p != '\0' && !stop){
+        struct print_spec spec;
+        const char *start;
+        const char *arg;
+
+        if(*p == '\\'){
+            p = print_escape(p + 1, outstream, false, &stop);
+            continue;
+        }
+
+        if(*p != '%'){
+            fputc(*p, outstream);
+            p++;
+            continue;
+        }
+
+        if(p[1] == '%'){
+            fputc('%', outstream);
+            p += 2;
+            continue;
+        }
+
+        start = p;
+        p = parse_print_spec(p + 1, &spec);
+
+        if(*p == '\0' || dc_strchr(env, "diouxXcsb", *p) == NULL){
+            fprintf(errstream, "printf: %.*s: invalid directive\n", (int) (p - start) + (*p != '\0'), start);
+            return false;
+        }
+
+        arg = NULL;
+
+        if(*next < count){
+            arg = args[*next];
+            (*next)++;
+        }
+
+        if(*p == 's' || *p == 'c' || *p == 'b'){
+            print_string(&spec, *p, arg == NULL ? "" : arg, outstream, &stop);
+        } else if(!print_number(&spec, *p, arg == NULL ? "0" : arg, outstream, errstream)){
+            ok = false;
+        }
+
+        p++;
+    }
+
+    return ok;
+}
+
+/**
+ * Read the flags, width and precision of a printf conversion.
+ *
+ * @param text the text after the %.
+ * @param spec set to what was read.
+ * @return the conversion character after them.
+ */
+static const char *parse_print_spec(const char *text, struct print_spec *spec){
+    memset(spec, 0, sizeof(struct print_spec));
+    spec->precision = -1;
+
+    for(; *text != '\0' && strchr("-+ #0", *text) != NULL; text++){
+        spec->left = spec->left || *text == '-';
+        spec->plus = spec->plus || *text == '+';
+        spec->space = spec->space || *text == ' ';
+        spec->alternate = spec->alternate || *text == '#';
+        spec->zero = spec->zero || *text == '0';
+    }
+
+    for(; *text >= '0' && *text <= '9'; text++){
+        spec->width = spec->width < INT_MAX / 10 ? spec->width * 10 + (*text - '0') : INT_MAX;
+    }
+
+    if(*text == '.'){
+        spec->precision = 0;
+
+        for(text++; *text >= '0' && *text <= '9'; text++){
+            spec->precision = spec->precision < INT_MAX / 10 ? spec->precision * 10 + (*text - '0') : INT_MAX;
+        }
+    }
+
+    return text;
+}
+
+/**
+ * Print a %s, %c or %b conversion.
+ *
+ * @param spec the flags, width and precision.
+ * @param conversion s, c or b.
+ * @param arg the argument.
+ * @param stream where to print.
+ * @param stop set to true if %b found \c.
+ */
+static void print_string(const struct print_spec *spec, char conversion, const char *arg, FILE *stream,
+                         bool *stop){
+    size_t length;
+
+    if(conversion == 'b'){
+        while(*arg != '\0' && !*stop){
+            if(*arg == '\\'){
+                arg = print_escape(arg + 1, stream, true, stop);
+            } else{
+                fputc(*arg, stream);
+                arg++;
+            }
+        }
+
+        return;
+    }
+
+    length = conversion == 'c' ? (arg[0] != '\0') : strlen(arg);
+
+    if(spec->precision >= 0 && (size_t) spec->precision < length){
+        length = (size_t) spec->precision;
+    }
+
+    print_padded(spec, "", 0, arg, length, stream);
+}
+
+/**
+ * Print a %d, %i, %o, %u, %x or %X conversion. A leading ' or " gives the value of the next
+ * character.
+ *
+ * @param spec the flags, width and precision.
+ * @param conversion the conversion character.
+ * @param arg the argument.
+ * @param outstream where to print.
+ * @param errstream where to print error messages.
+ * @return false if the argument is not a number, what could be read of it is still printed.
+ */
+static bool print_number(const struct print_spec *spec, char conversion, const char *arg, FILE *outstream,
+                         FILE *errstream){
+    char digits[sizeof(uintmax_t) * 3 + 1];
+    const char *prefix;
+    const char *start;
+    char *end;
+    uintmax_t magnitude;
+    bool negative;
+    size_t length;
+    size_t zeros;
+    bool ok;
+
+    start = arg;
+    negative = false;
+    errno = 0;
+
+    if(arg[0] == '\'' || arg[0] == '"'){
+        magnitude = (unsigned char) arg[1];
+        ok = true;
+    } else{
+        while(*start == ' ' || *start == '\t'){
+            start++;
+        }
+
+        negative = *start == '-';
+        start += negative || *start == '+';
+        magnitude = strtoumax(start, &end, 0);
+        ok = end != start && *end == '\0' && errno == 0;
+    }
+
+    if(!ok){
+        fprintf(errstream, "printf: %s: invalid number\n", arg);
+    }
+
+    prefix = "";
+
+    if(conversion == 'd' || conversion == 'i'){
+        snprintf(digits, sizeof(digits), "%ju", magnitude);
+        prefix = negative ? "-" : spec->plus ? "+" : spec->space ? " " : "";
+    } else{
+        // an unsigned conversion of a negative number wraps around like C
+        magnitude = negative ? -magnitude : magnitude;
+
+        if(conversion == 'o'){
+            snprintf(digits, sizeof(digits), "%jo", magnitude);
+            prefix = spec->alternate && magnitude != 0 ? "0" : "";
+        } else if(conversion == 'x'){
+            snprintf(digits, sizeof(digits), "%jx", magnitude);
+            prefix = spec->alternate && magnitude != 0 ? "0x" : "";
+        } else if(conversion == 'X'){
+            snprintf(digits, sizeof(digits), "%jX", magnitude);
+            prefix = spec->alternate && magnitude != 0 ? "0X" : "";
+        } else{
+            snprintf(digits, sizeof(digits), "%ju", magnitude);
+        }
+    }
+
+    length = strlen(digits);
+
+    // a precision of 0 prints nothing for 0
+    if(spec->precision == 0 && magnitude == 0){
+        length = 0;
+    }
+
+    zeros = spec->precision > 0 && (size_t) spec->precision > length ? (size_t) spec->precision - length : 0;
+
+    if(spec->zero && !spec->left && spec->precision < 0 &&
+       (size_t) spec->width > strlen(prefix) + zeros + length){
+        zeros = (size_t) spec->width - strlen(prefix) - length;
+    }
+
+    print_padded(spec, prefix, zeros, digits, length, outstream);
+
+    return ok;
+}
+
+/**
+ * Print a conversion padded with spaces to the width of the spec.
+ *
+ * @param spec the flags, width and precision.
+ * @param prefix the sign or base prefix.
+ * @param zeros the number of zeros between the prefix and text.
+ * @param text the digits or string.
+ * @param length how much of text to print.
+ * @param stream where to print.
+ */
+static void print_padded(const struct print_spec *spec, const char *prefix, size_t zeros, const char *text,
+                         size_t length, FILE *stream){
+    size_t total;
+    size_t padding;
+
+    total = strlen(prefix) + zeros + length;
+    padding = spec->width > 0 && (size_t) spec->width > total ? (size_t) spec->width - total : 0;
+
+    for(size_t i = 0; !spec->left && i < padding; i++){
+        fputc(' ', stream);
+    }
+
+    fputs(prefix, stream);
+
+    for(size_t i = 0; i < zeros; i++){
+        fputc('0', stream);
+    }
+
+    fwrite(text, 1, length, stream);
+
+    for(size_t i = 0; spec->left && i < padding; i++){
+        fputc(' ', stream);
+    }
+}
+
+/**
+ * Print the character for a backslash escape.
+ *
+ * @param text the text after the backslash.
+ * @param stream where to print.
+ * @param octal_zero true if octal escapes start with 0 (\0NNN as %b uses) instead of \NNN.
+ * @param stop set to true for \c.
+ * @return the text after the escape.
+ */
+static const char *print_escape(const char *text, FILE *stream, bool octal_zero, bool *stop){
+    static const char escapes[] = "\\\\a\ab\bf\fn\nr\rt\tv\v\"\"'\'";
+    int value;
+    int digits;
+
+    if(*text == '\0'){
+        fputc('\\', stream);
+        return text;
+    }
+
+    if(*text == 'c' && octal_zero){
+        *stop = true;
+        return text + 1;
+    }
+
+    for(size_t i = 0; escapes[i] != '\0'; i += 2){
+        if(escapes[i] == *text){
+            fputc(escapes[i + 1], stream);
+            return text + 1;
+        }
+    }
+
+    if(octal_zero ? *text == '0' : (*text >= '0' && *text <= '7')){
+        if(octal_zero){
+            text++;
+        }
+
+        value = 0;
+
+        for(digits = 0; digits < 3 && *text >= '0' && *text <= '7'; digits++, text++){
+            value = value * 8 + (*text - '0');
+        }
+
+        fputc(value & 0xFF, stream);
+        return text;
+    }
+
+    // not an escape, print it as it is
+    fputc('\\', stream);
+    fputc(*text, stream);
+
+    return text + 1;
+}
@@ -1,219 +1,436 @@
-#include <dc_posix/dc_regex.h>
 #include <dc_posix/dc_stdlib.h>
 #include <dc_posix/dc_string.h>
-#include <dc_posix/dc_wordexp.h>
+#include <dc_util/path.h>
+#include <limits.h>
+#include "arena.h"
 #include "command.h"
-#include "shell_impl.h"
+#include "lexer.h"
+
+static char *terminate_word(char *line, const struct token *token, char **pending);
+static bool token_redirection(const struct token *token, enum redirection_type *type, int *fd);
+static bool parse_fd(const char *text, size_t length, int *fd);
+static bool finish_redirection(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                               struct redirection *redirection);
+static bool expand_redirect_target(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                                   char **target);
+static void append_argument(const struct dc_posix_env *env, struct dc_error *err, struct command *command,
+                            size_t *capacity, char *word);
+
 /**
  * Parse the command. Take the command->line and use it to fill in all of the fields.
+ * The line is scanned once by the lexer (see lexer_next), words become the command and
+ * its arguments, and the word after a redirection operator becomes the redirection target.
+ * A leading ~ in a redirection target is expanded to the users home directory. The word after <<
+ * is the delimiter of a here-document, the body is read later by parse_commands.
+ * Nothing is copied: the words are unquoted and NUL terminated in place, so command->command,
+ * command->argv and the redirection targets point into command->line, which no longer holds the
+ * original text afterwards. argv, the redirections and expanded file names are allocated from
+ * state->arena and live until the next reset_state.
+ * A malformed line, or a >& or <& that is not followed by a descriptor or -, raises a PARSE_ERROR
+ * user error. A ~ that cannot be expanded (no HOME or no such user) only fails the command: the
+ * error is printed to state->stderr and command->exit_code is set to 1, so pipeline_run skips it.
  *
  * @param env the posix environment.
  * @param err the error object.
- * @param state the current state, to set the fatal_error and access the command line and regex for redirection.
+ * @param state the current state, to set the fatal_error.
  * @param command the command to parse.
  */
-
 void parse_command(const struct dc_posix_env *env, struct dc_error *err, struct state *state, struct command *command){
-    regex_t regex;
-    regmatch_t match;
-    int val = 0;
-    int match_s;
-    const char *cmd;
-    cmd = dc_strdup(env, err, command->line);
-    size_t length = 0;
-
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v]2>[>]?.*", REG_EXTENDED);
-    state->err_redirect_regex = &regex;
-    error_r(env, err, val, regex);
+    struct lexer lexer;
+    struct token token;
+    bool target = false;
+    char *pending = NULL;
+    size_t capacity = 4;
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
-    }
-    char *left, *error = NULL;
-    match_s = dc_regexec(env, &regex, cmd, 1, &match, 0);
+    command->arena = state->arena;
+    command->argc = 1;
+    command->argv = arena_calloc(env, err, command->arena, capacity, sizeof(char *));
 
     if(dc_error_has_error(err)){
         state->fatal_error = true;
+        return;
     }
 
-    if(match_s == 0){
-        char *string;
+    lexer_init(&lexer, command->line, dc_strlen(env, command->line));
+
+    while(dc_error_has_no_error(err) && lexer_next(&lexer, &token) != TOKEN_END){
+        enum redirection_type type;
+        char *word;
+        int fd;
 
-        regoff_t prog = match.rm_eo - match.rm_so;
-        string = dc_malloc(env, err, ((size_t) (prog + 1)));
-        dc_strncpy(env, string, &cmd[match.rm_so], (size_t) prog);
-        string[prog] = '\0';
-        length = dc_strlen(env,string);
-        char *token = dc_strtok(env,string, ">");
-        while (token != NULL)
-        {
-            error = dc_strdup(env, err, token);
-            token = dc_strtok(env, NULL, ">");
+        // the previous word ended where this token starts, the lexer is past it now
+        if(pending != NULL){
+            *pending = '\0';
+            pending = NULL;
         }
-        error = trim(error);
-        free(string);
-    }
 
-    size_t l = dc_strlen(env,cmd);
+        if(token.type != TOKEN_WORD && target){
+            DC_ERROR_RAISE_USER(err, "syntax error: expected a file name after a redirection", PARSE_ERROR);
+            break;
+        }
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+        switch(token.type){
+            case TOKEN_WORD:
+                word = terminate_word(command->line, &token, &pending);
+
+                if(target){
+                    command->redirections[command->redirection_count - 1].target = word;
+                    target = false;
+                } else if(command->command == NULL){
+                    command->command = word;
+                } else{
+                    append_argument(env, err, command, &capacity, word);
+                }
+
+                if(dc_error_has_error(err)){
+                    state->fatal_error = true;
+                }
+                break;
+            case TOKEN_REDIRECT_IN:
+            case TOKEN_REDIRECT_OUT:
+            case TOKEN_APPEND_OUT:
+            case TOKEN_REDIRECT_ERR:
+            case TOKEN_APPEND_ERR:
+            case TOKEN_DUP_IN:
+            case TOKEN_DUP_OUT:
+            case TOKEN_HERE_DOC:
+            case TOKEN_HERE_STRING:
+                if(!token_redirection(&token, &type, &fd)){
+                    DC_ERROR_RAISE_USER(err, "syntax error: bad file descriptor", PARSE_ERROR);
+                    break;
+                }
+
+                command_add_redirection(env, err, command, type, fd, NULL, -1);
+                target = true;
+
+                if(dc_error_has_error(err)){
+                    state->fatal_error = true;
+                }
+                break;
+            case TOKEN_ERROR:
+                DC_ERROR_RAISE_USER(err, "syntax error: unterminated quote", PARSE_ERROR);
+                break;
+            case TOKEN_PIPE:
+            case TOKEN_SEQUENCE:
+            case TOKEN_AND:
+            case TOKEN_OR:
+            case TOKEN_BACKGROUND:
+            case TOKEN_END:
+            default:
+                break;
+        }
     }
 
-    left = dc_malloc(env, err, l - length);
+    if(pending != NULL){
+        *pending = '\0';
+    }
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+    if(dc_error_has_no_error(err)){
+        if(target){
+            DC_ERROR_RAISE_USER(err, "syntax error: expected a file name after a redirection", PARSE_ERROR);
+        } else if(command->command == NULL){
+            DC_ERROR_RAISE_USER(err, "syntax error: missing command", PARSE_ERROR);
+        }
     }
 
-    dc_strncpy(env,left, cmd, l - length);
+    // the targets are only NUL terminated once the whole line has been scanned
+    for(size_t i = 0; i < command->redirection_count && dc_error_has_no_error(err); i++){
+        if(!finish_redirection(env, err, command->arena, &command->redirections[i])){
+            // like a file that cannot be opened, the other commands of the line still run
+            fprintf(state->stderr, "%s: %s\n", command->redirections[i].target, err->message);
+            dc_error_reset(err);
+            command->exit_code = 1;
+            break;
+        }
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+        // a bad descriptor is a syntax error, anything else is out of memory
+        if(dc_error_has_error(err) && command->redirections[i].type != REDIRECT_DUP){
+            state->fatal_error = true;
+        }
     }
+}
 
-    if(error != NULL){
-        state->command->stderr_overwrite = true;
+/**
+ * Add a redirection after the ones the command has. The redirections of a parsed command grow in
+ * command->arena, a command built by hand with command->arena set to NULL owns them and the target.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param command the command.
+ * @param type what the redirection does.
+ * @param fd the descriptor that is redirected.
+ * @param target the file or here-string, NULL for REDIRECT_DUP and REDIRECT_CLOSE.
+ * @param target_fd the descriptor REDIRECT_DUP copies, -1 otherwise.
+ */
+void command_add_redirection(const struct dc_posix_env *env, struct dc_error *err, struct command *command,
+                             enum redirection_type type, int fd, char *target, int target_fd){
+    struct redirection *redirections;
+    size_t count = command->redirection_count;
+
+    if(command->arena != NULL){
+        redirections = arena_realloc(env, err, command->arena, command->redirections,
+                                     count * sizeof(struct redirection), (count + 1) * sizeof(struct redirection));
+    } else{
+        redirections = dc_realloc(env, err, command->redirections, (count + 1) * sizeof(struct redirection));
     }
 
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v][1^2]?>[>]?.*", REG_EXTENDED);
-    state->out_redirect_regex = &regex;
-    error_r(env, err, val, regex);
-
     if(dc_error_has_error(err)){
-        state->fatal_error = true;
+        return;
     }
 
-    char *out;
-    match_s = dc_regexec(env, &regex, left, 1, &match, 0);
+    redirections[count].type = type;
+    redirections[count].fd = fd;
+    redirections[count].target = target;
+    redirections[count].target_fd = target_fd;
+    command->redirections = redirections;
+    command->redirection_count = count + 1;
+}
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+/**
+ * Unquote a word in place. A word that loses quotes or backslashes is NUL terminated inside its
+ * own text. Otherwise the NUL belongs on the character after the word, which the lexer still has
+ * to read, so it is left in *pending for the caller to write once the next token is scanned.
+ *
+ * @param line the line the token was scanned from.
+ * @param token the word.
+ * @param pending set to where the NUL must be written, or NULL if it has been written.
+ * @return the word.
+ */
+static char *terminate_word(char *line, const struct token *token, char **pending){
+    char *word = line + (token->text - line);
+    size_t length;
+
+    length = lexer_unquote_in_place(word, token->length);
+
+    if(length < token->length){
+        word[length] = '\0';
+        *pending = NULL;
+    } else{
+        *pending = &word[length];
     }
 
-    if(match_s == 0){
-        char *string;
+    return word;
+}
 
-        regoff_t prog = match.rm_eo - match.rm_so;
-        string = dc_malloc(env, err, ((size_t) (prog + 1)));
-        dc_strncpy(env, string, &left[match.rm_so], (size_t) prog);
-        string[prog] = '\0';
-        length = dc_strlen(env,string);
-        char *token = dc_strtok(env,string, ">>");
-        while (token != NULL)
-        {
-            out = dc_strdup(env, err, token);
-            token = dc_strtok(env, NULL, ">>");
-        }
-        out = trim(out);
-        free(string);
+/**
+ * Get what a redirection operator does, and to which descriptor.
+ *
+ * @param token the operator, with the digits of the descriptor in front of it if it has them.
+ * @param type set to what the redirection does.
+ * @param fd set to the descriptor, 0 for an input and 1 for an output without digits.
+ * @return false if the descriptor is too big.
+ */
+static bool token_redirection(const struct token *token, enum redirection_type *type, int *fd){
+    size_t digits = 0;
+
+    while(token->text[digits] >= '0' && token->text[digits] <= '9'){
+        digits++;
     }
-    l = dc_strlen(env,left);
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+    switch(token->type){
+        case TOKEN_REDIRECT_IN:
+            *type = REDIRECT_INPUT;
+            *fd = 0;
+            break;
+        case TOKEN_REDIRECT_OUT:
+        case TOKEN_REDIRECT_ERR:
+            *type = REDIRECT_OUTPUT;
+            *fd = 1;
+            break;
+        case TOKEN_APPEND_OUT:
+        case TOKEN_APPEND_ERR:
+            *type = REDIRECT_APPEND;
+            *fd = 1;
+            break;
+        case TOKEN_DUP_IN:
+            *type = REDIRECT_DUP;
+            *fd = 0;
+            break;
+        case TOKEN_DUP_OUT:
+            *type = REDIRECT_DUP;
+            *fd = 1;
+            break;
+        case TOKEN_HERE_DOC:
+            *type = REDIRECT_HERE_DOC;
+            *fd = 0;
+            break;
+        case TOKEN_HERE_STRING:
+            *type = REDIRECT_HERE_STRING;
+            *fd = 0;
+            break;
+        case TOKEN_END:
+        case TOKEN_ERROR:
+        case TOKEN_WORD:
+        case TOKEN_PIPE:
+        case TOKEN_SEQUENCE:
+        case TOKEN_AND:
+        case TOKEN_OR:
+        case TOKEN_BACKGROUND:
+        default:
+            return false;
     }
 
-    char *second = dc_malloc(env, err, l - length);
+    return digits == 0 || parse_fd(token->text, digits, fd);
+}
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+/**
+ * Convert the digits of a descriptor.
+ *
+ * @param text the digits.
+ * @param length the number of digits.
+ * @param fd set to the descriptor.
+ * @return false if there are no digits, or something that is not one, or the number is too big.
+ */
+static bool parse_fd(const char *text, size_t length, int *fd){
+    int value = 0;
+
+    if(length == 0){
+        return false;
     }
 
-    strncpy(second, left, l -length);
+    for(size_t i = 0; i < length; i++){
+        if(text[i] < '0' || text[i] > '9' || value > (INT_MAX - (text[i] - '0')) / 10){
+            return false;
+        }
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+        value = value * 10 + (text[i] - '0');
     }
 
+    *fd = value;
 
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v]<.*", REG_EXTENDED);
-    state->in_redirect_regex = &regex;
-
-    error_r(env, err, val, regex);
+    return true;
+}
 
-    if(dc_error_has_error(err)){
-        state->fatal_error = true;
+/**
+ * Finish a redirection once its target is NUL terminated: expand a leading ~ in a file name, and
+ * turn the target of >& and <& into the descriptor it copies, or into a REDIRECT_CLOSE for -.
+ *
+ * @param env the posix environment.
+ * @param err the error object, a PARSE_ERROR user error if a >& or <& is not followed by a descriptor.
+ * @param arena the arena to allocate an expanded file name from.
+ * @param redirection the redirection.
+ * @return false if a ~ could not be expanded, err is set and the target is left as it was.
+ */
+static bool finish_redirection(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                               struct redirection *redirection){
+    switch(redirection->type){
+        case REDIRECT_INPUT:
+        case REDIRECT_OUTPUT:
+        case REDIRECT_APPEND:
+            return expand_redirect_target(env, err, arena, &redirection->target);
+        case REDIRECT_DUP:
+            if(dc_strcmp(env, redirection->target, "-") == 0){
+                redirection->type = REDIRECT_CLOSE;
+            } else if(!parse_fd(redirection->target, dc_strlen(env, redirection->target), &redirection->target_fd)){
+                DC_ERROR_RAISE_USER(err, "syntax error: expected a file descriptor or - after >& or <&", PARSE_ERROR);
+            }
+            break;
+        case REDIRECT_CLOSE:
+        case REDIRECT_HERE_DOC:
+        case REDIRECT_HERE_STRING:
+        default:
+            break;
     }
 
-    char *in;
-    match_s =  dc_regexec(env, &regex, second, 1, &match, 0);
+    return true;
+}
 
-    if(match_s == 0){
-        char *string;
+/**
+ * Expand a leading ~ in a redirection file name to the users home directory.
+ *
+ * @param env the posix environment.
+ * @param err the error object, nothing is done if it already has an error.
+ * @param arena the arena to allocate the expanded file name from.
+ * @param target the file name of a redirection.
+ * @return false if the ~ could not be expanded, err is set and the target is left as it was.
+ */
+static bool expand_redirect_target(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                                   char **target){
+    if(dc_error_has_no_error(err) && *target != NULL && (*target)[0] == '~'){
+        char *expanded;
 
-        regoff_t prog = match.rm_eo - match.rm_so;
-        string = dc_malloc(env, err, ((size_t) (prog + 1)));
-        dc_strncpy(env, string, &left[match.rm_so], (size_t) prog);
-        string[prog] = '\0';
-        length = dc_strlen(env,string);
-        char *token = dc_strtok(env,string, "<");
-        while (token != NULL)
-        {
-            in = dc_strdup(env, err, token);
-            token = dc_strtok(env, NULL, "<");
-        }
-        in = trim(in);
-        free(string);
-    }
-    char *com_line;
-    l = dc_strlen(env,second);
-    com_line = dc_malloc(env, err,l - length);
-    dc_strncpy(env, com_line, second, l-length);
+        dc_expand_path(env, err, &expanded, *target);
 
+        if(dc_error_has_error(err)){
+            return false;
+        }
 
+        *target = arena_strndup(env, err, arena, expanded, dc_strlen(env, expanded));
+        free(expanded);
+    }
 
+    return true;
 }
 
-char* trim(const char* str)
-{
-    static char str1[99];
-    int count = 0, j, k;
+/**
+ * Add an argument to the end of command->argv, keeping argv NULL terminated.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param command the command.
+ * @param capacity the number of slots in command->argv, updated if argv grows.
+ * @param word the argument.
+ */
+static void append_argument(const struct dc_posix_env *env, struct dc_error *err, struct command *command,
+                            size_t *capacity, char *word){
+    if(command->argc + 1 >= *capacity){
+        char **argv;
 
-    while (str[count] == ' ') {
-        count++;
-    }
+        argv = arena_realloc(env, err, command->arena, command->argv, *capacity * sizeof(char *),
+                             *capacity * 2 * sizeof(char *));
+
+        if(dc_error_has_error(err)){
+            return;
+        }
 
-    for (j = count, k = 0;
-         str[j] != '\0'; j++, k++) {
-        str1[k] = str[j];
+        command->argv = argv;
+        *capacity *= 2;
     }
-    str1[k] = '\0';
 
-    return str1;
+    command->argv[command->argc] = word;
+    command->argc++;
+    command->argv[command->argc] = NULL;
 }
 
-
 /**
+ * Free the fields of the command and set them to NULL, 0 or false.
+ * A parsed command owns nothing: line, argv and the redirections belong to command->arena, and
+ * command, the arguments and the redirection targets point into line, so the fields are only cleared.
+ * A command built by hand with command->arena set to NULL owns each field, and they are freed.
  *
- * @param env
- * @param command
+ * @param env the posix environment.
+ * @param command the command to destroy, may be NULL.
  */
 void destroy_command(const struct dc_posix_env *env, struct command *command){
     if(command != NULL){
-        command->stdout_file = NULL;
-        command->stderr_file = NULL;
-        command->stdin_file = NULL;
+        if(command->arena == NULL){
+            for(size_t i = 0; i < command->redirection_count; i++){
+                free(command->redirections[i].target);
+            }
 
-        free(command->command);
-        command->command = NULL;
+            free(command->redirections);
+            free(command->command);
+
+            if(command->argv != NULL){
+                for (size_t i =0; i < (command->argc); i++){
+                    free(command->argv[i]);
+                }
 
-        for (size_t i =0; i < (command->argc); i++){
-            if(command->argv[i]){
-                free(command->argv[i]);
-                command->argv[i] = NULL;
+                free(command->argv);
             }
+
+            dc_free(env, command->line, sizeof(command->line));
         }
 
+        command->redirections = NULL;
+        command->redirection_count = 0;
+        command->command = NULL;
+        command->program = NULL;
+        command->argv = NULL;
         command->argc = 0;
-
-        dc_free(env, command->line, sizeof(command->line));
         command->line = NULL;
-
         command->exit_code = 0;
-
-        command->stdout_overwrite = false;
-
-        command->stderr_overwrite = false;
+        command->separator = SEPARATOR_END;
+        command->arena = NULL;
     }
 }
@@ -1,168 +1,816 @@
+#define _GNU_SOURCE
 #include <dc_posix/dc_unistd.h>
 #include <dc_posix/dc_stdlib.h>
 #include <dc_posix/dc_fcntl.h>
 #include <dc_posix/dc_string.h>
 #include <dc_posix/dc_stdio.h>
+#include <dc_posix/sys/dc_wait.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include "execute.h"
+#include "path_cache.h"
+#include "util.h"
+
+/**
+ * The permissions for a file created by a redirection, before the umask.
+ */
+#define REDIRECT_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
+
+static int open_redirection(const struct dc_posix_env *env, struct dc_error *err, const char *file, int flags,
+                            int floor);
+static int open_here_text(const struct dc_posix_env *env, struct dc_error *err, const char *text, bool newline,
+                          int floor);
+static int write_text(int fd, const char *text, size_t length);
+static int move_above(struct dc_error *err, int fd, int floor);
+static bool copies_open_fd(const struct exec_plan *plan, int fd);
+static void add_dup(struct exec_plan *plan, int from, int to, bool opened);
+static int follow_dups(const struct exec_dup *dups, size_t count, int fd);
+static bool make_candidate(char *candidate, const char *dir, const char *name);
+static int resolve(struct exec_plan *plan, const struct command *command, char **path);
+static void exec_program(const struct path_cache_entry *program, char **argv, char **envp);
+static pid_t spawn_fork(const struct dc_posix_env *env, struct dc_error *err, const struct exec_plan *plan,
+                        int *error_code);
+static pid_t spawn_posix(const struct exec_plan *plan, int *error_code);
+static pid_t spawn_vfork(const struct exec_plan *plan, int *error_code);
+static void child_signal_mask(sigset_t *mask);
 
 /**
  * Create a child process, exec the command with any redirection, set the exit code.
- * If there is an err executing the command print an err message.
- * If the command cannot be found set the command->exit_code to 127.
+ * If there is an err executing the command print an err message to stderr.
+ * If the command cannot be found set the command->exit_code to 127, 126 if it cannot be run.
+ * A command->program that was already resolved is exec'd without searching the path.
+ *
+ * Every backend runs a plan made by the shell (see exec_plan_init). SPAWN_POSIX_SPAWN and
+ * SPAWN_VFORK start the child without copying the page tables of the shell, SPAWN_FORK copies them.
  *
  * @param env the posix environment.
  * @param err the err object
  * @param command the command to execute
  * @param path the directories to search for the command
+ * @param backend how to create the child process
  */
-void execute(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path){
-    pid_t f;
-    int s = 0;
+void execute(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path,
+             enum spawn_backend backend){
+    static const int no_pipe[3] = {-1, -1, -1};
+    pid_t pid;
 
-    f = fork();
+    pid = execute_start(env, err, command, path, backend, no_pipe, stderr);
 
-    if(f == 0){
-        redirect(env, err, command);
+    if(pid > 0){
+        execute_wait(env, err, command, pid);
+    }
+}
 
-        if(dc_error_has_error(err)){
-            dc_exit(env, 126);
-        }
-        run(env, err, command, path);
-        s = handle_run_error(err);
-        dc_exit(env, s);
-    } else {
-        waitpid(f, &s, 0);
-        if(WIFEXITED(s)){
-            int num;
-            num = WEXITSTATUS(s);
-            command->exit_code = num;
+/**
+ * Start a child for the command without waiting for it, so the stages of a pipeline run at the
+ * same time. The child reads from std_fds[0] and writes to std_fds[1] and std_fds[2], unless the
+ * command redirects them to a file. The std_fds are left open, they should be O_CLOEXEC so only
+ * the copies on 0, 1 and 2 reach the program.
+ * If the command could not be started the command->exit_code is set and -1 is returned.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param command the command to execute
+ * @param path the directories to search for the command
+ * @param backend how to create the child process
+ * @param std_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ * @param messages where to print why the command could not be started, the state->stderr of the shell.
+ * @return the child to pass to execute_wait, or -1.
+ */
+pid_t execute_start(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path,
+                    enum spawn_backend backend, const int std_fds[3], FILE *messages){
+    struct exec_plan plan;
+    int error_code = 0;
+    pid_t pid;
+
+    exec_plan_init(env, err, &plan, command, path, std_fds);
+
+    if(dc_error_has_error(err)){
+        // the file could not be opened, report it like a child that failed to redirect
+        fprintf(messages, "%s\n", err->message);
+        dc_error_reset(err);
+        command->argv[0] = NULL;
+        command->exit_code = 1;
+        return -1;
+    }
+
+    if(plan.error != 0){
+        // nothing to exec, there is no need for a child to find that out
+        pid = -1;
+        error_code = plan.error;
+    } else if(backend == SPAWN_FORK){
+        pid = spawn_fork(env, err, &plan, &error_code);
+    } else if(backend == SPAWN_VFORK){
+        pid = spawn_vfork(&plan, &error_code);
+    } else{
+        pid = spawn_posix(&plan, &error_code);
+    }
+
+    exec_plan_destroy(env, err, &plan);
+    command->argv[0] = NULL;
+
+    if(error_code != 0){
+        // a child that failed to exec has exited already or is about to, it is reaped here
+        if(pid > 0){
+            execute_wait(env, err, command, pid);
         }
+
+        command->exit_code = handle_run_error(messages, command->command, error_code);
+
+        return -1;
     }
 
+    return pid;
 }
 
+/**
+ * Print why a command could not be run and get its exit code. The shell always knows the errno,
+ * so the exit code only says if the command was found, it cannot be taken for one the program chose.
+ *
+ * @param messages the stream to print to.
+ * @param name the command.
+ * @param error the errno from resolving or starting the command.
+ * @return 127 if the command was not found, 126 if it was found but could not be run.
+ */
+int handle_run_error(FILE *messages, const char *name, int error){
+    fprintf(messages, "%s: %s\n", name, strerror(error));
+
+    return error == ENOENT ? 127 : 126;
+}
 
-int handle_run_error(struct dc_error *err){
+/**
+ * Plan the exec of a command: open its redirections, find the file to exec and list the dup2s,
+ * a redirection wins over std_fds. A command that is not found sets plan->error, the
+ * plan is still destroyed with exec_plan_destroy.
+ *
+ * @param env the posix environment.
+ * @param err the err object, set if a redirection could not be opened (nothing is left open).
+ * @param plan the plan to fill in.
+ * @param command the command, command->argv[0] is set to command->command.
+ * @param path the directories to search for a command without a / that has no command->program.
+ * @param std_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ */
+void exec_plan_init(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan,
+                    struct command *command, char **path, const int std_fds[3]){
+    command->argv[0] = command->command;
+    plan->program = command->program;
+    plan->file[0] = '\0';
+    plan->argv = command->argv;
+    plan->envp = environ;
+    plan->error = 0;
+    child_signal_mask(&plan->mask);
+    open_redirections(env, err, command, std_fds, plan);
 
-    if(dc_error_is_errno(err, E2BIG)){
-        fprintf(stderr, "Argument list too long");
-        return 1;
+    if(dc_error_has_error(err)){
+        return;
     }
-    else if(dc_error_is_errno(err, EACCES)){
-        fprintf(stderr, "Permission denied");
-        return 2;
+
+    plan->error = resolve(plan, command, path);
+}
+
+/**
+ * Carry out a plan in a child: set the signal mask, make the dup2s and exec. Only makes
+ * async-signal-safe calls. Only returns if something failed.
+ *
+ * @param plan the plan.
+ * @return the errno of what failed.
+ */
+int exec_plan_run(const struct exec_plan *plan){
+    sigprocmask(SIG_SETMASK, &plan->mask, NULL);
+
+    for(size_t i = 0; i < plan->dup_count; i++){
+        const struct exec_dup *dup = &plan->dups[i];
+
+        // closing a descriptor that is not open is not an error, as in sh
+        if(dup->from == -1){
+            close(dup->to);
+        } else if(dup->from == dup->to){
+            // a dup2 onto itself would keep O_CLOEXEC, the flag is cleared instead
+            if(fcntl(dup->to, F_SETFD, 0) == -1){
+                return errno;
+            }
+        } else if(dup2(dup->from, dup->to) == -1){
+            return errno;
+        }
     }
-    else if(dc_error_is_errno(err,EINVAL)){
-        fprintf(stderr, "Invalid argument");
-        return 3;
+
+    if(plan->program != NULL){
+        exec_program(plan->program, plan->argv, plan->envp);
+    } else{
+        execve(plan->file, plan->argv, plan->envp);
     }
-    else if(dc_error_is_errno(err,ELOOP)){
-        fprintf(stderr, "Too many symbolic links encountered");
-        return 4;
+
+    return errno;
+}
+
+/**
+ * Close the redirections a plan opened, once the child has started.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param plan the plan.
+ */
+void exec_plan_destroy(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan){
+    close_redirections(env, err, plan);
+}
+
+/**
+ * List the dup2s for std_fds and the redirections of the command, in order, opening the files and
+ * the text of here-documents and here-strings with O_CLOEXEC so only the copies the child dup2s
+ * survive the exec. They are opened above every descriptor that is redirected, so no dup2
+ * overwrites one before it is copied.
+ *
+ * @param env the posix environment.
+ * @param err the err object, set if a file could not be opened or a >&m copies a descriptor that
+ *            is not open (nothing is left open).
+ * @param command the command.
+ * @param std_fds the stdin, stdout and stderr of the child, -1 or NULL to use the ones of the shell.
+ * @param plan set to the dup2s, close them with close_redirections.
+ */
+void open_redirections(const struct dc_posix_env *env, struct dc_error *err, const struct command *command,
+                       const int std_fds[3], struct exec_plan *plan){
+    int floor = STDERR_FILENO + 1;
+
+    plan->dup_count = 0;
+    plan->dups = dc_malloc(env, err, (3 + command->redirection_count) * sizeof(struct exec_dup));
+
+    if(dc_error_has_error(err)){
+        return;
     }
-    else if(dc_error_is_errno(err,ENAMETOOLONG)){
-        fprintf(stderr, "File name too long");
-        return 5;
+
+    for(int i = 0; i < 3 && std_fds != NULL; i++){
+        if(std_fds[i] != -1){
+            add_dup(plan, std_fds[i], i, false);
+        }
     }
-    else if(dc_error_is_errno(err,ENOENT)){
-        fprintf(stderr, "No such file or directory");
-        return 127;
+
+    for(size_t i = 0; i < command->redirection_count; i++){
+        if(command->redirections[i].fd >= floor && command->redirections[i].fd < INT_MAX){
+            floor = command->redirections[i].fd + 1;
+        }
     }
-    else if(dc_error_is_errno(err,ENOTDIR)){
-        fprintf(stderr, "Not a directory");
-        return 6;
+
+    for(size_t i = 0; i < command->redirection_count && dc_error_has_no_error(err); i++){
+        const struct redirection *redirection = &command->redirections[i];
+        int from;
+
+        switch(redirection->type){
+            case REDIRECT_INPUT:
+                from = open_redirection(env, err, redirection->target, O_RDONLY, floor);
+                break;
+            case REDIRECT_OUTPUT:
+                from = open_redirection(env, err, redirection->target, O_WRONLY | O_CREAT | O_TRUNC, floor);
+                break;
+            case REDIRECT_APPEND:
+                from = open_redirection(env, err, redirection->target, O_WRONLY | O_CREAT | O_APPEND, floor);
+                break;
+            case REDIRECT_HERE_DOC:
+                from = open_here_text(env, err, redirection->target, false, floor);
+                break;
+            case REDIRECT_HERE_STRING:
+                from = open_here_text(env, err, redirection->target, true, floor);
+                break;
+            case REDIRECT_DUP:
+                from = redirection->target_fd;
+
+                if(!copies_open_fd(plan, from)){
+                    DC_ERROR_RAISE_ERRNO(err, EBADF);
+                }
+                break;
+            case REDIRECT_CLOSE:
+            default:
+                from = -1;
+                break;
+        }
+
+        if(dc_error_has_no_error(err)){
+            add_dup(plan, from, redirection->fd,
+                    redirection->type != REDIRECT_DUP && redirection->type != REDIRECT_CLOSE);
+        }
     }
-    else if(dc_error_is_errno(err,ENOEXEC)){
-        fprintf(stderr, "Exec format error");
-        return 7;
+
+    if(dc_error_has_error(err)){
+        close_redirections(env, err, plan);
     }
-    else if(dc_error_is_errno(err,ENOMEM)){
-        fprintf(stderr, "Out of memory");
-        return 8;
+}
+
+/**
+ * Close the files opened by open_redirections and forget the dup2s.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param plan the plan.
+ */
+void close_redirections(const struct dc_posix_env *env, struct dc_error *err, struct exec_plan *plan){
+    if(plan->dups == NULL){
+        return;
     }
-    else if(dc_error_is_errno(err,ETXTBSY)){
-        fprintf(stderr, "Text file busy");
-        return 9;
-    } else{
-        return 125;
+
+    for(size_t i = 0; i < plan->dup_count; i++){
+        if(plan->dups[i].opened){
+            dc_close(env, err, plan->dups[i].from);
+        }
     }
+
+    dc_free(env, plan->dups, plan->dup_count * sizeof(struct exec_dup));
+    plan->dups = NULL;
+    plan->dup_count = 0;
 }
 
-void redirect(const struct dc_posix_env *env, struct dc_error *err, struct command *command){
+/**
+ * Follow the dup2s of a plan back to the descriptor of the shell that a descriptor ends up as,
+ * for a builtin that runs in the shell without making them.
+ *
+ * @param plan the plan.
+ * @param fd the descriptor.
+ * @return the descriptor of the shell, fd itself if it is not redirected, -1 if it is closed.
+ */
+int redirected_fd(const struct exec_plan *plan, int fd){
+    return follow_dups(plan->dups, plan->dup_count, fd);
+}
 
-    if(command->stdin_file != NULL){
-        int d = dc_open(env, err, command->stdin_file, O_RDWR);
+/**
+ * Open one redirection file.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param file the file to open.
+ * @param flags the flags for open, O_CLOEXEC is added.
+ * @param floor the lowest descriptor the file may be on.
+ * @return the open file or -1.
+ */
+static int open_redirection(const struct dc_posix_env *env, struct dc_error *err, const char *file, int flags,
+                            int floor){
+    int fd;
 
-        if(dc_error_has_error(err)){
-            dc_close(env, err, d);
+    fd = dc_open(env, err, file, flags | O_CLOEXEC, REDIRECT_MODE);
+
+    if(dc_error_has_error(err)){
+        return -1;
+    }
+
+    return move_above(err, fd, floor);
+}
+
+/**
+ * Put the text of a here-document or here-string where the command can read it without a file
+ * on disk: a pipe if it fits in the pipe without blocking, otherwise a sealed memfd (or an
+ * unlinked file where there is no memfd_create) rewound to the start.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param text the text.
+ * @param newline add a newline after the text, for a here-string.
+ * @param floor the lowest descriptor the text may be on.
+ * @return the descriptor to read the text from, or -1.
+ */
+static int open_here_text(const struct dc_posix_env *env, struct dc_error *err, const char *text, bool newline,
+                          int floor){
+    size_t length = strlen(text);
+    int error;
+    int fd;
+
+    if(length + (newline ? 1 : 0) <= PIPE_BUF){
+        int fds[2];
+
+        if(pipe2(fds, O_CLOEXEC) == -1){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+            return -1;
         }
 
-        dc_dup2(env, err, d, STDIN_FILENO);
+        // the write end is closed, so the command reads the end of the text after it
+        error = write_text(fds[1], text, length);
 
-        dc_close(env, err, d);
+        if(error == 0 && newline){
+            error = write_text(fds[1], "\n", 1);
+        }
 
-    } else if(command->stdout_file != NULL){
-        int d;
+        close(fds[1]);
+        fd = fds[0];
+    } else{
+        fd = -1;
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        fd = memfd_create("dc_shell_here", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+
+        if(fd == -1){
+            fd = open_temp(env, err);
 
-        if(command->stdout_overwrite == true){
-            d = dc_open(env, err, command->stdout_file, O_APPEND | O_CREAT);
             if(dc_error_has_error(err)){
-                dc_close(env, err, d);
+                return -1;
             }
-        } else{
-            d = dc_open(env, err, command->stdout_file, O_TRUNC | O_CREAT);
-            if(dc_error_has_error(err)){
-                dc_close(env, err, d);
+        }
+
+        error = write_text(fd, text, length);
+
+        if(error == 0 && newline){
+            error = write_text(fd, "\n", 1);
+        }
+
+#if defined(__linux__) && defined(F_ADD_SEALS)
+        // the text cannot change under the command, a temporary file without seals is left as it is
+        if(error == 0){
+            fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        }
+#endif
+
+        if(error == 0 && lseek(fd, 0, SEEK_SET) == -1){
+            error = errno;
+        }
+    }
+
+    if(error != 0){
+        DC_ERROR_RAISE_ERRNO(err, error);
+        close(fd);
+        return -1;
+    }
+
+    return move_above(err, fd, floor);
+}
+
+/**
+ * Write all of a text to a descriptor.
+ *
+ * @param fd the descriptor.
+ * @param text the text.
+ * @param length the number of characters.
+ * @return 0, or the errno of the write that failed.
+ */
+static int write_text(int fd, const char *text, size_t length){
+    size_t written = 0;
+
+    while(written < length){
+        ssize_t n;
+
+        n = write(fd, &text[written], length - written);
+
+        if(n == -1){
+            if(errno != EINTR){
+                return errno;
             }
+        } else{
+            written += (size_t)n;
         }
+    }
 
-        dc_dup2(env, err, d, STDOUT_FILENO);
+    return 0;
+}
 
-        dc_close(env, err, d);
+/**
+ * Move a descriptor that is below floor above it, keeping O_CLOEXEC.
+ *
+ * @param err the err object
+ * @param fd the descriptor.
+ * @param floor the lowest descriptor it may be on.
+ * @return the descriptor, fd if it was not moved, -1 if it could not be (fd is closed).
+ */
+static int move_above(struct dc_error *err, int fd, int floor){
+    int moved;
 
-    } else if(command->stderr_file != NULL){
-        int d;
+    if(fd >= floor){
+        return fd;
+    }
 
-        if(command->stderr_overwrite == true){
-            d = dc_open(env, err, command->stderr_file, O_APPEND | O_CREAT);
-            if(dc_error_has_error(err)){
-                dc_close(env, err, d);
+    moved = fcntl(fd, F_DUPFD_CLOEXEC, floor);
+
+    if(moved == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+    }
+
+    close(fd);
+
+    return moved;
+}
+
+/**
+ * Check that a >&fd copies a descriptor the child will have: one the shell has open, or one an
+ * earlier dup2 of the plan made.
+ *
+ * @param plan the plan so far.
+ * @param fd the descriptor.
+ * @return true if fd will be open.
+ */
+static bool copies_open_fd(const struct exec_plan *plan, int fd){
+    int copied;
+
+    copied = follow_dups(plan->dups, plan->dup_count, fd);
+
+    return copied != -1 && fcntl(copied, F_GETFD) != -1;
+}
+
+/**
+ * Add a dup2 to the end of the plan, open_redirections made room for it.
+ *
+ * @param plan the plan.
+ * @param from the open descriptor, -1 to close to.
+ * @param to the descriptor the program gets it on.
+ * @param opened the plan closes from.
+ */
+static void add_dup(struct exec_plan *plan, int from, int to, bool opened){
+    plan->dups[plan->dup_count].from = from;
+    plan->dups[plan->dup_count].to = to;
+    plan->dups[plan->dup_count].opened = opened;
+    plan->dup_count++;
+}
+
+/**
+ * Follow the first count dup2s back from a descriptor, the last one onto it is the one that counts.
+ *
+ * @param dups the dup2s.
+ * @param count the number of dup2s to look at.
+ * @param fd the descriptor.
+ * @return the descriptor it is a copy of before the dup2s, -1 if it is closed.
+ */
+static int follow_dups(const struct exec_dup *dups, size_t count, int fd){
+    for(size_t i = count; i > 0; i--){
+        const struct exec_dup *dup = &dups[i - 1];
+
+        if(dup->to == fd && dup->from != fd){
+            if(dup->from == -1){
+                return -1;
             }
 
-        } else{
-            d = dc_open(env, err, command->stderr_file, O_TRUNC | O_CREAT);
-            if(dc_error_has_error(err)){
-                dc_close(env, err, d);
+            return follow_dups(dups, i - 1, dup->from);
+        }
+    }
+
+    return fd;
+}
+
+/**
+ * Join a directory from the path and a command name into candidate. Safe to call in a vfork child.
+ *
+ * @param candidate a buffer of PATH_MAX characters.
+ * @param dir the directory.
+ * @param name the command name.
+ * @return false if the result does not fit in PATH_MAX.
+ */
+static bool make_candidate(char *candidate, const char *dir, const char *name){
+    size_t dir_length = strlen(dir);
+    size_t name_length = strlen(name);
+
+    if(dir_length + 1 + name_length + 1 > PATH_MAX){
+        return false;
+    }
+
+    memcpy(candidate, dir, dir_length);
+    candidate[dir_length] = '/';
+    memcpy(&candidate[dir_length + 1], name, name_length + 1);
+
+    return true;
+}
+
+/**
+ * Find the file to exec for the plan: the command->program, the command itself if it has a /, or
+ * the first executable regular file named command in the path. A file that is there but cannot
+ * be run does not stop the search, as with execvp.
+ *
+ * @param plan the plan, plan->file is set to the file.
+ * @param command the command.
+ * @param path the directories to search.
+ * @return 0, ENOENT if the command was not found or EACCES if none of the files found could be run.
+ */
+static int resolve(struct exec_plan *plan, const struct command *command, char **path){
+    const char *name;
+    size_t length;
+    int error;
+
+    if(plan->program != NULL || strchr(command->command, '/') != NULL){
+        name = plan->program != NULL ? plan->program->path : command->command;
+        length = strlen(name);
+
+        if(length >= PATH_MAX){
+            return ENAMETOOLONG;
+        }
+
+        memcpy(plan->file, name, length + 1);
+
+        return 0;
+    }
+
+    error = ENOENT;
+
+    for(size_t i = 0; path[i] != NULL; i++){
+        struct stat info;
+
+        if(!make_candidate(plan->file, path[i], command->command)){
+            continue;
+        }
+
+        if(stat(plan->file, &info) == 0){
+            if(S_ISREG(info.st_mode) && access(plan->file, X_OK) == 0){
+                return 0;
             }
 
+            error = EACCES;
+        }
+    }
+
+    plan->file[0] = '\0';
+
+    return error;
+}
+
+/**
+ * Exec a command found by the path cache, relative to the directory it was found in so a rename
+ * of a parent directory does not matter. Safe to call in a vfork child.
+ *
+ * @param program the entry from path_cache_lookup.
+ * @param argv the arguments.
+ * @param envp the environment.
+ */
+static void exec_program(const struct path_cache_entry *program, char **argv, char **envp){
+#ifdef __linux__
+    if(program->dir_fd != -1){
+        execveat(program->dir_fd, program->name, argv, envp, 0);
+
+        if(errno != ENOSYS){
+            return;
+        }
+    }
+#endif
+
+    execve(program->path, argv, envp);
+}
+
+/**
+ * Fork a child that runs the plan. The child reports a failed exec by writing its errno to an
+ * O_CLOEXEC pipe, which a successful exec closes, so the shell reads either the errno or the end
+ * of the pipe once the child is past the exec, and no exit code of the child has to be decoded.
+ *
+ * @param env the posix environment.
+ * @param err the err object, set if the pipe or the fork failed.
+ * @param plan the plan.
+ * @param error_code set to the errno if the exec failed.
+ * @return the pid of the child, -1 if the fork failed.
+ */
+static pid_t spawn_fork(const struct dc_posix_env *env, struct dc_error *err, const struct exec_plan *plan,
+                        int *error_code){
+    int fds[2];
+    int child_error;
+    ssize_t n;
+    pid_t pid;
+
+    if(pipe2(fds, O_CLOEXEC) == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        return -1;
+    }
+
+    pid = dc_fork(env, err);
+
+    if(pid == 0){
+        close(fds[0]);
+        child_error = exec_plan_run(plan);
+        write(fds[1], &child_error, sizeof(child_error));
+        _exit(127);
+    }
+
+    close(fds[1]);
+    child_error = 0;
+
+    if(pid > 0){
+        while((n = read(fds[0], &child_error, sizeof(child_error))) == -1 && errno == EINTR){
         }
-        dc_dup2(env, err, d, STDERR_FILENO);
 
-        dc_close(env, err, d);
+        if(n != (ssize_t)sizeof(child_error)){
+            child_error = 0;
+        }
     }
+
+    close(fds[0]);
+    *error_code = child_error;
+
+    return pid;
 }
 
-void run(const struct dc_posix_env *env, struct dc_error *err, struct command *command, char **path){
+/**
+ * Start the plan with posix_spawn, the dup2s of the plan are its file actions. posix_spawn cannot
+ * exec relative to a directory, so a program from the path cache is exec'd by its full path.
+ *
+ * @param plan the plan.
+ * @param error_code set to the errno if the command could not be started.
+ * @return the pid of the child, -1 if the command could not be started.
+ */
+static pid_t spawn_posix(const struct exec_plan *plan, int *error_code){
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    pid_t pid = -1;
+    int ret;
 
-    if((dc_strchr(env, command->command, '/') != NULL)){
-        command->argv[0] = dc_strdup(env, err, command->command);
-        dc_execv(env, err, command->command, command->argv);
-    } else{
-        if(path[0] == NULL){
-            DC_ERROR_RAISE_ERRNO(err, ENOENT);
+    ret = posix_spawnattr_init(&attr);
+
+    if(ret != 0){
+        *error_code = ret;
+        return -1;
+    }
+
+    ret = posix_spawnattr_setsigmask(&attr, &plan->mask);
+
+    if(ret == 0){
+        ret = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    }
+
+    if(ret == 0){
+        ret = posix_spawn_file_actions_init(&actions);
+    }
+
+    if(ret != 0){
+        posix_spawnattr_destroy(&attr);
+        *error_code = ret;
+        return -1;
+    }
+
+    // a dup2 onto the same descriptor clears O_CLOEXEC in a file action
+    for(size_t i = 0; i < plan->dup_count && ret == 0; i++){
+        if(plan->dups[i].from == -1){
+            ret = posix_spawn_file_actions_addclose(&actions, plan->dups[i].to);
         } else{
-            for(char *str = *path; str; *++path){
-                char *cmd = dc_strdup(env,err, dc_strcat(env, dc_strcat(env, str, "/"), command->command));
-                command->argv[0] = dc_strdup(env, err, cmd);
-                dc_execv(env, err, cmd, command->argv);
-                if(err->errno_code != ENOENT){
-                    break;
-                }
-            }
+            ret = posix_spawn_file_actions_adddup2(&actions, plan->dups[i].from, plan->dups[i].to);
         }
     }
+
+    if(ret == 0){
+        ret = posix_spawn(&pid, plan->file, &actions, &attr, plan->argv, plan->envp);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    *error_code = ret;
+
+    return ret == 0 ? pid : -1;
 }
 
+/**
+ * Start the plan with vfork. The child shares the memory of the shell until it execs, exec_plan_run
+ * only makes async-signal-safe calls, and a failed exec is reported through error_code.
+ *
+ * @param plan the plan.
+ * @param error_code set to the errno if the command could not be started.
+ * @return the pid of the child, -1 if the command could not be started.
+ */
+static pid_t spawn_vfork(const struct exec_plan *plan, int *error_code){
+    volatile int child_error = 0;
+    pid_t pid;
 
+    pid = vfork();
 
+    if(pid == 0){
+        // child_error is only written if the exec failed, a successful exec leaves it 0
+        child_error = exec_plan_run(plan);
+        _exit(127);
+    }
+
+    if(pid == -1){
+        *error_code = errno;
+    } else{
+        *error_code = child_error;
+    }
+
+    return pid;
+}
+
+/**
+ * Get the signal mask for a child: the one of the shell without SIGCHLD and SIGINT, which the shell
+ * blocks to read them from signalfds (see job_table_create and reactor_watch_signal), but a program
+ * expects to get.
+ *
+ * @param mask set to the mask.
+ */
+static void child_signal_mask(sigset_t *mask){
+    sigprocmask(SIG_SETMASK, NULL, mask);
+    sigdelset(mask, SIGCHLD);
+    sigdelset(mask, SIGINT);
+}
+
+/**
+ * Wait for the child and set the command->exit_code, 128 + the signal if it was killed.
+ *
+ * @param env the posix environment.
+ * @param err the err object
+ * @param command the command that the child is running.
+ * @param pid the child.
+ */
+void execute_wait(const struct dc_posix_env *env, struct dc_error *err, struct command *command, pid_t pid){
+    int status;
+
+    while(dc_waitpid(env, err, pid, &status, 0) == -1 && dc_error_is_errno(err, EINTR)){
+        dc_error_reset(err);
+    }
+
+    if(dc_error_has_error(err)){
+        return;
+    }
+
+    if(WIFEXITED(status)){
+        command->exit_code = WEXITSTATUS(status);
+    } else if(WIFSIGNALED(status)){
+        command->exit_code = 128 + WTERMSIG(status);
+    }
+}
@@ -2,30 +2,540 @@
 #include <dc_posix/dc_stdio.h>
 #include <dc_util/strings.h>
 #include <dc_posix/dc_string.h>
+#include <dc_posix/dc_fcntl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 #include "input.h"
 
+static void fill(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader);
+static char *here_document(const struct dc_posix_env *env, struct dc_error *err, FILE *stream,
+                           struct line_reader *reader, const char *delimiter, FILE *prompt, size_t *length);
+static size_t trim(const char **line, size_t length);
+static bool is_blank(char c);
+
 /**
  * Read the command line from the user.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param stream The stream to read from (eg. stdin)
- * @param line_size the maximum characters to read.
- * @return The command line that the user entered.
+ * @param line_size set to the length of the line.
+ * @return The command line that the user entered, trimmed, empty at the end of the stream.
  */
 char *read_command_line(const struct dc_posix_env *env, struct dc_error *err, FILE *stream, size_t *line_size){
-    char *ans;
-    unsigned long size;
+    char *ans = NULL;
+    const char *line;
+    size_t size = 0;
+    ssize_t n;
 
-    size = (unsigned long) *line_size + 1;
+    n = dc_getline(env, err, &ans, &size, stream);
 
-    ans = dc_malloc(env, err, size * sizeof(char));
+    if(dc_error_has_error(err)){
+        free(ans);
+        return NULL;
+    }
 
-    dc_getline(env, err, &ans, line_size, stream);
+    // at the end of the stream getline reads nothing and may not even allocate
+    if(n == -1){
+        free(ans);
+        ans = dc_calloc(env, err, 1, 1);
+        *line_size = 0;
 
-    dc_str_trim(env, ans);
+        return ans;
+    }
 
-    *line_size = dc_strlen(env, ans);
+    // a NUL read from the stream ends the line, as it did when the line was taken as a string
+    line = ans;
+    *line_size = trim(&line, strnlen(ans, (size_t)n));
+    dc_memmove(env, ans, line, *line_size);
+    ans[*line_size] = '\0';
 
     return ans;
 }
+
+/**
+ * Read the body of a here-document, the lines up to one that is only the delimiter. The lines are
+ * kept as they are, newlines included, and the end of the stream ends the body like the delimiter.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param stream the stream the command line was read from.
+ * @param delimiter the word after the <<.
+ * @param prompt the stream to print "> " on before each line, NULL for none.
+ * @param length set to the number of characters in the body.
+ * @return the body, NUL terminated, free it with dc_free.
+ */
+char *read_here_document(const struct dc_posix_env *env, struct dc_error *err, FILE *stream, const char *delimiter,
+                         FILE *prompt, size_t *length){
+    return here_document(env, err, stream, NULL, delimiter, prompt, length);
+}
+
+/**
+ * Create a reader for the lines of a descriptor.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param fd the descriptor.
+ * @param capacity the first size of the buffer, LINE_READER_CAPACITY unless there is a reason.
+ * @return the reader, destroy it with line_reader_destroy.
+ */
+struct line_reader *line_reader_create(const struct dc_posix_env *env, struct dc_error *err, int fd, size_t capacity){
+    struct line_reader *reader;
+
+    reader = dc_calloc(env, err, 1, sizeof(struct line_reader));
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    reader->buffer = dc_malloc(env, err, capacity);
+
+    if(dc_error_has_error(err)){
+        dc_free(env, reader, sizeof(struct line_reader));
+        return NULL;
+    }
+
+    reader->fd = fd;
+    reader->capacity = capacity;
+
+    return reader;
+}
+
+/**
+ * Free a reader and set it to NULL. The descriptor is left open.
+ *
+ * @param env the posix environment.
+ * @param preader the reader, may point at NULL.
+ */
+void line_reader_destroy(const struct dc_posix_env *env, struct line_reader **preader){
+    struct line_reader *reader = *preader;
+
+    if(reader != NULL){
+        dc_free(env, reader->buffer, reader->capacity);
+        dc_free(env, reader, sizeof(struct line_reader));
+        *preader = NULL;
+    }
+}
+
+/**
+ * Get the next line as it was read, with its newline unless it is the last and has none.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, valid until the next call on the reader, NULL at the end or on error.
+ */
+const char *line_reader_next_line(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                  size_t *length){
+    *length = 0;
+
+    while(true){
+        size_t start = reader->start;
+        const char *newline;
+
+        // only the bytes read since the last search are searched, a long line is not searched again per read
+        newline = memchr(&reader->buffer[reader->scanned], '\n', reader->end - reader->scanned);
+
+        if(newline != NULL){
+            reader->start = (size_t)(newline - reader->buffer) + 1;
+            reader->scanned = reader->start;
+            *length = reader->start - start;
+
+            return &reader->buffer[start];
+        }
+
+        reader->scanned = reader->end;
+
+        if(reader->eof){
+            if(start == reader->end){
+                return NULL;
+            }
+
+            reader->start = reader->end;
+            *length = reader->end - start;
+
+            return &reader->buffer[start];
+        }
+
+        fill(env, err, reader);
+
+        if(dc_error_has_error(err)){
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Get the next line trimmed like read_command_line, without copying it.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, valid until the next call on the reader, NULL at the end or on error.
+ */
+const char *line_reader_read_line(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                  size_t *length){
+    const char *line;
+
+    line = line_reader_next_line(env, err, reader, length);
+
+    if(line != NULL){
+        *length = trim(&line, *length);
+    }
+
+    return line;
+}
+
+/**
+ * Read the body of a here-document from a reader, as read_here_document does from a stream.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader the command line was read from.
+ * @param delimiter the word after the <<.
+ * @param prompt the stream to print "> " on before each line, NULL for none.
+ * @param length set to the number of characters in the body.
+ * @return the body, NUL terminated, free it with dc_free.
+ */
+char *line_reader_read_here_document(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader,
+                                     const char *delimiter, FILE *prompt, size_t *length){
+    return here_document(env, err, NULL, reader, delimiter, prompt, length);
+}
+
+/**
+ * Check if the next line can be had without waiting for the descriptor.
+ *
+ * @param reader the reader.
+ * @return true if a whole line is buffered or the descriptor was read to the end.
+ */
+bool line_reader_has_line(const struct line_reader *reader){
+    return reader->eof || memchr(&reader->buffer[reader->scanned], '\n', reader->end - reader->scanned) != NULL;
+}
+
+/**
+ * Map a script file read-only.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param path the file.
+ * @return the script, close it with script_close, NULL on error.
+ */
+struct script *script_open(const struct dc_posix_env *env, struct dc_error *err, const char *path){
+    struct script *script;
+    struct stat buf;
+    void *data;
+    int fd;
+
+    fd = dc_open(env, err, path, O_RDONLY | O_CLOEXEC, 0);
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    if(fstat(fd, &buf) == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        close(fd);
+        return NULL;
+    }
+
+    data = NULL;
+
+    // an empty file cannot be mapped, it is a script without lines
+    if(buf.st_size > 0){
+        data = mmap(NULL, (size_t)buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(data == MAP_FAILED){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+            close(fd);
+            return NULL;
+        }
+
+        posix_madvise(data, (size_t)buf.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+
+    // the mapping keeps the file
+    close(fd);
+    script = dc_calloc(env, err, 1, sizeof(struct script));
+
+    if(dc_error_has_error(err)){
+        if(data != NULL){
+            munmap(data, (size_t)buf.st_size);
+        }
+
+        return NULL;
+    }
+
+    script->data = data;
+    script->length = data == NULL ? 0 : (size_t)buf.st_size;
+
+    return script;
+}
+
+/**
+ * Unmap a script and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param pscript the script, may point at NULL.
+ */
+void script_close(const struct dc_posix_env *env, struct script **pscript){
+    struct script *script = *pscript;
+
+    if(script != NULL){
+        if(script->data != NULL){
+            munmap(script->data, script->length);
+        }
+
+        dc_free(env, script, sizeof(struct script));
+        *pscript = NULL;
+    }
+}
+
+/**
+ * Get the next line of a script, trimmed like read_command_line, without copying it.
+ *
+ * @param script the script.
+ * @param length set to the length of the line, it is not NUL terminated.
+ * @return the line, inside the mapping, or NULL at the end of the script.
+ */
+const char *script_read_line(struct script *script, size_t *length){
+    const char *start;
+    const char *end;
+    const char *newline;
+
+    if(script->offset >= script->length){
+        *length = 0;
+        return NULL;
+    }
+
+    start = script->data + script->offset;
+    newline = memchr(start, '\n', script->length - script->offset);
+    end = newline == NULL ? script->data + script->length : newline;
+    script->offset = (size_t)(end - script->data) + (newline == NULL ? 0 : 1);
+    *length = trim(&start, (size_t)(end - start));
+
+    return start;
+}
+
+/**
+ * Get the body of a here-document from a script, the lines up to one that is only the delimiter,
+ * as read_here_document does for a stream. The body is the lines as they are in the file, so it
+ * is not copied.
+ *
+ * @param env the posix environment.
+ * @param script the script, the line with the << was read already.
+ * @param delimiter the word after the <<.
+ * @param length set to the number of characters in the body.
+ * @return the body, inside the mapping and not NUL terminated.
+ */
+const char *script_read_here_document(const struct dc_posix_env *env, struct script *script, const char *delimiter,
+                                     size_t *length){
+    const char *body;
+    size_t delimiter_length;
+
+    if(script->offset >= script->length){
+        *length = 0;
+        return "";
+    }
+
+    body = script->data + script->offset;
+    delimiter_length = dc_strlen(env, delimiter);
+
+    while(script->offset < script->length){
+        const char *line;
+        const char *newline;
+        size_t line_length;
+
+        line = script->data + script->offset;
+        newline = memchr(line, '\n', script->length - script->offset);
+        line_length = newline == NULL ? script->length - script->offset : (size_t)(newline - line);
+
+        if(line_length == delimiter_length && dc_strncmp(env, line, delimiter, delimiter_length) == 0){
+            *length = (size_t)(line - body);
+            script->offset += line_length + (newline == NULL ? 0 : 1);
+
+            return body;
+        }
+
+        script->offset += line_length + (newline == NULL ? 0 : 1);
+    }
+
+    *length = script->length - (size_t)(body - script->data);
+
+    return body;
+}
+
+/**
+ * Read the buffer of a reader full, or as much as the descriptor has. The line being read is moved
+ * to the front first, and the buffer is doubled if the line fills it.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param reader the reader.
+ */
+static void fill(const struct dc_posix_env *env, struct dc_error *err, struct line_reader *reader){
+    ssize_t n;
+
+    if(reader->start > 0){
+        dc_memmove(env, reader->buffer, &reader->buffer[reader->start], reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->scanned -= reader->start;
+        reader->start = 0;
+    }
+
+    if(reader->end == reader->capacity){
+        char *grown;
+
+        grown = dc_realloc(env, err, reader->buffer, reader->capacity * 2);
+
+        if(dc_error_has_error(err)){
+            return;
+        }
+
+        reader->buffer = grown;
+        reader->capacity *= 2;
+    }
+
+    do{
+        n = read(reader->fd, &reader->buffer[reader->end], reader->capacity - reader->end);
+    } while(n == -1 && errno == EINTR);
+
+    if(n == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        return;
+    }
+
+    if(n == 0){
+        reader->eof = true;
+    }
+
+    reader->end += (size_t)n;
+}
+
+/**
+ * Read the body of a here-document from a stream or from a reader (see read_here_document).
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param stream the stream to read the lines with getline, if reader is NULL.
+ * @param reader the reader to take the lines from, NULL to read stream.
+ * @param delimiter the word after the <<.
+ * @param prompt the stream to print "> " on before each line, NULL for none.
+ * @param length set to the number of characters in the body.
+ * @return the body, NUL terminated, free it with dc_free.
+ */
+static char *here_document(const struct dc_posix_env *env, struct dc_error *err, FILE *stream,
+                           struct line_reader *reader, const char *delimiter, FILE *prompt, size_t *length){
+    char *body;
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t capacity = 64;
+    size_t delimiter_length = dc_strlen(env, delimiter);
+
+    *length = 0;
+    body = dc_malloc(env, err, capacity);
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    body[0] = '\0';
+
+    while(true){
+        const char *text;
+        size_t n;
+
+        if(prompt != NULL){
+            fputs("> ", prompt);
+            fflush(prompt);
+        }
+
+        if(reader != NULL){
+            text = line_reader_next_line(env, err, reader, &n);
+        } else{
+            ssize_t read_length = getline(&line, &line_size, stream);
+
+            text = read_length == -1 ? NULL : line;
+            n = read_length == -1 ? 0 : (size_t)read_length;
+        }
+
+        if(text == NULL){
+            break;
+        }
+
+        if(n >= delimiter_length && dc_strncmp(env, text, delimiter, delimiter_length) == 0 &&
+           (n == delimiter_length || (n == delimiter_length + 1 && text[n - 1] == '\n'))){
+            break;
+        }
+
+        if(*length + n + 1 > capacity){
+            char *grown;
+
+            while(*length + n + 1 > capacity){
+                capacity *= 2;
+            }
+
+            grown = dc_realloc(env, err, body, capacity);
+
+            if(dc_error_has_error(err)){
+                break;
+            }
+
+            body = grown;
+        }
+
+        dc_memcpy(env, &body[*length], text, n);
+        *length += n;
+        body[*length] = '\0';
+    }
+
+    free(line);
+
+    if(dc_error_has_error(err)){
+        dc_free(env, body, capacity);
+        return NULL;
+    }
+
+    return body;
+}
+
+/**
+ * Trim the blanks from both ends of a line without looking past its length.
+ *
+ * @param line the line, moved past the leading blanks.
+ * @param length the length of the line.
+ * @return the length of the trimmed line.
+ */
+static size_t trim(const char **line, size_t length){
+    const char *start = *line;
+    const char *end = start + length;
+
+    while(start < end && is_blank(*start)){
+        start++;
+    }
+
+    while(end > start && is_blank(end[-1])){
+        end--;
+    }
+
+    *line = start;
+
+    return (size_t)(end - start);
+}
+
+/**
+ * Check if a character is one dc_str_trim removes from the ends of a line.
+ *
+ * @param c the character.
+ * @return true for a space, tab, newline, vertical tab, form feed or carriage return.
+ */
+static bool is_blank(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
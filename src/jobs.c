@@ -0,0 +1,668 @@
+#define _GNU_SOURCE
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <dc_posix/dc_unistd.h>
+#include <dc_posix/sys/dc_wait.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "jobs.h"
+#include "reactor.h"
+#include "util.h"
+
+#ifdef __linux__
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#endif
+
+static void free_job(const struct dc_posix_env *env, struct job_table *table, struct job *job);
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table);
+static void watch_stage(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                        struct job *job, size_t stage);
+static void unwatch_stage(const struct dc_posix_env *env, struct job_table *table, struct job *job, size_t stage);
+static bool reap_stage(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                       struct job *job, size_t stage);
+static void drain_sigchld(const struct job_table *table);
+static bool parse_number(const char *text, long *value);
+
+/**
+ * Create an empty table and block SIGCHLD.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param max_running the most jobs that run at once, 0 for no limit.
+ * @return the table, destroy it with job_table_destroy.
+ */
+struct job_table *job_table_create(const struct dc_posix_env *env, struct dc_error *err, size_t max_running){
+    struct job_table *table;
+    sigset_t sigchld;
+
+    table = dc_calloc(env, err, 1, sizeof(struct job_table));
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    table->jobs = dc_calloc(env, err, JOB_TABLE_INITIAL_CAPACITY, sizeof(struct job));
+
+    if(dc_error_has_error(err)){
+        dc_free(env, table, sizeof(struct job_table));
+        return NULL;
+    }
+
+    table->capacity = JOB_TABLE_INITIAL_CAPACITY;
+    table->max_running = max_running;
+    table->signal_fd = -1;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+
+    // blocked, a SIGCHLD stays pending until it is read instead of being discarded
+    if(sigprocmask(SIG_BLOCK, &sigchld, &table->old_mask) == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        job_table_destroy(env, &table);
+        return NULL;
+    }
+
+#ifdef __linux__
+    table->signal_fd = move_shell_fd(signalfd(-1, &sigchld, SFD_NONBLOCK | SFD_CLOEXEC));
+
+    if(table->signal_fd == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        job_table_destroy(env, &table);
+        return NULL;
+    }
+#endif
+
+    return table;
+}
+
+/**
+ * Free the table, without waiting for the jobs, restore the signal mask and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param ptable the table to destroy, may point at NULL.
+ */
+void job_table_destroy(const struct dc_posix_env *env, struct job_table **ptable){
+    struct job_table *table = *ptable;
+
+    if(table != NULL){
+        job_table_clear(env, table);
+        dc_free(env, table->jobs, table->capacity * sizeof(struct job));
+
+        if(table->signal_fd != -1){
+            close(table->signal_fd);
+        }
+
+        sigprocmask(SIG_SETMASK, &table->old_mask, NULL);
+        dc_free(env, table, sizeof(struct job_table));
+        *ptable = NULL;
+    }
+}
+
+/**
+ * Watch the stages of the jobs added from now on in a reactor, with a pidfd each.
+ *
+ * @param table the table.
+ * @param reactor the reactor, it must outlive the table.
+ */
+void job_table_watch(struct job_table *table, struct reactor *reactor){
+    table->reactor = reactor;
+}
+
+/**
+ * Forget every job without waiting for it. A forked child calls this, the jobs are not its children.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ */
+void job_table_clear(const struct dc_posix_env *env, struct job_table *table){
+    for(size_t i = 0; i < table->count; i++){
+        free_job(env, table, &table->jobs[i]);
+    }
+
+    table->count = 0;
+}
+
+/**
+ * Add a job for the stages of a pipeline that was started. The id is one more than the highest
+ * id in the table, so the ids go back to 1 once every job has been reported.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @param text the commands of the pipeline, copied.
+ * @param pids the process of each stage, -1 for a stage that never started.
+ * @param exit_codes the exit code of each stage that never started, the others are ignored.
+ * @param count the number of stages.
+ * @param pipefail the status of the job is the last stage that failed.
+ * @return the id of the job, 0 if it could not be added.
+ */
+int job_table_add(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                  const char *text, const pid_t *pids, const int *exit_codes, size_t count, bool pipefail){
+    struct job *job;
+    int id;
+
+    if(table->count == table->capacity){
+        grow(env, err, table);
+
+        if(dc_error_has_error(err)){
+            return 0;
+        }
+    }
+
+    id = 1;
+
+    for(size_t i = 0; i < table->count; i++){
+        if(table->jobs[i].id >= id){
+            id = table->jobs[i].id + 1;
+        }
+    }
+
+    job = &table->jobs[table->count];
+    dc_memset(env, job, 0, sizeof(struct job));
+    job->text = dc_strdup(env, err, text);
+
+    if(dc_error_has_no_error(err)){
+        job->pids = dc_calloc(env, err, count, sizeof(pid_t));
+    }
+
+    if(dc_error_has_no_error(err)){
+        job->exit_codes = dc_calloc(env, err, count, sizeof(int));
+    }
+
+    if(dc_error_has_no_error(err)){
+        job->pidfds = dc_calloc(env, err, count, sizeof(int));
+    }
+
+    if(dc_error_has_error(err)){
+        free_job(env, table, job);
+        return 0;
+    }
+
+    job->id = id;
+    job->count = count;
+    job->pipefail = pipefail;
+
+    for(size_t i = 0; i < count; i++){
+        job->pids[i] = pids[i];
+        job->pidfds[i] = -1;
+
+        if(pids[i] > 0){
+            job->exit_codes[i] = JOB_RUNNING;
+            job->running++;
+        } else{
+            job->exit_codes[i] = exit_codes[i];
+        }
+    }
+
+    table->count++;
+
+    for(size_t i = 0; i < count && dc_error_has_no_error(err); i++){
+        if(pids[i] > 0){
+            watch_stage(env, err, table, job, i);
+        }
+    }
+
+    return id;
+}
+
+/**
+ * Remove a job from the table, the jobs after it move down so they stay in the order they started.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ * @param job the job, a pointer into table->jobs that is not valid afterwards.
+ */
+void job_table_remove(const struct dc_posix_env *env, struct job_table *table, struct job *job){
+    size_t index;
+
+    index = (size_t)(job - table->jobs);
+    free_job(env, table, job);
+    dc_memmove(env, job, job + 1, (table->count - index - 1) * sizeof(struct job));
+    table->count--;
+}
+
+/**
+ * Find a job by %id, or by the pid of one of its stages.
+ *
+ * @param table the table.
+ * @param spec %id or a pid.
+ * @return the job, NULL if there is none.
+ */
+struct job *job_table_find(struct job_table *table, const char *spec){
+    bool by_id;
+    long number;
+
+    by_id = spec[0] == '%';
+
+    if(!parse_number(by_id ? &spec[1] : spec, &number)){
+        return NULL;
+    }
+
+    for(size_t i = 0; i < table->count; i++){
+        struct job *job = &table->jobs[i];
+
+        if(by_id && job->id == number){
+            return job;
+        }
+
+        for(size_t j = 0; !by_id && j < job->count; j++){
+            if(job->pids[j] > 0 && job->pids[j] == number){
+                return job;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the job that was started first of the ones that finished.
+ *
+ * @param table the table.
+ * @return the job, NULL if every job is running.
+ */
+struct job *job_table_find_done(struct job_table *table){
+    for(size_t i = 0; i < table->count; i++){
+        if(table->jobs[i].running == 0){
+            return &table->jobs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Count the jobs that have a stage that has not been reaped.
+ *
+ * @param table the table.
+ * @return the number of running jobs.
+ */
+size_t job_table_running(const struct job_table *table){
+    size_t running;
+
+    running = 0;
+
+    for(size_t i = 0; i < table->count; i++){
+        if(table->jobs[i].running > 0){
+            running++;
+        }
+    }
+
+    return running;
+}
+
+/**
+ * Reap every stage of every job that finished, without blocking. The pending SIGCHLD is read
+ * first, so one that arrives after the reap leaves the signalfd readable for job_table_wait.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @return the number of processes reaped.
+ */
+size_t job_table_reap(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table){
+    size_t reaped;
+
+    drain_sigchld(table);
+    reaped = 0;
+
+    for(size_t i = 0; i < table->count && dc_error_has_no_error(err); i++){
+        struct job *job = &table->jobs[i];
+
+        for(size_t j = 0; j < job->count && job->running > 0 && dc_error_has_no_error(err); j++){
+            if(job->exit_codes[j] == JOB_RUNNING && reap_stage(env, err, table, job, j)){
+                reaped++;
+            }
+        }
+    }
+
+    return reaped;
+}
+
+/**
+ * Reap the stage of a job with the pid if it finished, without blocking. The reactor says which
+ * child exited, so only its stage is waited for, not every stage of every job.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @param pid the stage, -1 to reap every stage that finished (see job_table_reap).
+ * @return the number of processes reaped.
+ */
+size_t job_table_reap_pid(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table, pid_t pid){
+    if(pid == -1){
+        return job_table_reap(env, err, table);
+    }
+
+    for(size_t i = 0; i < table->count; i++){
+        struct job *job = &table->jobs[i];
+
+        for(size_t j = 0; j < job->count; j++){
+            if(job->pids[j] == pid && job->exit_codes[j] == JOB_RUNNING){
+                return reap_stage(env, err, table, job, j) ? 1 : 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Block until a stage of a job finishes and reap it, nothing is done if no job is running.
+ * A SIGCHLD from a foreground child may wake it without a job to reap, it goes back to waiting.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table){
+    size_t reaped;
+
+    reaped = job_table_reap(env, err, table);
+
+    while(reaped == 0 && job_table_running(table) > 0 && dc_error_has_no_error(err)){
+        job_table_wait_sigchld(err, table);
+
+        if(dc_error_has_no_error(err)){
+            reaped = job_table_reap(env, err, table);
+        }
+    }
+}
+
+/**
+ * Block until a SIGCHLD arrives and read it. One that arrived since the last read returns at once,
+ * so a child that exits after its WNOHANG check is not missed. The caller checks its children again.
+ *
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait_sigchld(struct dc_error *err, const struct job_table *table){
+    if(table->signal_fd != -1){
+        struct pollfd pollfd;
+
+        pollfd.fd = table->signal_fd;
+        pollfd.events = POLLIN;
+        pollfd.revents = 0;
+
+        if(poll(&pollfd, 1, -1) == -1 && errno != EINTR){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+        }
+
+        drain_sigchld(table);
+    } else{
+        sigset_t sigchld;
+        int signal_number;
+        int ret;
+
+        sigemptyset(&sigchld);
+        sigaddset(&sigchld, SIGCHLD);
+        ret = sigwait(&sigchld, &signal_number);
+
+        if(ret != 0){
+            DC_ERROR_RAISE_ERRNO(err, ret);
+        }
+    }
+}
+
+/**
+ * Block until there are fewer than max_running jobs running, so another can start.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ */
+void job_table_wait_for_slot(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table){
+    job_table_reap(env, err, table);
+
+    while(table->max_running > 0 && job_table_running(table) >= table->max_running && dc_error_has_no_error(err)){
+        job_table_wait(env, err, table);
+    }
+}
+
+/**
+ * Print each job with its state, Running, Done or Exit and the code, and forget the ones that finished.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ * @param stream where to print.
+ */
+void job_table_report(const struct dc_posix_env *env, struct job_table *table, FILE *stream){
+    size_t i;
+
+    i = 0;
+
+    while(i < table->count){
+        struct job *job = &table->jobs[i];
+
+        if(job->running > 0){
+            fprintf(stream, "[%d]  %-10s %s\n", job->id, "Running", job->text);
+            i++;
+        } else{
+            int status = job_status(job);
+
+            if(status == 0){
+                fprintf(stream, "[%d]  %-10s %s\n", job->id, "Done", job->text);
+            } else{
+                fprintf(stream, "[%d]  Exit %-5d %s\n", job->id, status, job->text);
+            }
+
+            job_table_remove(env, table, job);
+        }
+    }
+}
+
+/**
+ * Get the exit code of a job that finished, the last stage or the last that failed with pipefail.
+ *
+ * @param job the job.
+ * @return the exit code.
+ */
+int job_status(const struct job *job){
+    if(job->pipefail){
+        for(size_t i = job->count; i > 0; i--){
+            if(job->exit_codes[i - 1] != 0){
+                return job->exit_codes[i - 1];
+            }
+        }
+    }
+
+    return job->exit_codes[job->count - 1];
+}
+
+/**
+ * Free what a job owns, not the job itself, and close the pidfds of the stages still running.
+ *
+ * @param env the posix environment.
+ * @param table the table of the job.
+ * @param job the job.
+ */
+static void free_job(const struct dc_posix_env *env, struct job_table *table, struct job *job){
+    if(job->pidfds != NULL){
+        for(size_t i = 0; i < job->count; i++){
+            unwatch_stage(env, table, job, i);
+        }
+
+        dc_free(env, job->pidfds, job->count * sizeof(int));
+        job->pidfds = NULL;
+    }
+
+    if(job->text != NULL){
+        dc_free(env, job->text, dc_strlen(env, job->text) + 1);
+        job->text = NULL;
+    }
+
+    if(job->pids != NULL){
+        dc_free(env, job->pids, job->count * sizeof(pid_t));
+        job->pids = NULL;
+    }
+
+    if(job->exit_codes != NULL){
+        dc_free(env, job->exit_codes, job->count * sizeof(int));
+        job->exit_codes = NULL;
+    }
+}
+
+/**
+ * Double the room for jobs.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ */
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table){
+    struct job *jobs;
+
+    jobs = dc_realloc(env, err, table->jobs, table->capacity * 2 * sizeof(struct job));
+
+    if(dc_error_has_no_error(err)){
+        table->jobs = jobs;
+        table->capacity *= 2;
+    }
+}
+
+/**
+ * Open a pidfd for a stage and watch it in the reactor of the table. Where pidfds are not
+ * supported the SIGCHLD signalfd is watched instead, once, and it wakes the shell for any child.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table.
+ * @param job the job.
+ * @param stage the stage, it must be running.
+ */
+static void watch_stage(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                        struct job *job, size_t stage){
+    int fd;
+
+    if(table->reactor == NULL || table->watching_sigchld){
+        return;
+    }
+
+    fd = -1;
+
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    fd = move_shell_fd((int)syscall(SYS_pidfd_open, job->pids[stage], 0));
+#endif
+
+    if(fd == -1){
+        if(table->signal_fd != -1){
+            reactor_add(env, err, table->reactor, table->signal_fd, REACTOR_CHILD, -1);
+            table->watching_sigchld = dc_error_has_no_error(err);
+        }
+
+        return;
+    }
+
+    reactor_add(env, err, table->reactor, fd, REACTOR_CHILD, job->pids[stage]);
+
+    if(dc_error_has_error(err)){
+        close(fd);
+        return;
+    }
+
+    job->pidfds[stage] = fd;
+}
+
+/**
+ * Stop watching the pidfd of a stage and close it, if it has one.
+ *
+ * @param env the posix environment.
+ * @param table the table.
+ * @param job the job.
+ * @param stage the stage.
+ */
+static void unwatch_stage(const struct dc_posix_env *env, struct job_table *table, struct job *job, size_t stage){
+    if(job->pidfds != NULL && job->pidfds[stage] != -1){
+        if(table->reactor != NULL){
+            reactor_remove(env, table->reactor, job->pidfds[stage]);
+        }
+
+        close(job->pidfds[stage]);
+        job->pidfds[stage] = -1;
+    }
+}
+
+/**
+ * Reap a stage if it finished and set its exit code, 128 + the signal if it was killed.
+ * A stage that is not a child of this process (ECHILD) is counted as finished with 127.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param table the table of the job.
+ * @param job the job.
+ * @param stage the stage, it must be running.
+ * @return true if the stage was reaped.
+ */
+static bool reap_stage(const struct dc_posix_env *env, struct dc_error *err, struct job_table *table,
+                       struct job *job, size_t stage){
+    pid_t pid;
+    int status;
+
+    status = 0;
+
+    while((pid = dc_waitpid(env, err, job->pids[stage], &status, WNOHANG)) == -1 && dc_error_is_errno(err, EINTR)){
+        dc_error_reset(err);
+    }
+
+    if(pid == -1 && dc_error_is_errno(err, ECHILD)){
+        dc_error_reset(err);
+        status = 127 << 8;
+    } else if(pid <= 0){
+        return false;
+    }
+
+    if(WIFEXITED(status)){
+        job->exit_codes[stage] = WEXITSTATUS(status);
+    } else if(WIFSIGNALED(status)){
+        job->exit_codes[stage] = 128 + WTERMSIG(status);
+    } else{
+        job->exit_codes[stage] = 127;
+    }
+
+    job->running--;
+    unwatch_stage(env, table, job, stage);
+
+    return true;
+}
+
+/**
+ * Read every pending SIGCHLD from the signalfd, so it is only readable for ones that come later.
+ *
+ * @param table the table.
+ */
+static void drain_sigchld(const struct job_table *table){
+#ifdef __linux__
+    struct signalfd_siginfo info;
+
+    if(table->signal_fd != -1){
+        while(read(table->signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)){
+        }
+    }
+#else
+    (void)table;
+#endif
+}
+
+/**
+ * Parse a positive decimal number.
+ *
+ * @param text the text.
+ * @param value set to the number.
+ * @return false if text is not a positive number.
+ */
+static bool parse_number(const char *text, long *value){
+    char *end;
+
+    if(*text < '0' || *text > '9'){
+        return false;
+    }
+
+    errno = 0;
+    *value = strtol(text, &end, 10);
+
+    return errno == 0 && *end == '\0' && *value > 0;
+}
@@ -0,0 +1,495 @@
+#include <string.h>
+#include "lexer.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LEXER_SIMD
+#include <immintrin.h>
+#endif
+
+static bool is_blank(char c);
+static bool is_operator(char c);
+static bool is_special(char c);
+static size_t find_special(const struct lexer *lexer, size_t position);
+static size_t find_special_scalar(const char *line, size_t position, size_t length);
+#ifdef LEXER_SIMD
+static size_t find_special_sse2(const char *line, size_t position, size_t length);
+static size_t find_special_avx2(const char *line, size_t position, size_t length) __attribute__((target("avx2")));
+static unsigned special_mask_sse2(const char *block);
+static unsigned special_mask_avx2(const char *block) __attribute__((target("avx2")));
+#endif
+static size_t io_number(const struct lexer *lexer, size_t position);
+static enum token_type scan_redirection(const struct lexer *lexer, size_t *position);
+static bool scan_word(const struct lexer *lexer, size_t *position);
+static size_t unquote(char *dest, const char *text, size_t length);
+
+/**
+ * Get the scanner lexer_init uses. AVX2 is not picked even if the CPU has it, the plain runs of a
+ * command line are too short for 32 characters at a time to beat 16 (see lexer_benchmark).
+ *
+ * @return LEXER_SCAN_SSE2 on x86-64, LEXER_SCAN_SCALAR anywhere else.
+ */
+enum lexer_scanner lexer_best_scanner(void){
+#ifdef LEXER_SIMD
+    return LEXER_SCAN_SSE2;
+#else
+    return LEXER_SCAN_SCALAR;
+#endif
+}
+
+/**
+ * Check if the CPU can run a scanner, AVX2 is looked up once.
+ *
+ * @param scanner the scanner.
+ * @return true if the scanner can be set in a lexer.
+ */
+bool lexer_has_scanner(enum lexer_scanner scanner){
+#ifdef LEXER_SIMD
+    static int avx2 = -1;
+
+    if(scanner != LEXER_SCAN_AVX2){
+        return true;
+    }
+
+    if(avx2 == -1){
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    return avx2 == 1;
+#else
+    return scanner == LEXER_SCAN_SCALAR;
+#endif
+}
+
+/**
+ * Start scanning a line with lexer_best_scanner.
+ *
+ * @param lexer the lexer to initialize.
+ * @param line the line to scan, it must outlive the lexer and the tokens.
+ * @param length the number of characters in the line.
+ */
+void lexer_init(struct lexer *lexer, const char *line, size_t length){
+    lexer->line = line;
+    lexer->length = length;
+    lexer->position = 0;
+    lexer->scanner = lexer_best_scanner();
+}
+
+/**
+ * Scan the next token. Blanks between tokens are skipped, < > >> <& >& << <<< | ; & && and || are
+ * operators and everything else is a word. A redirection operator may follow the number of the
+ * descriptor it redirects (eg. 2> or 3<), the number is part of the token. Quotes and backslashes
+ * keep blanks and operators inside a word.
+ *
+ * @param lexer the lexer.
+ * @param token set to the token that was scanned.
+ * @return the type of the token.
+ */
+enum token_type lexer_next(struct lexer *lexer, struct token *token){
+    const char *line = lexer->line;
+    size_t i = lexer->position;
+    size_t start;
+    enum token_type type;
+
+    while(i < lexer->length && is_blank(line[i])){
+        i++;
+    }
+
+    start = i;
+
+    if(i >= lexer->length){
+        type = TOKEN_END;
+    } else if(line[i] == '<' || line[i] == '>' || io_number(lexer, i) > 0){
+        type = scan_redirection(lexer, &i);
+    } else if(line[i] == '|'){
+        i++;
+        type = TOKEN_PIPE;
+
+        if(i < lexer->length && line[i] == '|'){
+            i++;
+            type = TOKEN_OR;
+        }
+    } else if(line[i] == ';'){
+        i++;
+        type = TOKEN_SEQUENCE;
+    } else if(line[i] == '&'){
+        i++;
+        type = TOKEN_BACKGROUND;
+
+        if(i < lexer->length && line[i] == '&'){
+            i++;
+            type = TOKEN_AND;
+        }
+    } else if(scan_word(lexer, &i)){
+        type = TOKEN_WORD;
+    } else{
+        type = TOKEN_ERROR;
+    }
+
+    token->type = type;
+    token->text = &line[start];
+    token->length = i - start;
+    lexer->position = i;
+
+    return type;
+}
+
+/**
+ * Copy the text of a word, removing the quotes and backslashes, and NUL terminate it.
+ * The result is never longer than the word, so dest may be the word itself.
+ *
+ * @param dest where to write the word, at least length + 1 characters.
+ * @param text the text of the word.
+ * @param length the number of characters in the word.
+ * @return the number of characters written, not counting the NUL.
+ */
+size_t lexer_unquote(char *dest, const char *text, size_t length){
+    size_t out;
+
+    out = unquote(dest, text, length);
+    dest[out] = '\0';
+
+    return out;
+}
+
+/**
+ * Remove the quotes and backslashes from a word without writing past it. The word is not NUL
+ * terminated, the characters after the returned length are left as they were.
+ *
+ * @param text the text of the word.
+ * @param length the number of characters in the word.
+ * @return the number of characters left in the word.
+ */
+size_t lexer_unquote_in_place(char *text, size_t length){
+    return unquote(text, text, length);
+}
+
+/**
+ * Copy the text of a word to dest without its quotes and backslashes.
+ *
+ * @param dest where to write the word, at least length characters, may be text.
+ * @param text the text of the word.
+ * @param length the number of characters in the word.
+ * @return the number of characters written.
+ */
+static size_t unquote(char *dest, const char *text, size_t length){
+    size_t out = 0;
+    char quote = '\0';
+
+    for(size_t i = 0; i < length; i++){
+        char c = text[i];
+
+        if(quote == '\0' && (c == '\'' || c == '"')){
+            quote = c;
+        } else if(quote != '\0' && c == quote){
+            quote = '\0';
+        } else if(c == '\\' && quote == '\0' && i + 1 < length){
+            i++;
+            dest[out++] = text[i];
+        } else if(c == '\\' && quote == '"' && i + 1 < length &&
+                  (text[i + 1] == '"' || text[i + 1] == '\\' || text[i + 1] == '$' || text[i + 1] == '`')){
+            i++;
+            dest[out++] = text[i];
+        } else{
+            dest[out++] = c;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * Move past the end of the word that starts at *position.
+ *
+ * @param lexer the lexer.
+ * @param position the start of the word, set to the character after the word.
+ * @return false if a quote was not closed before the end of the line.
+ */
+static bool scan_word(const struct lexer *lexer, size_t *position){
+    const char *line = lexer->line;
+    size_t i = *position;
+    char quote = '\0';
+
+    while(i < lexer->length){
+        char c;
+
+        if(quote == '\0'){
+            // the plain characters are skipped a block at a time, up to the next one that ends the word or quotes
+            i = find_special(lexer, i);
+
+            if(i >= lexer->length){
+                break;
+            }
+        } else if(quote == '\''){
+            // only the closing quote means anything inside single quotes
+            const char *end = memchr(&line[i], '\'', lexer->length - i);
+
+            if(end == NULL){
+                i = lexer->length;
+                break;
+            }
+
+            i = (size_t)(end - line);
+        }
+
+        c = line[i];
+
+        if(quote != '\0'){
+            if(c == quote){
+                quote = '\0';
+            } else if(c == '\\' && quote == '"' && i + 1 < lexer->length){
+                i++;
+            }
+        } else if(c == '\'' || c == '"'){
+            quote = c;
+        } else if(c == '\\' && i + 1 < lexer->length){
+            i++;
+        } else if(is_blank(c) || is_operator(c)){
+            break;
+        }
+
+        i++;
+    }
+
+    *position = i;
+
+    return quote == '\0';
+}
+
+static bool is_blank(char c){
+    return c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\n' || c == '\r';
+}
+
+static bool is_operator(char c){
+    return c == '<' || c == '>' || c == '|' || c == ';' || c == '&';
+}
+
+/**
+ * Check if a character ends a word or changes how the rest of it is read.
+ *
+ * @param c the character.
+ * @return true for a blank, an operator, a quote or a backslash.
+ */
+static bool is_special(char c){
+    return is_blank(c) || is_operator(c) || c == '\'' || c == '"' || c == '\\';
+}
+
+/**
+ * Find the next special character (see is_special) with the scanner of the lexer.
+ *
+ * @param lexer the lexer.
+ * @param position where to start looking.
+ * @return the offset of the character, or the length of the line if there is none.
+ */
+static size_t find_special(const struct lexer *lexer, size_t position){
+#ifdef LEXER_SIMD
+    if(lexer->scanner == LEXER_SCAN_AVX2){
+        return find_special_avx2(lexer->line, position, lexer->length);
+    }
+
+    if(lexer->scanner == LEXER_SCAN_SSE2){
+        return find_special_sse2(lexer->line, position, lexer->length);
+    }
+#endif
+
+    return find_special_scalar(lexer->line, position, lexer->length);
+}
+
+/**
+ * Find the next special character a character at a time.
+ *
+ * @param line the line.
+ * @param position where to start looking.
+ * @param length the length of the line.
+ * @return the offset of the character, or length if there is none.
+ */
+static size_t find_special_scalar(const char *line, size_t position, size_t length){
+    size_t i = position;
+
+    while(i < length && !is_special(line[i])){
+        i++;
+    }
+
+    return i;
+}
+
+#ifdef LEXER_SIMD
+/**
+ * Find the next special character 16 characters at a time. The end of the line that does not
+ * fill a block is scanned a character at a time, nothing is read past the line.
+ *
+ * @param line the line.
+ * @param position where to start looking.
+ * @param length the length of the line.
+ * @return the offset of the character, or length if there is none.
+ */
+static size_t find_special_sse2(const char *line, size_t position, size_t length){
+    size_t i = position;
+
+    while(length - i >= 16){
+        unsigned mask = special_mask_sse2(&line[i]);
+
+        if(mask != 0){
+            return i + (size_t)__builtin_ctz(mask);
+        }
+
+        i += 16;
+    }
+
+    return find_special_scalar(line, i, length);
+}
+
+/**
+ * Find the next special character 32 characters at a time. Most words end in their first 16
+ * characters, so those are looked at with SSE2 before the 32 character blocks are set up. The end
+ * of the line that does not fill a block is left to find_special_sse2.
+ *
+ * @param line the line.
+ * @param position where to start looking.
+ * @param length the length of the line.
+ * @return the offset of the character, or length if there is none.
+ */
+static size_t find_special_avx2(const char *line, size_t position, size_t length){
+    size_t i = position;
+
+    if(length - i >= 16){
+        unsigned mask = special_mask_sse2(&line[i]);
+
+        if(mask != 0){
+            return i + (size_t)__builtin_ctz(mask);
+        }
+
+        i += 16;
+    }
+
+    while(length - i >= 32){
+        unsigned mask = special_mask_avx2(&line[i]);
+
+        if(mask != 0){
+            return i + (size_t)__builtin_ctz(mask);
+        }
+
+        i += 32;
+    }
+
+    return find_special_sse2(line, i, length);
+}
+
+/**
+ * Compare 16 characters with every special character at once, the blanks \t to \r as a range.
+ *
+ * @param block the characters.
+ * @return a bit for each character, set if it is special, the first is the lowest.
+ */
+static unsigned special_mask_sse2(const char *block){
+    __m128i c = _mm_loadu_si128((const __m128i *)block);
+    __m128i special;
+
+    // the bytes above 127 are negative, so they are never in the range
+    special = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('\r' + 1)));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('\'')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('"')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('\\')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('<')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('>')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('|')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8(';')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_set1_epi8('&')));
+
+    return (unsigned)_mm_movemask_epi8(special);
+}
+
+/**
+ * Compare 32 characters with every special character at once, as special_mask_sse2 does.
+ *
+ * @param block the characters.
+ * @return a bit for each character, set if it is special, the first is the lowest.
+ */
+static unsigned special_mask_avx2(const char *block){
+    __m256i c = _mm256_loadu_si256((const __m256i *)block);
+    __m256i special;
+
+    special = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('\t' - 1)),
+                               _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), c));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\'')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\\')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('<')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('>')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('|')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8(';')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('&')));
+
+    return (unsigned)_mm256_movemask_epi8(special);
+}
+#endif
+
+/**
+ * Count the digits at position that are the descriptor of a redirection, like the 2 of 2>.
+ *
+ * @param lexer the lexer.
+ * @param position the start of the token.
+ * @return the number of digits, 0 if they are not followed by < or > (so they start a word).
+ */
+static size_t io_number(const struct lexer *lexer, size_t position){
+    size_t i = position;
+
+    while(i < lexer->length && lexer->line[i] >= '0' && lexer->line[i] <= '9'){
+        i++;
+    }
+
+    if(i == position || i >= lexer->length || (lexer->line[i] != '<' && lexer->line[i] != '>')){
+        return 0;
+    }
+
+    return i - position;
+}
+
+/**
+ * Move past a redirection operator and the descriptor in front of it.
+ *
+ * @param lexer the lexer.
+ * @param position the start of the token, set to the character after the operator.
+ * @return the type of the operator, 2> and 2>> are TOKEN_REDIRECT_ERR and TOKEN_APPEND_ERR.
+ */
+static enum token_type scan_redirection(const struct lexer *lexer, size_t *position){
+    const char *line = lexer->line;
+    size_t i = *position + io_number(lexer, *position);
+    bool is_err = i == *position + 1 && line[*position] == '2';
+    enum token_type type;
+
+    if(line[i] == '<'){
+        i++;
+        type = TOKEN_REDIRECT_IN;
+
+        if(i < lexer->length && line[i] == '<'){
+            i++;
+            type = TOKEN_HERE_DOC;
+
+            if(i < lexer->length && line[i] == '<'){
+                i++;
+                type = TOKEN_HERE_STRING;
+            }
+        } else if(i < lexer->length && line[i] == '&'){
+            i++;
+            type = TOKEN_DUP_IN;
+        }
+    } else{
+        i++;
+        type = is_err ? TOKEN_REDIRECT_ERR : TOKEN_REDIRECT_OUT;
+
+        if(i < lexer->length && line[i] == '>'){
+            i++;
+            type = is_err ? TOKEN_APPEND_ERR : TOKEN_APPEND_OUT;
+        } else if(i < lexer->length && line[i] == '&'){
+            i++;
+            type = TOKEN_DUP_OUT;
+        }
+    }
+
+    *position = i;
+
+    return type;
+}
@@ -15,18 +15,25 @@
  *  along with dc_shell.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "arena.h"
 #include "shell.h"
+#include "state.h"
 #include <dc_application/command_line.h>
 #include <dc_application/config.h>
 #include <dc_application/options.h>
 #include <dc_posix/dc_stdlib.h>
 #include <dc_posix/dc_string.h>
 #include <getopt.h>
+#include <unistd.h>
 
 struct application_settings
 {
-    struct dc_opt_settings  opts;
-    struct dc_setting_bool *verbose;
+    struct dc_opt_settings    opts;
+    struct dc_setting_bool   *verbose;
+    struct dc_setting_uint16 *arena_size;
+    struct dc_setting_string *spawn;
+    struct dc_setting_uint16 *max_jobs;
+    struct dc_setting_bool   *batch;
 };
 
 static struct dc_application_settings *create_settings(const struct dc_posix_env *env, struct dc_error *err);
@@ -36,6 +43,12 @@ destroy_settings(const struct dc_posix_env *env, struct dc_error *err, struct dc
 
 static int run(const struct dc_posix_env *env, struct dc_error *err, struct dc_application_settings *settings);
 
+static bool parse_spawn_backend(const struct dc_posix_env *env, const char *name, enum spawn_backend *backend);
+
+// run only gets the settings, the script is the first word after the options
+static int    argument_count;
+static char **arguments;
+
 int        main(int argc, char *argv[])
 {
     dc_posix_tracer             tracer;
@@ -51,6 +64,8 @@ int        main(int argc, char *argv[])
     // reporter = dc_error_default_error_reporter;
     dc_posix_env_init(&env, tracer);
     dc_error_init(&err, reporter);
+    argument_count = argc;
+    arguments = argv;
     info    = dc_application_info_create(&env, &err, "dcshell");
     ret_val = dc_application_run(&env,
                                  &err,
@@ -71,7 +86,11 @@ int        main(int argc, char *argv[])
 
 static struct dc_application_settings *create_settings(const struct dc_posix_env *env, struct dc_error *err)
 {
-    static bool                  default_verbose = false;
+    static bool                  default_verbose    = false;
+    static uint16_t              default_arena_size = ARENA_DEFAULT_BLOCK_SIZE / 1024;
+    static const char           *default_spawn      = "vfork";
+    static uint16_t              default_max_jobs   = 0;
+    static bool                  default_batch      = false;
     struct application_settings *settings;
 
     DC_TRACE(env);
@@ -84,6 +103,10 @@ static struct dc_application_settings *create_settings(const struct dc_posix_env
 
     settings->opts.parent.config_path = dc_setting_path_create(env, err);
     settings->verbose                 = dc_setting_bool_create(env, err);
+    settings->arena_size              = dc_setting_uint16_create(env, err);
+    settings->spawn                   = dc_setting_string_create(env, err);
+    settings->max_jobs                = dc_setting_uint16_create(env, err);
+    settings->batch                   = dc_setting_bool_create(env, err);
 
     struct options opts[]             = {
         {(struct dc_setting *)settings->opts.parent.config_path,
@@ -106,6 +129,46 @@ static struct dc_application_settings *create_settings(const struct dc_posix_env
          "verbose",
          dc_flag_from_config,
          &default_verbose},
+        {(struct dc_setting *)settings->arena_size,
+         dc_options_set_uint16,
+         "arena-size",
+         required_argument,
+         'a',
+         "ARENA_SIZE",
+         dc_uint16_from_string,
+         "arena-size",
+         dc_uint16_from_config,
+         &default_arena_size},
+        {(struct dc_setting *)settings->spawn,
+         dc_options_set_string,
+         "spawn",
+         required_argument,
+         's',
+         "SPAWN",
+         dc_string_from_string,
+         "spawn",
+         dc_string_from_config,
+         default_spawn},
+        {(struct dc_setting *)settings->max_jobs,
+         dc_options_set_uint16,
+         "max-jobs",
+         required_argument,
+         'j',
+         "MAX_JOBS",
+         dc_uint16_from_string,
+         "max-jobs",
+         dc_uint16_from_config,
+         &default_max_jobs},
+        {(struct dc_setting *)settings->batch,
+         dc_options_set_bool,
+         "batch",
+         no_argument,
+         'b',
+         "BATCH",
+         dc_flag_from_string,
+         "batch",
+         dc_flag_from_config,
+         &default_batch},
     };
 
     // note the trick here - we use calloc and add 1 to ensure the last line is all 0/NULL
@@ -113,7 +176,7 @@ static struct dc_application_settings *create_settings(const struct dc_posix_env
     settings->opts.opts_size  = sizeof(struct options);
     settings->opts.opts       = dc_calloc(env, err, settings->opts.opts_count, settings->opts.opts_size);
     dc_memcpy(env, settings->opts.opts, opts, sizeof(opts));
-    settings->opts.flags      = "c:v:";
+    settings->opts.flags      = "c:v:a:s:j:b";
     settings->opts.env_prefix = "DC_SHELL_";
 
     return (struct dc_application_settings *)settings;
@@ -128,6 +191,10 @@ static int destroy_settings(const struct dc_posix_env               *env,
     DC_TRACE(env);
     app_settings = (struct application_settings *)*psettings;
     dc_setting_bool_destroy(env, &app_settings->verbose);
+    dc_setting_uint16_destroy(env, &app_settings->arena_size);
+    dc_setting_string_destroy(env, &app_settings->spawn);
+    dc_setting_uint16_destroy(env, &app_settings->max_jobs);
+    dc_setting_bool_destroy(env, &app_settings->batch);
     dc_free(env, app_settings->opts.opts, app_settings->opts.opts_count);
     dc_free(env, *psettings, sizeof(struct application_settings));
 
@@ -139,14 +206,63 @@ static int destroy_settings(const struct dc_posix_env               *env,
     return 0;
 }
 
-static int run(const struct dc_posix_env                              *env,
-               struct dc_error                                        *err,
-               __attribute__((unused)) struct dc_application_settings *settings)
+static int run(const struct dc_posix_env *env, struct dc_error *err, struct dc_application_settings *settings)
 {
-    int ret_val;
+    struct application_settings *app_settings;
+    struct shell_settings        shell_settings;
+    int                          ret_val;
 
     DC_TRACE(env);
-    ret_val = run_shell(env, err, stdin, stdout, stderr);
+    app_settings = (struct application_settings *)settings;
+    dc_memset(env, &shell_settings, 0, sizeof(shell_settings));
+    shell_settings.arena_block_size = (size_t)dc_setting_uint16_get(env, app_settings->arena_size) * 1024;
+    shell_settings.max_jobs         = dc_setting_uint16_get(env, app_settings->max_jobs);
+    shell_settings.verbose          = dc_setting_bool_get(env, app_settings->verbose);
+
+    // getopt_long has moved the words that are not options to the end, optind is the first
+    if(optind < argument_count)
+    {
+        shell_settings.script = arguments[optind];
+    }
+
+    // input that is not a terminal is a script, no one is there to see a prompt
+    shell_settings.batch = dc_setting_bool_get(env, app_settings->batch) || !isatty(STDIN_FILENO) ||
+                           shell_settings.script != NULL;
+
+    if(!parse_spawn_backend(env, dc_setting_string_get(env, app_settings->spawn), &shell_settings.spawn_backend))
+    {
+        fprintf(stderr, "unknown spawn backend \"%s\" (posix_spawn, vfork or fork)\n",
+                dc_setting_string_get(env, app_settings->spawn));
+
+        return EXIT_FAILURE;
+    }
+
+    ret_val = run_shell(env, err, &shell_settings, stdin, stdout, stderr);
 
     return ret_val;
 }
+
+static bool parse_spawn_backend(const struct dc_posix_env *env, const char *name, enum spawn_backend *backend)
+{
+    static const struct
+    {
+        const char        *name;
+        enum spawn_backend backend;
+    } backends[] = {
+        {"posix_spawn", SPAWN_POSIX_SPAWN},
+        {"vfork", SPAWN_VFORK},
+        {"fork", SPAWN_FORK},
+    };
+
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+    {
+        if(dc_strcmp(env, name, backends[i].name) == 0)
+        {
+            *backend = backends[i].backend;
+
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+#include <dc_posix/dc_fcntl.h>
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <dc_posix/dc_unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "command.h"
+#include "execute.h"
+#include "input.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "path_cache.h"
+#include "util.h"
+
+/*! \struct parallel_slot
+    \brief A child that parallel is running and the files its output is kept in.
+*/
+struct parallel_slot
+{
+  pid_t pid;                /**< the child, -1 if the slot is free */
+  int out_fd;               /**< an unlinked file that holds the stdout of the child until it exits */
+  int err_fd;               /**< an unlinked file that holds the stderr of the child until it exits */
+  char *input;              /**< the input the child was started with */
+};
+
+static char *next_input(const struct dc_posix_env *env, struct dc_error *err, const struct parallel_options *options,
+                        size_t *next, char **line, size_t *line_size);
+static int start_child(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                       const struct parallel_options *options, struct parallel_slot *slot, int stdin_fd);
+static char *replace_braces(const struct dc_posix_env *env, struct dc_error *err, const char *word,
+                            const char *input);
+static size_t reap(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                   const struct parallel_options *options, struct parallel_slot *slots, size_t *failed);
+static void finish_child(const struct dc_posix_env *env, struct state *state, const struct parallel_options *options,
+                         struct parallel_slot *slot, int exit_code, const struct rusage *usage);
+static void copy_output(int fd, FILE *stream);
+
+/**
+ * Run the command once for each input, keeping up to max_procs children running.
+ *
+ * The stdout and stderr of each child go to unlinked temporary files, and are copied to
+ * state->stdout and state->stderr when it exits, so the output of one child is never mixed
+ * with another. A child reads /dev/null when the inputs are read from a stream. Only the
+ * children of parallel are reaped (with wait4 for their resource usage), waiting for the
+ * SIGCHLD of state->jobs between them, so a job started with & is left alone.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only set for errors that should stop the shell.
+ * @param state the shell, the commands are found through state->path_cache.
+ * @param options the command, inputs and limits.
+ * @return the number of children that failed, at most PARALLEL_MAX_FAILED.
+ */
+int parallel_run(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                 const struct parallel_options *options){
+    struct parallel_slot *slots;
+    size_t running;
+    size_t failed;
+    size_t next;
+    char *line;
+    size_t line_size;
+    int stdin_fd;
+
+    slots = dc_calloc(env, err, options->max_procs, sizeof(struct parallel_slot));
+
+    if(dc_error_has_error(err)){
+        return 1;
+    }
+
+    for(size_t i = 0; i < options->max_procs; i++){
+        slots[i].pid = -1;
+        slots[i].out_fd = -1;
+        slots[i].err_fd = -1;
+    }
+
+    for(size_t i = 0; i < options->max_procs && dc_error_has_no_error(err); i++){
+        slots[i].out_fd = open_temp(env, err);
+
+        if(dc_error_has_no_error(err)){
+            slots[i].err_fd = open_temp(env, err);
+        }
+    }
+
+    stdin_fd = -1;
+
+    // the children must not eat the lines that are still to be read
+    if(options->inputs == NULL && dc_error_has_no_error(err)){
+        stdin_fd = dc_open(env, err, "/dev/null", O_RDONLY | O_CLOEXEC, 0);
+    }
+
+    // a forked child must not print what the shell has buffered a second time
+    fflush(NULL);
+
+    running = 0;
+    failed = 0;
+    next = 0;
+    line = NULL;
+    line_size = 0;
+
+    while(dc_error_has_no_error(err)){
+        char *input;
+        size_t slot;
+
+        input = next_input(env, err, options, &next, &line, &line_size);
+
+        if(input == NULL){
+            break;
+        }
+
+        if(running == options->max_procs){
+            running -= reap(env, err, state, options, slots, &failed);
+        }
+
+        for(slot = 0; slots[slot].pid != -1; slot++){
+        }
+
+        slots[slot].input = dc_strdup(env, err, input);
+
+        if(dc_error_has_no_error(err)){
+            int exit_code = start_child(env, err, state, options, &slots[slot], stdin_fd);
+
+            if(slots[slot].pid > 0){
+                running++;
+            } else{
+                finish_child(env, state, options, &slots[slot], exit_code, NULL);
+                failed++;
+            }
+        }
+    }
+
+    while(running > 0 && dc_error_has_no_error(err)){
+        running -= reap(env, err, state, options, slots, &failed);
+    }
+
+    free(line);
+
+    if(stdin_fd != -1){
+        close(stdin_fd);
+    }
+
+    for(size_t i = 0; i < options->max_procs; i++){
+        if(slots[i].out_fd != -1){
+            close(slots[i].out_fd);
+        }
+
+        if(slots[i].err_fd != -1){
+            close(slots[i].err_fd);
+        }
+
+        if(slots[i].input != NULL){
+            dc_free(env, slots[i].input, dc_strlen(env, slots[i].input) + 1);
+        }
+    }
+
+    dc_free(env, slots, options->max_procs * sizeof(struct parallel_slot));
+
+    return failed > PARALLEL_MAX_FAILED ? PARALLEL_MAX_FAILED : (int)failed;
+}
+
+/**
+ * Get the next input, from options->inputs or a line of options->reader or options->input
+ * without its newline.
+ *
+ * @param env the posix environment.
+ * @param err the error object, set if reading failed.
+ * @param options the inputs.
+ * @param next the index of the next of options->inputs.
+ * @param line the buffer for getline.
+ * @param line_size the size of the buffer.
+ * @return the input, NULL when there are no more.
+ */
+static char *next_input(const struct dc_posix_env *env, struct dc_error *err, const struct parallel_options *options,
+                        size_t *next, char **line, size_t *line_size){
+    ssize_t length;
+
+    if(options->inputs != NULL){
+        return *next < options->input_count ? options->inputs[(*next)++] : NULL;
+    }
+
+    // the lines the shell read ahead of the command are in its reader, not in the stream
+    if(options->reader != NULL){
+        const char *view;
+        size_t view_length;
+
+        view = line_reader_next_line(env, err, options->reader, &view_length);
+
+        if(view == NULL){
+            return NULL;
+        }
+
+        if(view_length > 0 && view[view_length - 1] == '\n'){
+            view_length--;
+        }
+
+        if(view_length + 1 > *line_size){
+            char *grown = dc_realloc(env, err, *line, view_length + 1);
+
+            if(dc_error_has_error(err)){
+                return NULL;
+            }
+
+            *line = grown;
+            *line_size = view_length + 1;
+        }
+
+        dc_memcpy(env, *line, view, view_length);
+        (*line)[view_length] = '\0';
+
+        return *line;
+    }
+
+    errno = 0;
+    length = getline(line, line_size, options->input);
+
+    if(length == -1){
+        if(errno != 0){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+        }
+
+        return NULL;
+    }
+
+    if(length > 0 && (*line)[length - 1] == '\n'){
+        (*line)[length - 1] = '\0';
+    }
+
+    return *line;
+}
+
+/**
+ * Start the command for the input of the slot, with its stdout and stderr going to the files of the slot.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell.
+ * @param options the command.
+ * @param slot the slot, slot->pid is set to the child or -1 if it was not started.
+ * @param stdin_fd the stdin of the child, -1 for the one of the shell.
+ * @return the exit code if the child was not started.
+ */
+static int start_child(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                       const struct parallel_options *options, struct parallel_slot *slot, int stdin_fd){
+    struct command command;
+    int std_fds[3];
+    char **argv;
+    size_t argc;
+    bool replaced;
+
+    slot->pid = -1;
+    argv = dc_calloc(env, err, options->word_count + 2, sizeof(char *));
+
+    if(dc_error_has_error(err)){
+        return 1;
+    }
+
+    argc = 0;
+    replaced = false;
+
+    for(size_t i = 0; i < options->word_count && dc_error_has_no_error(err); i++){
+        argv[argc] = replace_braces(env, err, options->words[i], slot->input);
+
+        if(argv[argc] == NULL){
+            argv[argc] = options->words[i];
+        } else{
+            replaced = true;
+        }
+
+        argc++;
+    }
+
+    // like xargs, without a {} the input is the last argument
+    if(!replaced){
+        argv[argc++] = slot->input;
+    }
+
+    dc_memset(env, &command, 0, sizeof(command));
+    command.command = argv[0];
+    command.argv = argv;
+    command.argc = argc;
+    command.arena = state->arena;
+
+    if(dc_error_has_no_error(err) && dc_strchr(env, command.command, '/') == NULL){
+        command.program = path_cache_lookup(env, err, state->path_cache, state->path, command.command);
+
+        if(command.program == NULL && dc_error_has_no_error(err)){
+            fprintf(state->stderr, "parallel: %s: command not found\n", command.command);
+            command.exit_code = 127;
+        }
+    }
+
+    if(dc_error_has_no_error(err) && command.exit_code == 0){
+        std_fds[STDIN_FILENO] = stdin_fd;
+        std_fds[STDOUT_FILENO] = slot->out_fd;
+        std_fds[STDERR_FILENO] = slot->err_fd;
+        slot->pid = execute_start(env, err, &command, state->path, state->settings.spawn_backend, std_fds,
+                                  state->stderr);
+    }
+
+    // execute_start puts NULL in argv[0], the command still has it
+    argv[0] = command.command;
+
+    for(size_t i = 0; i < options->word_count; i++){
+        if(argv[i] != NULL && argv[i] != options->words[i]){
+            dc_free(env, argv[i], dc_strlen(env, argv[i]) + 1);
+        }
+    }
+
+    dc_free(env, argv, (options->word_count + 2) * sizeof(char *));
+
+    return dc_error_has_error(err) ? 1 : command.exit_code;
+}
+
+/**
+ * Replace every {} in a word with the input.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param word the word.
+ * @param input the input.
+ * @return a new string, NULL if the word has no {}.
+ */
+static char *replace_braces(const struct dc_posix_env *env, struct dc_error *err, const char *word,
+                            const char *input){
+    const char *brace;
+    size_t count;
+    size_t input_length;
+    char *result;
+    char *end;
+
+    count = 0;
+
+    for(brace = strstr(word, "{}"); brace != NULL; brace = strstr(brace + 2, "{}")){
+        count++;
+    }
+
+    if(count == 0){
+        return NULL;
+    }
+
+    input_length = dc_strlen(env, input);
+    result = dc_malloc(env, err, dc_strlen(env, word) - count * 2 + count * input_length + 1);
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    end = result;
+
+    for(brace = strstr(word, "{}"); brace != NULL; brace = strstr(word, "{}")){
+        dc_memcpy(env, end, word, (size_t)(brace - word));
+        end += brace - word;
+        dc_memcpy(env, end, input, input_length);
+        end += input_length;
+        word = brace + 2;
+    }
+
+    strcpy(end, word);
+
+    return result;
+}
+
+/**
+ * Block until at least one child finishes and reap every child that has.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell, its job table gets the SIGCHLD.
+ * @param options the options.
+ * @param slots the children.
+ * @param failed incremented for each child that exited with a code that is not 0.
+ * @return the number of children reaped.
+ */
+static size_t reap(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                   const struct parallel_options *options, struct parallel_slot *slots, size_t *failed){
+    size_t reaped;
+
+    reaped = 0;
+
+    while(reaped == 0 && dc_error_has_no_error(err)){
+        for(size_t i = 0; i < options->max_procs; i++){
+            struct rusage usage;
+            int status;
+            pid_t pid;
+
+            if(slots[i].pid == -1){
+                continue;
+            }
+
+            while((pid = wait4(slots[i].pid, &status, WNOHANG, &usage)) == -1 && errno == EINTR){
+            }
+
+            if(pid == slots[i].pid){
+                int exit_code = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+
+                finish_child(env, state, options, &slots[i], exit_code, &usage);
+                reaped++;
+
+                if(exit_code != 0){
+                    (*failed)++;
+                }
+            }
+        }
+
+        if(reaped == 0){
+            job_table_wait_sigchld(err, state->jobs);
+        }
+    }
+
+    return reaped;
+}
+
+/**
+ * Print the output of a child that finished, and with -v its exit code and resource usage,
+ * and free the slot for the next child.
+ *
+ * @param env the posix environment.
+ * @param state the shell.
+ * @param options the options.
+ * @param slot the slot of the child.
+ * @param exit_code the exit code of the child.
+ * @param usage the resource usage of the child, NULL if it was not started.
+ */
+static void finish_child(const struct dc_posix_env *env, struct state *state, const struct parallel_options *options,
+                         struct parallel_slot *slot, int exit_code, const struct rusage *usage){
+    copy_output(slot->out_fd, state->stdout);
+    copy_output(slot->err_fd, state->stderr);
+
+    if(options->verbose && usage != NULL){
+        fprintf(state->stderr, "parallel: %s: exit %d, user %ld.%03lds, sys %ld.%03lds, max rss %ldKB\n",
+                slot->input, exit_code, (long)usage->ru_utime.tv_sec, (long)usage->ru_utime.tv_usec / 1000,
+                (long)usage->ru_stime.tv_sec, (long)usage->ru_stime.tv_usec / 1000, usage->ru_maxrss);
+    } else if(options->verbose){
+        fprintf(state->stderr, "parallel: %s: exit %d\n", slot->input, exit_code);
+    }
+
+    dc_free(env, slot->input, dc_strlen(env, slot->input) + 1);
+    slot->input = NULL;
+    slot->pid = -1;
+}
+
+/**
+ * Copy what a child wrote to its file to a stream and empty the file for the next child.
+ * The child shares the offset, so the file is read from the start and the offset put back there.
+ *
+ * @param fd the file.
+ * @param stream where to copy it.
+ */
+static void copy_output(int fd, FILE *stream){
+    char buffer[4096];
+    ssize_t count;
+
+    if(lseek(fd, 0, SEEK_SET) == -1){
+        return;
+    }
+
+    while((count = read(fd, buffer, sizeof(buffer))) > 0){
+        fwrite(buffer, 1, (size_t)count, stream);
+    }
+
+    fflush(stream);
+
+    if(ftruncate(fd, 0) == 0){
+        lseek(fd, 0, SEEK_SET);
+    }
+}
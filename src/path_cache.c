@@ -0,0 +1,465 @@
+#define _GNU_SOURCE
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "path_cache.h"
+#include "util.h"
+
+#ifdef O_PATH
+#define DIR_OPEN_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#else
+#define DIR_OPEN_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#endif
+
+static size_t hash_name(const char *name);
+static void open_dirs(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache,
+                      char **dirs);
+static void close_dirs(const struct dc_posix_env *env, struct path_cache *cache);
+static bool mtimes_changed(const struct path_cache *cache, char **dirs);
+static size_t search_dirs(const struct path_cache *cache, const char *name);
+static char *join_path(const struct dc_posix_env *env, struct dc_error *err, const char *dir, const char *name);
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache);
+
+/**
+ * Create an empty cache.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the cache, destroy it with path_cache_destroy.
+ */
+struct path_cache *path_cache_create(const struct dc_posix_env *env, struct dc_error *err){
+    struct path_cache *cache;
+
+    cache = dc_calloc(env, err, 1, sizeof(struct path_cache));
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    cache->buckets = dc_calloc(env, err, PATH_CACHE_INITIAL_BUCKETS, sizeof(struct path_cache_entry *));
+
+    if(dc_error_has_error(err)){
+        dc_free(env, cache, sizeof(struct path_cache));
+        return NULL;
+    }
+
+    cache->bucket_count = PATH_CACHE_INITIAL_BUCKETS;
+
+    return cache;
+}
+
+/**
+ * Free the cache and set it to NULL.
+ *
+ * @param env the posix environment.
+ * @param pcache the cache to destroy, may point at NULL.
+ */
+void path_cache_destroy(const struct dc_posix_env *env, struct path_cache **pcache){
+    struct path_cache *cache = *pcache;
+
+    if(cache != NULL){
+        path_cache_clear(env, cache);
+        dc_free(env, cache->buckets, cache->bucket_count * sizeof(struct path_cache_entry *));
+
+        if(cache->path_value != NULL){
+            dc_free(env, cache->path_value, dc_strlen(env, cache->path_value) + 1);
+        }
+
+        close_dirs(env, cache);
+        dc_free(env, cache, sizeof(struct path_cache));
+        *pcache = NULL;
+    }
+}
+
+/**
+ * Remove every entry, the hit and miss counts are kept.
+ *
+ * @param env the posix environment.
+ * @param cache the cache.
+ */
+void path_cache_clear(const struct dc_posix_env *env, struct path_cache *cache){
+    for(size_t i = 0; i < cache->bucket_count; i++){
+        while(cache->buckets[i] != NULL){
+            struct path_cache_entry *entry = cache->buckets[i];
+
+            cache->buckets[i] = entry->next;
+            dc_free(env, entry->name, dc_strlen(env, entry->name) + 1);
+
+            if(entry->path != NULL){
+                dc_free(env, entry->path, dc_strlen(env, entry->path) + 1);
+            }
+
+            dc_free(env, entry, sizeof(struct path_cache_entry));
+        }
+    }
+
+    cache->count = 0;
+    cache->negative_count = 0;
+}
+
+/**
+ * Check if PATH is different to the one the cache was filled from.
+ *
+ * @param env the posix environment.
+ * @param cache the cache.
+ * @param path_value the current PATH, NULL if it is not set.
+ * @return true if the directories need to be parsed again.
+ */
+bool path_cache_path_changed(const struct dc_posix_env *env, const struct path_cache *cache,
+                             const char *path_value){
+    if(path_value == NULL){
+        path_value = "";
+    }
+
+    return cache->path_value == NULL || dc_strcmp(env, cache->path_value, path_value) != 0;
+}
+
+/**
+ * Empty the cache if PATH changed or a directory in it was modified since the last call, so a
+ * command that was added, removed or shadowed is searched for again. The directories are opened
+ * again when that happens.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param path_value the current PATH, NULL if it is not set.
+ * @param dirs the directories of path_value.
+ */
+void path_cache_validate(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache,
+                         const char *path_value, char **dirs){
+    if(path_cache_path_changed(env, cache, path_value)){
+        path_cache_clear(env, cache);
+
+        if(cache->path_value != NULL){
+            dc_free(env, cache->path_value, dc_strlen(env, cache->path_value) + 1);
+        }
+
+        cache->path_value = dc_strdup(env, err, path_value == NULL ? "" : path_value);
+
+        if(dc_error_has_no_error(err)){
+            open_dirs(env, err, cache, dirs);
+        }
+    } else if(mtimes_changed(cache, dirs)){
+        path_cache_clear(env, cache);
+        open_dirs(env, err, cache, dirs);
+    }
+}
+
+/**
+ * Open the directories again after the working directory changed, if any of them is relative
+ * (like . or bin). A relative directory was opened from the old working directory, and its
+ * mtime does not change with a cd, so path_cache_validate would keep using it. The cache is
+ * emptied when that happens, nothing is done for a PATH of absolute directories.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param dirs the directories of the last path_cache_validate.
+ */
+void path_cache_chdir(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache, char **dirs){
+    for(size_t i = 0; dirs != NULL && dirs[i] != NULL; i++){
+        if(dirs[i][0] != '/'){
+            path_cache_clear(env, cache);
+            open_dirs(env, err, cache, dirs);
+            return;
+        }
+    }
+}
+
+/**
+ * Find the file for a command name, searching dirs and remembering the result the first time.
+ * A name that is not in any directory is remembered too, so asking again costs no syscalls
+ * until path_cache_validate sees a directory change.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param dirs the directories of the last path_cache_validate.
+ * @param name the command name, without a /.
+ * @return the entry, owned by the cache until it is cleared, or NULL if no directory has an executable name.
+ */
+const struct path_cache_entry *path_cache_lookup(const struct dc_posix_env *env, struct dc_error *err,
+                                                 struct path_cache *cache, char **dirs, const char *name){
+    struct path_cache_entry *entry;
+    size_t bucket;
+    size_t dir;
+
+    bucket = hash_name(name) & (cache->bucket_count - 1);
+
+    for(entry = cache->buckets[bucket]; entry != NULL; entry = entry->next){
+        if(dc_strcmp(env, entry->name, name) == 0){
+            if(entry->path == NULL){
+                cache->negative_hits++;
+                entry->hits++;
+
+                return NULL;
+            }
+
+            cache->hits++;
+            entry->hits++;
+
+            return entry;
+        }
+    }
+
+    cache->misses++;
+    dir = search_dirs(cache, name);
+
+    if(dir == cache->dir_count && cache->negative_count >= PATH_CACHE_MAX_NEGATIVE){
+        return NULL;
+    }
+
+    entry = dc_calloc(env, err, 1, sizeof(struct path_cache_entry));
+
+    if(dc_error_has_no_error(err)){
+        entry->name = dc_strdup(env, err, name);
+    }
+
+    if(dc_error_has_no_error(err) && dir < cache->dir_count){
+        entry->path = join_path(env, err, dirs[dir], name);
+    }
+
+    if(dc_error_has_error(err)){
+        if(entry != NULL){
+            if(entry->name != NULL){
+                dc_free(env, entry->name, dc_strlen(env, entry->name) + 1);
+            }
+
+            dc_free(env, entry, sizeof(struct path_cache_entry));
+        }
+
+        return NULL;
+    }
+
+    entry->dir_fd = dir < cache->dir_count ? cache->dir_fds[dir] : -1;
+    entry->hits = 1;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    cache->count++;
+
+    if(entry->path == NULL){
+        cache->negative_count++;
+    }
+
+    if(cache->count > cache->bucket_count){
+        grow(env, err, cache);
+    }
+
+    return entry->path == NULL ? NULL : entry;
+}
+
+/**
+ * Print the entries that were found with their hit counts.
+ *
+ * @param cache the cache.
+ * @param stream where to print.
+ */
+void path_cache_print(const struct path_cache *cache, FILE *stream){
+    if(cache->count == cache->negative_count){
+        fprintf(stream, "hash: hash table empty\n");
+        return;
+    }
+
+    fprintf(stream, "hits\tcommand\n");
+
+    for(size_t i = 0; i < cache->bucket_count; i++){
+        for(const struct path_cache_entry *entry = cache->buckets[i]; entry != NULL; entry = entry->next){
+            if(entry->path != NULL){
+                fprintf(stream, "%4zu\t%s\n", entry->hits, entry->path);
+            }
+        }
+    }
+}
+
+/**
+ * FNV-1a hash of a command name.
+ *
+ * @param name the name.
+ * @return the hash.
+ */
+static size_t hash_name(const char *name){
+    uint64_t hash = UINT64_C(14695981039346656037);
+
+    for(const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++){
+        hash ^= *c;
+        hash *= UINT64_C(1099511628211);
+    }
+
+    return (size_t)hash;
+}
+
+/**
+ * Open each directory once and remember its mtime. A directory that cannot be opened gets an fd
+ * of -1 and a zero mtime, it just never has anything in it.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ * @param dirs the directories.
+ */
+static void open_dirs(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache,
+                      char **dirs){
+    size_t count = 0;
+
+    while(dirs != NULL && dirs[count] != NULL){
+        count++;
+    }
+
+    close_dirs(env, cache);
+
+    if(count == 0){
+        return;
+    }
+
+    cache->dir_fds = dc_malloc(env, err, count * sizeof(int));
+
+    if(dc_error_has_no_error(err)){
+        cache->mtimes = dc_calloc(env, err, count, sizeof(struct timespec));
+    }
+
+    if(dc_error_has_error(err)){
+        dc_free(env, cache->dir_fds, count * sizeof(int));
+        cache->dir_fds = NULL;
+        return;
+    }
+
+    cache->dir_count = count;
+
+    for(size_t i = 0; i < count; i++){
+        struct stat buf;
+
+        cache->dir_fds[i] = move_shell_fd(open(dirs[i], DIR_OPEN_FLAGS));
+
+        if(cache->dir_fds[i] != -1 && fstat(cache->dir_fds[i], &buf) == 0){
+            cache->mtimes[i] = buf.st_mtim;
+        }
+    }
+}
+
+/**
+ * Close the directories opened by open_dirs.
+ *
+ * @param env the posix environment.
+ * @param cache the cache.
+ */
+static void close_dirs(const struct dc_posix_env *env, struct path_cache *cache){
+    for(size_t i = 0; i < cache->dir_count; i++){
+        if(cache->dir_fds[i] != -1){
+            close(cache->dir_fds[i]);
+        }
+    }
+
+    dc_free(env, cache->dir_fds, cache->dir_count * sizeof(int));
+    dc_free(env, cache->mtimes, cache->dir_count * sizeof(struct timespec));
+    cache->dir_fds = NULL;
+    cache->mtimes = NULL;
+    cache->dir_count = 0;
+}
+
+/**
+ * Check if any directory was modified since it was opened, or a missing one now exists.
+ *
+ * @param cache the cache.
+ * @param dirs the directories.
+ * @return true if a directory has a different mtime.
+ */
+static bool mtimes_changed(const struct path_cache *cache, char **dirs){
+    for(size_t i = 0; i < cache->dir_count; i++){
+        struct stat buf;
+
+        if(cache->dir_fds[i] == -1){
+            if(stat(dirs[i], &buf) == 0){
+                return true;
+            }
+        } else if(fstat(cache->dir_fds[i], &buf) != 0 ||
+                  buf.st_mtim.tv_sec != cache->mtimes[i].tv_sec || buf.st_mtim.tv_nsec != cache->mtimes[i].tv_nsec){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Find the first directory with an executable regular file called name. The name is checked
+ * relative to each directory fd, so no file names are built.
+ *
+ * @param cache the cache with the open directories.
+ * @param name the command name.
+ * @return the index of the directory, or dir_count if it was not found.
+ */
+static size_t search_dirs(const struct path_cache *cache, const char *name){
+    for(size_t i = 0; i < cache->dir_count; i++){
+        struct stat buf;
+
+        if(cache->dir_fds[i] != -1 &&
+           fstatat(cache->dir_fds[i], name, &buf, 0) == 0 && S_ISREG(buf.st_mode) &&
+           faccessat(cache->dir_fds[i], name, X_OK, AT_EACCESS) == 0){
+            return i;
+        }
+    }
+
+    return cache->dir_count;
+}
+
+/**
+ * Join a directory and a name, for the posix_spawn backend and for listing the cache.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param dir the directory.
+ * @param name the command name.
+ * @return the file, free it with dc_free.
+ */
+static char *join_path(const struct dc_posix_env *env, struct dc_error *err, const char *dir, const char *name){
+    size_t dir_length = dc_strlen(env, dir);
+    size_t name_length = dc_strlen(env, name);
+    char *path;
+
+    path = dc_malloc(env, err, dir_length + 1 + name_length + 1);
+
+    if(dc_error_has_no_error(err)){
+        dc_memcpy(env, path, dir, dir_length);
+        path[dir_length] = '/';
+        dc_memcpy(env, &path[dir_length + 1], name, name_length + 1);
+    }
+
+    return path;
+}
+
+/**
+ * Double the number of buckets, the cache still works if this fails.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param cache the cache.
+ */
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct path_cache *cache){
+    struct path_cache_entry **buckets;
+    size_t bucket_count = cache->bucket_count * 2;
+
+    buckets = dc_calloc(env, err, bucket_count, sizeof(struct path_cache_entry *));
+
+    if(dc_error_has_error(err)){
+        dc_error_reset(err);
+        return;
+    }
+
+    for(size_t i = 0; i < cache->bucket_count; i++){
+        while(cache->buckets[i] != NULL){
+            struct path_cache_entry *entry = cache->buckets[i];
+            size_t bucket = hash_name(entry->name) & (bucket_count - 1);
+
+            cache->buckets[i] = entry->next;
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+        }
+    }
+
+    dc_free(env, cache->buckets, cache->bucket_count * sizeof(struct path_cache_entry *));
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+}
@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include <dc_posix/dc_fcntl.h>
+#include <dc_posix/dc_stdio.h>
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <dc_posix/dc_unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "arena.h"
+#include "builtins.h"
+#include "command.h"
+#include "execute.h"
+#include "jobs.h"
+#include "path_cache.h"
+#include "pipeline.h"
+
+static pid_t start_program(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                           struct command *command, const int pipe_fds[3]);
+static pid_t start_builtin(const struct dc_posix_env *env, struct dc_error *err, const struct builtin *builtin,
+                           struct command *command, struct state *state, const int pipe_fds[3], int next_input);
+static void close_fd(const struct dc_posix_env *env, struct dc_error *err, int *fd);
+static void add_job(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                    const struct command *commands, size_t count, const pid_t *pids);
+static char *job_text(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                      const struct command *commands, size_t count);
+
+/**
+ * Run the commands as a pipeline and set state->exit_code to the exit code of the last command,
+ * or of the last command that failed if state->settings.pipefail is set.
+ *
+ * Every stage is started before any is waited for, each connected to the next by a pipe2
+ * (O_CLOEXEC) pipe, and then they are all reaped. A command without a / is resolved through
+ * state->path_cache, one that is not found prints an error and exits 127 without a child. A command
+ * that already has an exit_code failed to parse (see parse_command) and is not started.
+ * A builtin that is the only command runs in the shell. In a longer pipeline a builtin runs in a
+ * forked child, like a subshell, except the last stage if it is BUILTIN_PIPELINE, which runs in
+ * the shell once the other stages have started. A BUILTIN_PARENT builtin is never forked, the
+ * change it makes would be lost with the child, it prints an error and exits 1 instead.
+ *
+ * In the background the stages are added to state->jobs instead of being waited for, and the
+ * exit_code is 0. Every builtin runs in a child, so a BUILTIN_PARENT one is refused, the first
+ * stage reads /dev/null unless it redirects stdin, and the pipeline waits for a job to finish first
+ * if state->jobs is at its limit.
+ *
+ * @param env the posix environment.
+ * @param err the error object, only set for errors that should stop the shell.
+ * @param state the shell.
+ * @param commands the parsed commands, part of state->command.
+ * @param count the number of commands.
+ * @param background start the pipeline as a job.
+ * @return true if a BUILTIN_EXIT builtin ran in the shell.
+ */
+bool pipeline_run(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                  struct command *commands, size_t count, bool background){
+    pid_t *pids;
+    int input;
+    bool exit_shell;
+
+    pids = arena_calloc(env, err, state->arena, count, sizeof(pid_t));
+    input = -1;
+
+    if(background){
+        job_table_wait_for_slot(env, err, state->jobs);
+
+        // without job control a job does not read the terminal of the shell, a < of the first stage still wins
+        if(dc_error_has_no_error(err)){
+            input = dc_open(env, err, "/dev/null", O_RDONLY | O_CLOEXEC, 0);
+        }
+    }
+
+    if(dc_error_has_error(err)){
+        return false;
+    }
+
+    exit_shell = false;
+
+    for(size_t i = 0; i < count && dc_error_has_no_error(err); i++){
+        const struct builtin *builtin;
+        int pipe_fds[3];
+        int next[2] = {-1, -1};
+
+        pids[i] = -1;
+
+        if(i + 1 < count && pipe2(next, O_CLOEXEC) == -1){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+            break;
+        }
+
+        pipe_fds[0] = input;
+        pipe_fds[1] = next[1];
+        pipe_fds[2] = -1;
+        builtin = builtin_find(env, commands[i].command);
+
+        if(commands[i].exit_code != 0){
+            // parse_command found it cannot run and said why, the next stage reads nothing from it
+        } else if(builtin != NULL && !background &&
+                  (count == 1 || (i + 1 == count && (builtin->flags & BUILTIN_PIPELINE) != 0))){
+            // it never reads stdin, so the stage before gets EPIPE instead of a full pipe
+            close_fd(env, err, &input);
+            builtin_run(env, err, builtin, &commands[i], state);
+            exit_shell = count == 1 && (builtin->flags & BUILTIN_EXIT) != 0;
+        } else if(builtin != NULL && (builtin->flags & BUILTIN_PARENT) != 0){
+            // a child would only change its own copy of the shell
+            fprintf(state->stderr, "%s: cannot run in a pipeline or in the background\n", commands[i].command);
+            commands[i].exit_code = 1;
+        } else if(builtin != NULL){
+            pids[i] = start_builtin(env, err, builtin, &commands[i], state, pipe_fds, next[0]);
+        } else{
+            pids[i] = start_program(env, err, state, &commands[i], pipe_fds);
+        }
+
+        // the child has its own copies, the next stage reads what this one writes
+        close_fd(env, err, &input);
+        close_fd(env, err, &next[1]);
+        input = next[0];
+    }
+
+    close_fd(env, err, &input);
+
+    // if a stage could not be started the ones that were are reaped as if it was not a job
+    if(background && dc_error_has_no_error(err)){
+        add_job(env, err, state, commands, count, pids);
+        state->exit_code = 0;
+        return false;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        if(pids[i] > 0){
+            execute_wait(env, err, &commands[i], pids[i]);
+        }
+    }
+
+    state->exit_code = commands[count - 1].exit_code;
+
+    if(state->settings.pipefail){
+        for(size_t i = count; i > 0; i--){
+            if(commands[i - 1].exit_code != 0){
+                state->exit_code = commands[i - 1].exit_code;
+                break;
+            }
+        }
+    }
+
+    return exit_shell && dc_error_has_no_error(err);
+}
+
+/**
+ * Resolve a program through the path cache and start it.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell.
+ * @param command the command to start.
+ * @param pipe_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ * @return the child, or -1 if it was not started and command->exit_code is set.
+ */
+static pid_t start_program(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                           struct command *command, const int pipe_fds[3]){
+    if(dc_strchr(env, command->command, '/') == NULL){
+        command->program = path_cache_lookup(env, err, state->path_cache, state->path, command->command);
+
+        if(dc_error_has_error(err)){
+            return -1;
+        }
+
+        if(command->program == NULL){
+            // no directory has it, there is nothing for a child to exec
+            fprintf(state->stderr, "%s: command not found\n", command->command);
+            command->exit_code = 127;
+            return -1;
+        }
+    }
+
+    // the program writes to the descriptors of the shell, what the shell has buffered goes first
+    fflush(NULL);
+
+    return execute_start(env, err, command, state->path, state->settings.spawn_backend, pipe_fds, state->stderr);
+}
+
+/**
+ * Fork a child that runs a builtin with its stdin and stdout on the pipes.
+ * The child only changes its own copy of the shell.
+ *
+ * @param env the posix environment.
+ * @param err the error object, set if the fork failed.
+ * @param builtin the builtin.
+ * @param command the command.
+ * @param state the shell.
+ * @param pipe_fds the stdin, stdout and stderr of the child, -1 to use the ones of the shell.
+ * @param next_input the read end of the pipe to the next stage, closed in the child, or -1.
+ * @return the child.
+ */
+static pid_t start_builtin(const struct dc_posix_env *env, struct dc_error *err, const struct builtin *builtin,
+                           struct command *command, struct state *state, const int pipe_fds[3], int next_input){
+    pid_t pid;
+
+    // a forked stage must not print what the shell has buffered a second time
+    fflush(NULL);
+    pid = dc_fork(env, err);
+
+    if(pid == 0){
+        // nothing execs, so O_CLOEXEC does not close the ends the builtin does not use
+        if(next_input != -1){
+            dc_close(env, err, next_input);
+        }
+
+        for(int i = 0; i < 3 && dc_error_has_no_error(err); i++){
+            if(pipe_fds[i] != -1){
+                dc_dup2(env, err, pipe_fds[i], i);
+                dc_close(env, err, pipe_fds[i]);
+            }
+        }
+
+        // the jobs are children of the shell, waiting for them here would never end
+        job_table_clear(env, state->jobs);
+
+        // the streams of the shell may not be on 0 and 1, the pipe is, and stdin may hold input of the shell
+        if(pipe_fds[STDIN_FILENO] != -1){
+            state->stdin = dc_fdopen(env, err, STDIN_FILENO, "r");
+            state->input = NULL;
+        }
+
+        if(pipe_fds[STDOUT_FILENO] != -1){
+            state->stdout = stdout;
+        }
+
+        if(dc_error_has_no_error(err)){
+            builtin_run(env, err, builtin, command, state);
+        }
+
+        dc_exit(env, dc_error_has_error(err) ? 1 : command->exit_code);
+    }
+
+    return pid;
+}
+
+/**
+ * Close a pipe end and set it to -1.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param fd the pipe end, nothing is done if it is -1.
+ */
+static void close_fd(const struct dc_posix_env *env, struct dc_error *err, int *fd){
+    if(*fd != -1){
+        dc_close(env, err, *fd);
+        *fd = -1;
+    }
+}
+
+/**
+ * Add the started stages to state->jobs.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell.
+ * @param commands the commands, the exit_code is used for a stage that was not started.
+ * @param count the number of commands.
+ * @param pids the child of each stage, -1 if it was not started.
+ */
+static void add_job(const struct dc_posix_env *env, struct dc_error *err, struct state *state,
+                    const struct command *commands, size_t count, const pid_t *pids){
+    int *exit_codes;
+    char *text;
+
+    exit_codes = arena_calloc(env, err, state->arena, count, sizeof(int));
+
+    if(dc_error_has_error(err)){
+        return;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        exit_codes[i] = commands[i].exit_code;
+    }
+
+    text = job_text(env, err, state->arena, commands, count);
+
+    if(dc_error_has_no_error(err)){
+        job_table_add(env, err, state->jobs, text, pids, exit_codes, count, state->settings.pipefail);
+    }
+}
+
+/**
+ * Join the words of the commands with spaces and the commands with " | ", for the jobs builtin.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param arena where to allocate the text.
+ * @param commands the commands.
+ * @param count the number of commands.
+ * @return the text.
+ */
+static char *job_text(const struct dc_posix_env *env, struct dc_error *err, struct arena *arena,
+                      const struct command *commands, size_t count){
+    size_t length;
+    char *text;
+    char *end;
+
+    length = 0;
+
+    for(size_t i = 0; i < count; i++){
+        length += dc_strlen(env, commands[i].command) + 3;
+
+        for(size_t j = 1; j < commands[i].argc; j++){
+            length += dc_strlen(env, commands[i].argv[j]) + 1;
+        }
+    }
+
+    text = arena_alloc(env, err, arena, length + 1);
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    end = text;
+
+    for(size_t i = 0; i < count; i++){
+        if(i > 0){
+            end = stpcpy(end, " | ");
+        }
+
+        end = stpcpy(end, commands[i].command);
+
+        for(size_t j = 1; j < commands[i].argc; j++){
+            *end++ = ' ';
+            end = stpcpy(end, commands[i].argv[j]);
+        }
+    }
+
+    *end = '\0';
+
+    return text;
+}
@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include "reactor.h"
+#include "util.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#endif
+
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor, int fd);
+static bool owned(const struct reactor *reactor);
+static bool event_for(const struct reactor *reactor, int fd, struct reactor_event *event);
+static size_t poll_wait(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                        struct reactor_event *events, size_t max, int timeout);
+
+/**
+ * Create a reactor that watches nothing.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the reactor, destroy it with reactor_destroy.
+ */
+struct reactor *reactor_create(const struct dc_posix_env *env, struct dc_error *err){
+    struct reactor *reactor;
+
+    reactor = dc_calloc(env, err, 1, sizeof(struct reactor));
+
+    if(dc_error_has_error(err)){
+        return NULL;
+    }
+
+    reactor->epoll_fd = -1;
+    reactor->signal_fd = -1;
+    reactor->owner = getpid();
+    sigemptyset(&reactor->signals);
+
+#ifdef __linux__
+    reactor->epoll_fd = move_shell_fd(epoll_create1(EPOLL_CLOEXEC));
+
+    if(reactor->epoll_fd == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        reactor_destroy(env, &reactor);
+        return NULL;
+    }
+#endif
+
+    return reactor;
+}
+
+/**
+ * Close the reactor, restore the signal mask and set it to NULL. The watched descriptors are not closed.
+ *
+ * @param env the posix environment.
+ * @param preactor the reactor to destroy, may point at NULL.
+ */
+void reactor_destroy(const struct dc_posix_env *env, struct reactor **preactor){
+    struct reactor *reactor = *preactor;
+
+    if(reactor != NULL){
+        if(reactor->epoll_fd != -1){
+            close(reactor->epoll_fd);
+        }
+
+        if(reactor->signal_fd != -1){
+            close(reactor->signal_fd);
+            sigprocmask(SIG_SETMASK, &reactor->old_mask, NULL);
+        }
+
+        if(reactor->handlers != NULL){
+            dc_free(env, reactor->handlers, reactor->handler_count * sizeof(struct reactor_handler));
+        }
+
+        dc_free(env, reactor, sizeof(struct reactor));
+        *preactor = NULL;
+    }
+}
+
+/**
+ * Watch a descriptor until it is removed.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ * @param source what the descriptor is.
+ * @param pid the child of a pidfd, -1 for anything else.
+ */
+void reactor_add(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor, int fd,
+                 enum reactor_source source, pid_t pid){
+    if(!owned(reactor)){
+        return;
+    }
+
+    if((size_t)fd >= reactor->handler_count){
+        grow(env, err, reactor, fd);
+
+        if(dc_error_has_error(err)){
+            return;
+        }
+    }
+
+#ifdef __linux__
+    if(reactor->epoll_fd != -1){
+        struct epoll_event event;
+
+        dc_memset(env, &event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+            return;
+        }
+    }
+#endif
+
+    reactor->handlers[fd].source = source;
+    reactor->handlers[fd].pid = pid;
+    reactor->watched++;
+}
+
+/**
+ * Stop watching a descriptor, before it is closed. Nothing is done if it is not watched.
+ *
+ * @param env the posix environment.
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ */
+void reactor_remove(const struct dc_posix_env *env, struct reactor *reactor, int fd){
+    (void)env;
+
+    if(!owned(reactor) || fd < 0 || (size_t)fd >= reactor->handler_count ||
+       reactor->handlers[fd].source == REACTOR_NONE){
+        return;
+    }
+
+#ifdef __linux__
+    if(reactor->epoll_fd != -1){
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif
+
+    reactor->handlers[fd].source = REACTOR_NONE;
+    reactor->handlers[fd].pid = -1;
+    reactor->watched--;
+}
+
+/**
+ * Check if a descriptor is watched.
+ *
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ * @return true if the descriptor is watched.
+ */
+bool reactor_watches(const struct reactor *reactor, int fd){
+    return fd >= 0 && (size_t)fd < reactor->handler_count && reactor->handlers[fd].source != REACTOR_NONE;
+}
+
+/**
+ * Block a signal and watch for it, through a signalfd, where there is one. Without a signalfd
+ * the signal keeps what it does now.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param reactor the reactor.
+ * @param signal_number the signal.
+ */
+void reactor_watch_signal(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                          int signal_number){
+#ifdef __linux__
+    sigset_t watched;
+    sigset_t old_mask;
+    int fd;
+
+    if(!owned(reactor)){
+        return;
+    }
+
+    sigemptyset(&watched);
+    sigaddset(&watched, signal_number);
+
+    if(sigprocmask(SIG_BLOCK, &watched, &old_mask) == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        return;
+    }
+
+    if(reactor->signal_fd == -1){
+        reactor->old_mask = old_mask;
+    }
+
+    sigaddset(&reactor->signals, signal_number);
+
+    // an existing signalfd takes the new mask in place
+    fd = signalfd(reactor->signal_fd, &reactor->signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if(fd == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+        return;
+    }
+
+    if(reactor->signal_fd == -1){
+        reactor->signal_fd = move_shell_fd(fd);
+        reactor_add(env, err, reactor, reactor->signal_fd, REACTOR_SIGNAL, -1);
+    }
+#else
+    (void)env;
+    (void)err;
+    (void)reactor;
+    (void)signal_number;
+#endif
+}
+
+/**
+ * Throw away the watched signals that are pending, they were for a child in the foreground.
+ *
+ * @param reactor the reactor.
+ */
+void reactor_drain_signals(const struct reactor *reactor){
+#ifdef __linux__
+    struct signalfd_siginfo info;
+
+    if(reactor->signal_fd != -1){
+        while(read(reactor->signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)){
+        }
+    }
+#else
+    (void)reactor;
+#endif
+}
+
+/**
+ * Wait for watched descriptors to be ready. A signal is read from the signalfd, so each
+ * REACTOR_SIGNAL event is a signal that was delivered, the other descriptors are left to the caller.
+ *
+ * @param env the posix environment.
+ * @param err the error object, EINTR is not an error.
+ * @param reactor the reactor.
+ * @param events where to put the events.
+ * @param max the room in events.
+ * @param timeout the milliseconds to wait, -1 to wait until there is an event.
+ * @return the number of events, 0 if the wait timed out or was interrupted.
+ */
+size_t reactor_wait(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                    struct reactor_event *events, size_t max, int timeout){
+#ifdef __linux__
+    struct epoll_event ready[REACTOR_MAX_EVENTS];
+    size_t count;
+    int n;
+
+    if(reactor->epoll_fd == -1){
+        return poll_wait(env, err, reactor, events, max, timeout);
+    }
+
+    if(max > REACTOR_MAX_EVENTS){
+        max = REACTOR_MAX_EVENTS;
+    }
+
+    n = epoll_wait(reactor->epoll_fd, ready, (int)max, timeout);
+
+    if(n == -1){
+        if(errno != EINTR){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+        }
+
+        return 0;
+    }
+
+    count = 0;
+
+    for(int i = 0; i < n; i++){
+        if(event_for(reactor, ready[i].data.fd, &events[count])){
+            count++;
+        }
+    }
+
+    return count;
+#else
+    return poll_wait(env, err, reactor, events, max, timeout);
+#endif
+}
+
+/**
+ * Make room for the handler of a descriptor, the new handlers watch nothing.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ */
+static void grow(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor, int fd){
+    struct reactor_handler *handlers;
+    size_t count;
+
+    count = reactor->handler_count == 0 ? 16 : reactor->handler_count;
+
+    while(count <= (size_t)fd){
+        count *= 2;
+    }
+
+    handlers = dc_realloc(env, err, reactor->handlers, count * sizeof(struct reactor_handler));
+
+    if(dc_error_has_error(err)){
+        return;
+    }
+
+    for(size_t i = reactor->handler_count; i < count; i++){
+        handlers[i].source = REACTOR_NONE;
+        handlers[i].pid = -1;
+    }
+
+    reactor->handlers = handlers;
+    reactor->handler_count = count;
+}
+
+/**
+ * Check that the reactor belongs to this process, a forked child must not change the epoll instance.
+ *
+ * @param reactor the reactor.
+ * @return true if this process created the reactor.
+ */
+static bool owned(const struct reactor *reactor){
+    return reactor->owner == getpid();
+}
+
+/**
+ * Fill in the event for a ready descriptor, reading the signal of the signalfd.
+ *
+ * @param reactor the reactor.
+ * @param fd the descriptor.
+ * @param event the event to fill in.
+ * @return false if there is no event, the descriptor was removed or the signal was already read.
+ */
+static bool event_for(const struct reactor *reactor, int fd, struct reactor_event *event){
+    const struct reactor_handler *handler;
+
+    if(fd < 0 || (size_t)fd >= reactor->handler_count || reactor->handlers[fd].source == REACTOR_NONE){
+        return false;
+    }
+
+    handler = &reactor->handlers[fd];
+    event->source = handler->source;
+    event->fd = fd;
+    event->pid = handler->pid;
+    event->signal = 0;
+
+#ifdef __linux__
+    if(handler->source == REACTOR_SIGNAL){
+        struct signalfd_siginfo info;
+
+        if(read(fd, &info, sizeof(info)) != (ssize_t)sizeof(info)){
+            return false;
+        }
+
+        event->signal = (int)info.ssi_signo;
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * Wait for the watched descriptors with poll, where there is no epoll.
+ *
+ * @param env the posix environment.
+ * @param err the error object, EINTR is not an error.
+ * @param reactor the reactor.
+ * @param events where to put the events.
+ * @param max the room in events.
+ * @param timeout the milliseconds to wait, -1 to wait until there is an event.
+ * @return the number of events.
+ */
+static size_t poll_wait(const struct dc_posix_env *env, struct dc_error *err, struct reactor *reactor,
+                        struct reactor_event *events, size_t max, int timeout){
+    struct pollfd *fds;
+    size_t nfds;
+    size_t count;
+
+    if(reactor->watched == 0){
+        return 0;
+    }
+
+    fds = dc_malloc(env, err, reactor->watched * sizeof(struct pollfd));
+
+    if(dc_error_has_error(err)){
+        return 0;
+    }
+
+    nfds = 0;
+
+    for(size_t fd = 0; fd < reactor->handler_count; fd++){
+        if(reactor->handlers[fd].source != REACTOR_NONE){
+            fds[nfds].fd = (int)fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            nfds++;
+        }
+    }
+
+    count = 0;
+
+    if(poll(fds, nfds, timeout) == -1){
+        if(errno != EINTR){
+            DC_ERROR_RAISE_ERRNO(err, errno);
+        }
+    } else{
+        for(size_t i = 0; i < nfds && count < max; i++){
+            if(fds[i].revents != 0 && event_for(reactor, fds[i].fd, &events[count])){
+                count++;
+            }
+        }
+    }
+
+    dc_free(env, fds, reactor->watched * sizeof(struct pollfd));
+
+    return count;
+}
@@ -1,21 +1,25 @@
+#include "input.h"
 #include "shell.h"
 #include "shell_impl.h"
 #include "state.h"
 #include "shell_impl.h"
 #include <dc_posix/dc_stdlib.h>
+#include <dc_posix/dc_string.h>
 
 /**
  * Run the shell FSM.
  *
  * @param env the posix environment.
  * @param error the error object
- * @param in the keyboard (stdin) file
+ * @param settings how the shell was started, NULL for the defaults
+ * @param in the keyboard (stdin) file, the commands are read from settings->script instead if it is set
  * @param out the keyboard (stdout) file
  * @param err the keyboard (stderr) file
  *
- * @return the exit code from the shell.
+ * @return the exit code from the shell, 127 if the script could not be opened.
  */
-int run_shell(const struct dc_posix_env *env, struct dc_error *error, FILE *in, FILE *out, FILE *err){
+int run_shell(const struct dc_posix_env *env, struct dc_error *error, const struct shell_settings *settings,
+              FILE *in, FILE *out, FILE *err){
     int ret_val = 0;
 
     static struct dc_fsm_transition transitions[] = {
@@ -24,7 +28,15 @@ int run_shell(const struct dc_posix_env *env, struct dc_error *error, FILE *in,
             {INIT_STATE, ERROR, handle_error},
             {READ_COMMANDS, RESET_STATE, reset_state},
             {READ_COMMANDS, SEPARATE_COMMANDS, separate_commands},
+            {READ_COMMANDS, WAIT_FOR_INPUT, wait_for_input},
+            {READ_COMMANDS, EXIT, do_exit},
             {READ_COMMANDS, ERROR, handle_error},
+            {WAIT_FOR_INPUT, WAIT_FOR_INPUT, wait_for_input},
+            {WAIT_FOR_INPUT, READ_COMMANDS, read_commands},
+            {WAIT_FOR_INPUT, RESET_STATE, reset_state},
+            {WAIT_FOR_INPUT, SEPARATE_COMMANDS, separate_commands},
+            {WAIT_FOR_INPUT, EXIT, do_exit},
+            {WAIT_FOR_INPUT, ERROR, handle_error},
             {SEPARATE_COMMANDS, PARSE_COMMANDS, parse_commands},
             {SEPARATE_COMMANDS, ERROR, handle_error},
             {PARSE_COMMANDS, EXECUTE_COMMANDS, execute_commands},
@@ -44,6 +56,24 @@ int run_shell(const struct dc_posix_env *env, struct dc_error *error, FILE *in,
 
     struct state state;
 
+    dc_memset(env, &state, 0, sizeof(state));
+
+    if(settings != NULL){
+        state.settings = *settings;
+    }
+
+    // mapped before the FSM starts, so a missing script is an error about the file rather than the shell
+    if(state.settings.script != NULL){
+        state.script = script_open(env, error, state.settings.script);
+
+        if(dc_error_has_error(error)){
+            fprintf(err, "%s: %s\n", state.settings.script, error->message);
+            dc_error_reset(error);
+
+            return 127;
+        }
+    }
+
     info = dc_fsm_info_create(env, error, "dc_shell");
 
     if(dc_error_has_error(error)){
@@ -61,5 +91,7 @@ int run_shell(const struct dc_posix_env *env, struct dc_error *error, FILE *in,
         dc_fsm_info_destroy(env,&info);
     }
 
+    script_close(env, &state.script);
+
     return ret_val;
 }
@@ -1,8 +1,8 @@
 #include <dc_posix/dc_unistd.h>
 #include <dc_posix/dc_stdlib.h>
-#include <dc_posix/dc_regex.h>
 #include <dc_posix/dc_string.h>
 #include <dc_error/error.h>
+#include "arena.h"
 #include "shell_impl.h"
 #include "state.h"
 #include "util.h"
@@ -10,15 +10,37 @@
 #include "builtins.h"
 #include "execute.h"
 #include "command.h"
+#include "path_cache.h"
+#include "jobs.h"
+#include "lexer.h"
+#include "pipeline.h"
+#include "reactor.h"
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+static void update_path(const struct dc_posix_env *env, struct dc_error *err, struct state *s);
+static enum command_separator token_separator(enum token_type type);
+static size_t pipeline_length(const struct state *s, size_t first);
+static void watch_input(const struct dc_posix_env *env, struct dc_error *err, struct state *s);
+static bool watches_input(const struct state *s);
+static int read_line(const struct dc_posix_env *env, struct dc_error *err, struct state *s);
+static int read_script_line(const struct dc_posix_env *env, struct dc_error *err, struct state *s);
+static void read_here_documents(const struct dc_posix_env *env, struct dc_error *err, struct state *s,
+                                struct command *command);
 
 /**
  * Set up the initial state:
- *  - in_redirect_regex  "[ \t\f\v]<.*"
- *  - out_redirect_regex "[ \t\f\v][1^2]?>[>]?.*"
- *  - err_redirect_regex "[ \t\f\v]2>[>]?.*"
  *  - path the PATH environ var separated into directories
  *  - prompt the PS1 environ var or "$" if PS1 not set
  *  - max_line_length the value of _SC_ARG_MAX (see sysconf)
+ *  - arena the per-line allocator, its first block is settings.arena_block_size bytes
+ *  - path_cache an empty cache of the files commands are found in
+ *  - input a line_reader over the descriptor of stdin, if it has one and there is no script
+ *  - reactor an epoll instance over stdin (if it has a descriptor that is not a file and there is no script) and SIGINT (if it is a terminal)
+ *  - jobs an empty job table of settings.max_jobs watched by the reactor, SIGCHLD is blocked until destroy_state
+ *  - fds no descriptors redirected by exec
+ *  - cwd NULL, the working directory is read for the first prompt
  *
  * @param env the posix environment.
  * @param err the error object
@@ -29,77 +51,83 @@
 int init_state(const struct dc_posix_env *env, struct dc_error *err, void *arg){
     struct state *s;
     s = (struct state*) arg;
-    regex_t regex;
     char **list;
     char *path;
     char *prompt;
-    int val = 0;
 
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v]<.*", REG_EXTENDED);
-    s->in_redirect_regex = &regex;
-    error_r(env, err, val, regex);
+    s->fatal_error = false;
+    s->arena = NULL;
+    s->path_cache = NULL;
+    s->jobs = NULL;
+    s->reactor = NULL;
+    s->input = NULL;
+    s->fds = NULL;
+    s->fd_count = 0;
+    s->cwd = NULL;
+    s->cwd_fd = -1;
 
+    path = get_path(env, err);
+    list = parse_path(env, err, path == NULL ? "" : path);
+    dc_free(env, path, path == NULL ? 0 : dc_strlen(env, path) + 1);
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
+    prompt = get_prompt(env, err);
+    s->arena = arena_create(env, err, s->settings.arena_block_size);
 
+    if(dc_error_has_no_error(err)){
+        s->path_cache = path_cache_create(env, err);
+    }
 
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v][1^2]?>[>]?.*", REG_EXTENDED);
-    s->out_redirect_regex = &regex;
-    error_r(env, err, val, regex);
+    if(dc_error_has_no_error(err)){
+        path_cache_validate(env, err, s->path_cache, dc_getenv(env, "PATH"), list);
+    }
 
-    if(dc_error_has_error(err)){
-        s->fatal_error = true;
-        return ERROR;
+    // a stream without a descriptor (fmemopen) is read with stdio
+    if(dc_error_has_no_error(err) && s->script == NULL && s->stdin != NULL && fileno(s->stdin) != -1){
+        s->input = line_reader_create(env, err, fileno(s->stdin), LINE_READER_CAPACITY);
     }
 
-    val = dc_regcomp(env, err, &regex, "[ \t\f\v]2>[>]?.*", REG_EXTENDED);
-    s->err_redirect_regex = &regex;
-    error_r(env, err, val, regex);
+    if(dc_error_has_no_error(err)){
+        s->reactor = reactor_create(env, err);
+    }
 
-    if(dc_error_has_error(err)){
-        s->fatal_error = true;
-        return ERROR;
+    // the commands of a script are never waited for
+    if(dc_error_has_no_error(err) && s->script == NULL){
+        watch_input(env, err, s);
     }
 
-    path = get_path(env, err);
-    list = parse_path(env, err, path);
+    // after the reactor, destroy_state restores the signal masks the other way round
+    if(dc_error_has_no_error(err)){
+        s->jobs = job_table_create(env, err, s->settings.max_jobs);
+    }
+
+    if(dc_error_has_no_error(err)){
+        job_table_watch(s->jobs, s->reactor);
+    }
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
-    prompt = get_prompt(env, err);
 
     s->path = list;
     s->prompt = prompt;
     s->max_line_length = (size_t) dc_sysconf(env, err, _SC_ARG_MAX);
     s->current_line = NULL;
     s->command = NULL;
+    s->command_count = 0;
     s->current_line_length = 0;
 
 
     return READ_COMMANDS;
 }
 
-void error_r(const struct dc_posix_env *env, struct dc_error *err, int a, regex_t reg){
-    if(a != 0){
-        char *message;
-        size_t to;
-
-        to = dc_regerror(env, a, &reg, NULL, 0);
-        message = dc_malloc(env, err, to + 1);
-        dc_regerror(env, a, &reg, message, to + 1);
-        fprintf(stderr, "%s", message);
-        dc_free(env, err, dc_strlen(env, message) + 1);
-    }
-}
-
-
 /**
  * Free any dynamically allocated memory in the state and sets variables to NULL, 0 or false.
+ * The descriptors exec opened above stderr are closed.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -111,13 +139,26 @@ int destroy_state(const struct dc_posix_env *env, struct dc_error *err, void *ar
     s = (struct state*) arg;
 
     do_reset_state(env, err, s);
+    arena_destroy(env, &s->arena);
+    path_cache_destroy(env, &s->path_cache);
+    job_table_destroy(env, &s->jobs);
+    reactor_destroy(env, &s->reactor);
+    line_reader_destroy(env, &s->input);
+
+    for(size_t i = 0; i < s->fd_count; i++){
+        if(s->fds[i] > STDERR_FILENO){
+            close(s->fds[i]);
+        }
+    }
+
+    dc_free(env, s->fds, s->fd_count * sizeof(int));
+    s->fds = NULL;
+    s->fd_count = 0;
+    forget_current_directory(env, s);
 
     s->prompt = NULL;
-    s->path = NULL;
+    free_path(env, &s->path);
     s->max_line_length = 0;
-    s->in_redirect_regex = NULL;
-    s->out_redirect_regex = NULL;
-    s->err_redirect_regex = NULL;
     s->current_line = NULL;
 
     destroy_command(env, s->command);
@@ -144,34 +185,162 @@ int reset_state(const struct dc_posix_env *env, struct dc_error *err, void *arg)
 
 /**
  * Prompt the user and read the command line (see read_command_line).
- * Sets the state->current_line and current_line_length.
+ * Sets the state->current_line, allocated from state->arena, and current_line_length.
+ * If state->reactor watches the input and no line is buffered the line is read by wait_for_input.
+ * With state->settings.batch there is no prompt, and no working directory to show in it.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param arg the current struct state
- * @return SEPARATE_COMMANDS
+ * @return SEPARATE_COMMANDS, RESET_STATE for an empty line, EXIT at the end of the input, WAIT_FOR_INPUT or ERROR
  */
 int read_commands(const struct dc_posix_env *env, struct dc_error *err, void *arg){
     struct state *s;
+    const char *path;
+
     s = (struct state *)arg;
-    char *path;
-    char *input;
-    size_t l;
-    size_t length = 0;
-    path = dc_getcwd(env, err, NULL, 0);
+
+    // jobs that finished while the last line ran are reaped before the shell blocks on the next
+    job_table_reap(env, err, s->jobs);
+
+    // a ^C while a command ran was for the command
+    if(s->reactor != NULL){
+        reactor_drain_signals(s->reactor);
+    }
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
 
-    fprintf(s->stdout, "[%s] %s", path, s->prompt);
+    // a script has no one to prompt, so the working directory is not needed either
+    if(!s->settings.batch){
+        path = current_directory(env, err, s);
+
+        if(dc_error_has_error(err)){
+            s->fatal_error = true;
+            return ERROR;
+        }
+
+        fprintf(s->stdout, "[%s] %s", path, s->prompt);
+    }
+
+    if(s->script != NULL){
+        return read_script_line(env, err, s);
+    }
+
+    if(watches_input(s) && !line_reader_has_line(s->input)){
+        // getline would have flushed the prompt before blocking
+        if(!s->settings.batch){
+            fflush(s->stdout);
+        }
+
+        return WAIT_FOR_INPUT;
+    }
+
+    return read_line(env, err, s);
+}
+
+/**
+ * Wait on state->reactor for the input, the jobs and SIGINT. A job that exits is reaped at once,
+ * and the shell goes on waiting. SIGINT drops the line being typed and prompts again. Input that
+ * is ready is read as in read_commands.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param arg the current struct state
+ * @return SEPARATE_COMMANDS, RESET_STATE, EXIT, READ_COMMANDS after SIGINT, WAIT_FOR_INPUT or ERROR
+ */
+int wait_for_input(const struct dc_posix_env *env, struct dc_error *err, void *arg){
+    struct state *s;
+    struct reactor_event events[REACTOR_MAX_EVENTS];
+    size_t count;
+    bool ready;
+    bool interrupted;
+    s = (struct state *)arg;
+
+    ready = false;
+    interrupted = false;
+    count = reactor_wait(env, err, s->reactor, events, REACTOR_MAX_EVENTS, -1);
+
+    for(size_t i = 0; i < count && dc_error_has_no_error(err); i++){
+        switch(events[i].source){
+            case REACTOR_INPUT:
+                ready = true;
+                break;
+            case REACTOR_CHILD:
+                job_table_reap_pid(env, err, s->jobs, events[i].pid);
+                break;
+            case REACTOR_SIGNAL:
+                interrupted = interrupted || events[i].signal == SIGINT;
+                break;
+            case REACTOR_NONE:
+            default:
+                break;
+        }
+    }
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
 
+    if(interrupted){
+        fputc('\n', s->stdout);
+
+        return READ_COMMANDS;
+    }
+
+    if(ready){
+        return read_line(env, err, s);
+    }
+
+    return WAIT_FOR_INPUT;
+}
+
+/**
+ * Read the line that was prompted for into state->current_line and current_line_length. The line
+ * is a view into the buffer of state->input, copied once into state->arena, a stream without a
+ * descriptor is read with read_command_line.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param s the state
+ * @return SEPARATE_COMMANDS, RESET_STATE for an empty line, EXIT at the end of the input or ERROR
+ */
+static int read_line(const struct dc_posix_env *env, struct dc_error *err, struct state *s){
+    char *input;
+    size_t l;
+    size_t length = 0;
+
+    if(s->input != NULL){
+        const char *line = line_reader_read_line(env, err, s->input, &length);
+
+        if(dc_error_has_error(err)){
+            s->fatal_error = true;
+            return ERROR;
+        }
+
+        if(line == NULL){
+            return EXIT;
+        }
+
+        s->current_line = arena_strndup(env, err, s->arena, line, length);
+
+        if(dc_error_has_error(err)){
+            s->fatal_error = true;
+            return ERROR;
+        }
+
+        if(length == 0){
+            return RESET_STATE;
+        }
+
+        s->current_line_length = length;
+
+        return SEPARATE_COMMANDS;
+    }
+
     input = read_command_line(env, err, s->stdin, &length);
 
     if(dc_error_has_error(err)){
@@ -179,33 +348,74 @@ int read_commands(const struct dc_posix_env *env, struct dc_error *err, void *ar
         return ERROR;
     }
 
-    s->current_line = dc_strdup(env, err, input);
+    l = length;
+
+    // the end of the input ends the shell, an empty line would only ask for the next one forever
+    if(l == 0 && feof(s->stdin)){
+        dc_free(env, input, 1);
+
+        return EXIT;
+    }
+
+    s->current_line = arena_strndup(env, err, s->arena, input, l);
+    dc_free(env, input, l + 1);
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
-        dc_free(env, input, dc_strlen(env, input));
         return ERROR;
     }
 
-    l = dc_strlen(env, input);
-
     if(l == 0){
         return RESET_STATE;
     }
 
     s->current_line_length = l;
 
+    return SEPARATE_COMMANDS;
+}
+
+/**
+ * Take the next line of state->script into state->current_line and current_line_length. The
+ * line is a view into the mapped file, copied once into state->arena, it is not read through stdio.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param s the state
+ * @return SEPARATE_COMMANDS, RESET_STATE for an empty line, EXIT at the end of the script or ERROR
+ */
+static int read_script_line(const struct dc_posix_env *env, struct dc_error *err, struct state *s){
+    const char *line;
+    size_t length;
+
+    line = script_read_line(s->script, &length);
+
+    if(line == NULL){
+        return EXIT;
+    }
+
+    s->current_line = arena_strndup(env, err, s->arena, line, length);
+
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
 
+    if(length == 0){
+        return RESET_STATE;
+    }
+
+    s->current_line_length = length;
+
     return SEPARATE_COMMANDS;
 }
 
 /**
- * Separate the commands. In the current implementation there is only one command.
- * Sets the state->command.
+ * Separate the commands of the line, joined by | ; & && and ||. The line is copied once into
+ * state->arena and each operator outside of quotes is overwritten with NULs, so every command
+ * gets its own piece of the copy to parse in place and remembers the operator after it as its
+ * separator. A ; or & at the end of the line is allowed. Sets state->command to the commands and
+ * state->command_count to how many there are. The state->current_line is left intact for error
+ * messages.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -214,28 +424,80 @@ int read_commands(const struct dc_posix_env *env, struct dc_error *err, void *ar
  */
 int separate_commands(const struct dc_posix_env *env, struct dc_error *err, void *arg){
     struct state *s;
+    struct lexer lexer;
+    struct token token;
+    enum token_type type;
+    enum command_separator separator;
+    char *line;
+    size_t count;
     s = (struct state *) arg;
 
-    s->command = dc_calloc(env, err, 1, sizeof(*s->command));
+    line = arena_strndup(env, err, s->arena, s->current_line, s->current_line_length);
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
-    char *cl;
-    cl = s->current_line;
-    s->command->line = dc_strdup(env, err, cl);
+
+    count = 1;
+    separator = SEPARATOR_END;
+    lexer_init(&lexer, line, s->current_line_length);
+
+    // an unterminated quote stops the count, parse_command reports it
+    while((type = lexer_next(&lexer, &token)) != TOKEN_END && type != TOKEN_ERROR){
+        separator = token_separator(type);
+
+        if(separator != SEPARATOR_END){
+            count++;
+        }
+    }
+
+    // a ; or & at the end of the line does not start another command
+    if((separator == SEPARATOR_SEQUENCE || separator == SEPARATOR_BACKGROUND) && type == TOKEN_END){
+        count--;
+    }
+
+    s->command = arena_calloc(env, err, s->arena, count, sizeof(*s->command));
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return ERROR;
     }
 
+    s->command_count = count;
+    s->command[0].line = line;
+    count = 0;
+    lexer_init(&lexer, line, s->current_line_length);
+
+    while((type = lexer_next(&lexer, &token)) != TOKEN_END && type != TOKEN_ERROR){
+        separator = token_separator(type);
+
+        if(separator != SEPARATOR_END){
+            char *end;
+
+            // the lexer is past the operator, so it can end the command before it
+            end = &line[token.text - line];
+            dc_memset(env, end, '\0', token.length);
+            s->command[count].separator = separator;
+            count++;
+
+            if(count < s->command_count){
+                s->command[count].line = end + token.length;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < s->command_count; i++){
+        s->command[i].arena = s->arena;
+    }
+
     return PARSE_COMMANDS;
 }
 
 /**
- * Parse the commands (see parse_command)
+ * Parse each command of the pipeline (see parse_command), then read the bodies of its
+ * here-documents from state->stdin (or state->script), in the order they are on the line. A "> " is
+ * printed before each line of a body if state->stdin is a terminal.
  *
  * @param env the posix environment.
  * @param err the error object
@@ -246,53 +508,187 @@ int parse_commands(const struct dc_posix_env *env, struct dc_error *err, void *a
     struct state *s;
     s = (struct state *)arg;
 
-    parse_command(env, err, s, s->command);
+    for(size_t i = 0; i < s->command_count && dc_error_has_no_error(err); i++){
+        parse_command(env, err, s, &s->command[i]);
+    }
+
+    for(size_t i = 0; i < s->command_count && dc_error_has_no_error(err); i++){
+        read_here_documents(env, err, s, &s->command[i]);
+    }
 
     if(dc_error_has_error(err)){
-        s->fatal_error = true;
         return ERROR;
     }
 
     return EXECUTE_COMMANDS;
 }
 
+/**
+ * Replace the delimiter of each here-document of a command with the body read from state->stdin,
+ * or taken from state->script. The line was read already, so the body follows it on the stream and is read without the reactor.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param s the state.
+ * @param command the parsed command.
+ */
+static void read_here_documents(const struct dc_posix_env *env, struct dc_error *err, struct state *s,
+                                struct command *command){
+    for(size_t i = 0; i < command->redirection_count && dc_error_has_no_error(err); i++){
+        struct redirection *redirection = &command->redirections[i];
+        FILE *prompt;
+        char *body;
+        size_t length;
+
+        if(redirection->type != REDIRECT_HERE_DOC){
+            continue;
+        }
+
+        // the body of a script is already in memory, it is copied from the mapping once
+        if(s->script != NULL){
+            const char *text = script_read_here_document(env, s->script, redirection->target, &length);
+
+            redirection->target = arena_strndup(env, err, s->arena, text, length);
+            continue;
+        }
+
+        prompt = !s->settings.batch && isatty(fileno(s->stdin)) ? s->stdout : NULL;
+
+        if(s->input != NULL){
+            body = line_reader_read_here_document(env, err, s->input, redirection->target, prompt, &length);
+        } else{
+            body = read_here_document(env, err, s->stdin, redirection->target, prompt, &length);
+        }
+
+        if(dc_error_has_no_error(err)){
+            redirection->target = arena_strndup(env, err, s->arena, body, length);
+            dc_free(env, body, length + 1);
+        }
+
+        if(dc_error_has_error(err)){
+            s->fatal_error = true;
+        }
+    }
+}
+
 
 /**
  * Run the command (see execute).
- * If the command->command is cd run builtin_cd
+ * Run each pipeline of the line in order (see pipeline_run) and set state->exit_code.
+ * A pipeline after && only runs if the exit_code is 0, one after || only if it is not, so the
+ * whole line is run from one parse without going back to read_commands. A pipeline followed by &
+ * is started as a job and the next one runs without waiting for it.
+ * A change to PATH is picked up before the commands are looked up.
  *
  * @param env the posix environment.
  * @param err the error object
  * @param arg the current struct state
- * @return EXIT (if command->command is exit), RESET_STATE or EXECUTE_ERROR
+ * @return EXIT (if a builtin with BUILTIN_EXIT ran in the shell), RESET_STATE or EXECUTE_ERROR
  */
 int execute_commands(const struct dc_posix_env *env, struct dc_error *err, void *arg){
     struct state *s;
+    size_t first;
+    bool run;
     s = (struct state *) arg;
-    char *path = get_path(env, err);
-    char **list = parse_path(env, err, path);
 
-    if(dc_strcmp(env, s->command->command, "cd") == 0){
-        builtin_cd(env, err, s->command, s->stderr);
-    } else if (dc_strcmp(env, s->command->command, "exit") == 0){
-        return EXIT;
-    } else{
-        execute(env, err, s->command, list);
-        if(dc_error_has_error(err)){
-            s->fatal_error = true;
-            return EXIT;
-        }
-    }
+    update_path(env, err, s);
 
     if(dc_error_has_error(err)){
         s->fatal_error = true;
         return EXIT;
     }
 
+    first = 0;
+    run = true;
+
+    while(first < s->command_count){
+        enum command_separator separator;
+        size_t length;
+
+        length = pipeline_length(s, first);
+        separator = s->command[first + length - 1].separator;
+
+        if(run){
+            if(pipeline_run(env, err, s, &s->command[first], length, separator == SEPARATOR_BACKGROUND)){
+                return EXIT;
+            }
+
+            if(dc_error_has_error(err)){
+                s->fatal_error = true;
+                return EXIT;
+            }
+        }
+
+        // a skipped pipeline leaves the exit_code alone, so in a && b || c, c runs if a or b failed
+        if(separator == SEPARATOR_AND){
+            run = s->exit_code == 0;
+        } else if(separator == SEPARATOR_OR){
+            run = s->exit_code != 0;
+        } else{
+            run = true;
+        }
+
+        first += length;
+    }
+
     return RESET_STATE;
 }
 
 
+/**
+ * Convert an operator token to the separator it puts after a command.
+ *
+ * @param type the token.
+ * @return the separator, SEPARATOR_END if the token does not separate commands.
+ */
+static enum command_separator token_separator(enum token_type type){
+    switch(type){
+        case TOKEN_PIPE:
+            return SEPARATOR_PIPE;
+        case TOKEN_SEQUENCE:
+            return SEPARATOR_SEQUENCE;
+        case TOKEN_AND:
+            return SEPARATOR_AND;
+        case TOKEN_OR:
+            return SEPARATOR_OR;
+        case TOKEN_BACKGROUND:
+            return SEPARATOR_BACKGROUND;
+        case TOKEN_END:
+        case TOKEN_ERROR:
+        case TOKEN_WORD:
+        case TOKEN_REDIRECT_IN:
+        case TOKEN_REDIRECT_OUT:
+        case TOKEN_APPEND_OUT:
+        case TOKEN_REDIRECT_ERR:
+        case TOKEN_APPEND_ERR:
+        case TOKEN_DUP_IN:
+        case TOKEN_DUP_OUT:
+        case TOKEN_HERE_DOC:
+        case TOKEN_HERE_STRING:
+        default:
+            return SEPARATOR_END;
+    }
+}
+
+/**
+ * Count the commands of the pipeline that starts at state->command[first].
+ *
+ * @param s the state.
+ * @param first the first command of the pipeline.
+ * @return the number of commands joined by |.
+ */
+static size_t pipeline_length(const struct state *s, size_t first){
+    size_t length;
+
+    length = 1;
+
+    while(first + length < s->command_count && s->command[first + length - 1].separator == SEPARATOR_PIPE){
+        length++;
+    }
+
+    return length;
+}
+
 /**
  * Handle the exit command (see do_reset_state)
  *
@@ -337,3 +733,70 @@ int handle_error(const struct dc_posix_env *env, struct dc_error *err, void *arg
 
     return RESET_STATE;
 }
+
+/**
+ * Parse PATH again if it changed and let the path cache drop anything that may be stale.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param s the state with the path and path_cache.
+ */
+static void update_path(const struct dc_posix_env *env, struct dc_error *err, struct state *s){
+    const char *value = dc_getenv(env, "PATH");
+
+    if(path_cache_path_changed(env, s->path_cache, value)){
+        char **list = parse_path(env, err, value == NULL ? "" : value);
+
+        if(dc_error_has_error(err)){
+            return;
+        }
+
+        free_path(env, &s->path);
+        s->path = list;
+    }
+
+    path_cache_validate(env, err, s->path_cache, value, s->path);
+}
+
+/**
+ * Watch the descriptor of state->stdin in state->reactor, and SIGINT if it is a terminal, so ^C
+ * at the prompt drops the line instead of killing the shell. A stream without a descriptor is not
+ * watched, nor is a regular file (epoll refuses them), both are read without waiting.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param s the state
+ */
+static void watch_input(const struct dc_posix_env *env, struct dc_error *err, struct state *s){
+    int fd;
+
+    if(s->stdin == NULL){
+        return;
+    }
+
+    fd = fileno(s->stdin);
+
+    if(fd == -1){
+        return;
+    }
+
+    reactor_add(env, err, s->reactor, fd, REACTOR_INPUT, -1);
+
+    if(dc_error_is_errno(err, EPERM)){
+        dc_error_reset(err);
+    }
+
+    if(dc_error_has_no_error(err) && isatty(fd)){
+        reactor_watch_signal(env, err, s->reactor, SIGINT);
+    }
+}
+
+/**
+ * Check if the shell waits on state->reactor before it reads a line.
+ *
+ * @param s the state
+ * @return true if the descriptor of state->stdin is watched.
+ */
+static bool watches_input(const struct state *s){
+    return s->reactor != NULL && s->stdin != NULL && reactor_watches(s->reactor, fileno(s->stdin));
+}
@@ -1,7 +1,16 @@
+#define _GNU_SOURCE
 #include <dc_posix/dc_stdlib.h>
 #include <dc_posix/dc_string.h>
 #include <dc_posix/dc_stdio.h>
+#include <dc_posix/dc_unistd.h>
+#include <dc_posix/dc_fcntl.h>
 #include <bits/types/FILE.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "arena.h"
 #include "util.h"
 #include "command.h"
 
@@ -70,6 +79,27 @@ char **parse_path(const struct dc_posix_env *env, struct dc_error *err, const ch
     return list;
 }
 
+/**
+ * Free the directories made by parse_path and set them to NULL.
+ *
+ * @param env the posix environment.
+ * @param ppath the directories, may point at NULL.
+ */
+void free_path(const struct dc_posix_env *env, char ***ppath){
+    char **path = *ppath;
+
+    if(path != NULL){
+        size_t i;
+
+        for(i = 0; path[i] != NULL; i++){
+            dc_free(env, path[i], dc_strlen(env, path[i]) + 1);
+        }
+
+        dc_free(env, path, (i + 1) * sizeof(char *));
+        *ppath = NULL;
+    }
+}
+
 /**
  * Counts the number of elements to put in the path array.
  * @param str path string.
@@ -92,14 +122,24 @@ size_t count(const char *str, int  c){
 
 
 /**
- * Reset the state for the next read, freeing any dynamically allocated memory.
+ * Reset the state for the next read, releasing everything allocated for the line in one
+ * go by resetting the state->arena. With state->settings.verbose the bytes the line took from
+ * the arena and its high-water mark are printed to state->stderr first.
  *
  * @param env the posix environment.
  * @param err the error object
  */
 void do_reset_state(const struct dc_posix_env *env, struct dc_error *err, struct state *state){
 
-    dc_free(env, state->current_line, state->current_line_length);
+    if(state->arena != NULL){
+        if(state->settings.verbose && state->arena->allocated > 0){
+            fprintf(state->stderr, "arena: %zu bytes, high water mark %zu bytes\n", state->arena->allocated,
+                    state->arena->high_water_mark);
+        }
+
+        arena_reset(env, state->arena);
+    }
+
     state->current_line = NULL;
     state->current_line_length = 0;
 
@@ -107,11 +147,97 @@ void do_reset_state(const struct dc_posix_env *env, struct dc_error *err, struct
 
     dc_error_reset(err);
 
-    dc_free(env, state->command, sizeof(struct command));
     state->command = NULL;
+    state->command_count = 0;
 
 }
 
+/**
+ * Get the working directory from state->cwd. It is only read again, with getcwd, if "." is no
+ * longer the directory state->cwd_fd has open, so a prompt costs a stat instead of a getcwd and
+ * an allocation.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell, state->cwd is set if it was read again.
+ * @return state->cwd, NULL on error.
+ */
+const char *current_directory(const struct dc_posix_env *env, struct dc_error *err, struct state *state){
+    struct stat buf;
+
+    if(state->cwd != NULL && stat(".", &buf) == 0 && buf.st_dev == state->cwd_dev && buf.st_ino == state->cwd_ino){
+        return state->cwd;
+    }
+
+    update_current_directory(env, err, state);
+
+    return dc_error_has_no_error(err) ? state->cwd : NULL;
+}
+
+/**
+ * Read the working directory into state->cwd and open it as state->cwd_fd, releasing the old ones.
+ * Call it after a chdir.
+ *
+ * @param env the posix environment.
+ * @param err the error object
+ * @param state the shell, state->cwd is left as it was on error.
+ */
+void update_current_directory(const struct dc_posix_env *env, struct dc_error *err, struct state *state){
+    struct stat buf;
+    char *cwd;
+    int fd;
+
+    cwd = dc_getcwd(env, err, NULL, 0);
+
+    if(dc_error_has_error(err)){
+        return;
+    }
+
+#ifdef O_PATH
+    fd = move_shell_fd(open(".", O_PATH | O_DIRECTORY | O_CLOEXEC));
+#else
+    fd = move_shell_fd(open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+#endif
+
+    // without the descriptor the inode is still compared, it only might be reused
+    if((fd == -1 ? stat(".", &buf) : fstat(fd, &buf)) == -1){
+        DC_ERROR_RAISE_ERRNO(err, errno);
+
+        if(fd != -1){
+            close(fd);
+        }
+
+        dc_free(env, cwd, dc_strlen(env, cwd) + 1);
+        return;
+    }
+
+    forget_current_directory(env, state);
+    state->cwd = cwd;
+    state->cwd_fd = fd;
+    state->cwd_dev = buf.st_dev;
+    state->cwd_ino = buf.st_ino;
+}
+
+/**
+ * Release state->cwd and close state->cwd_fd, so the working directory is read again when it is next needed.
+ *
+ * @param env the posix environment.
+ * @param state the shell.
+ */
+void forget_current_directory(const struct dc_posix_env *env, struct state *state){
+    if(state->cwd == NULL){
+        return;
+    }
+
+    if(state->cwd_fd != -1){
+        close(state->cwd_fd);
+    }
+
+    dc_free(env, state->cwd, dc_strlen(env, state->cwd) + 1);
+    state->cwd = NULL;
+    state->cwd_fd = -1;
+}
+
 /**
  * Display the state values to the given stream.
  *
@@ -131,6 +257,8 @@ void display_state(const struct dc_posix_env *env, const struct state *state, FI
 
 /**
  * Display the state values to the given stream.
+ * The descriptors exec redirected are listed after the line, if there are any, then the
+ * high-water mark of the state->arena, if there is one.
  *
  * @param env the posix environment.
  * @param state the state to display.
@@ -149,6 +277,17 @@ char *state_to_string(const struct dc_posix_env *env,  struct dc_error *err, con
     }
 
     len += dc_strlen(env, ", fatal_error = ");
+
+    // each descriptor is at most 11 characters and a ", "
+    if(state->fd_count > 0){
+        len += dc_strlen(env, ", fds = []") + state->fd_count * 13;
+    }
+
+    // a size_t is at most 20 digits
+    if(state->arena != NULL){
+        len += dc_strlen(env, ", arena_high_water_mark = ") + 20;
+    }
+
     line = dc_malloc(env, err, len + 1);
 
     if(state->current_line == NULL){
@@ -157,5 +296,87 @@ char *state_to_string(const struct dc_posix_env *env,  struct dc_error *err, con
         sprintf(line, "current_line = \"%s\", fatal_error = %d", state->current_line, state->fatal_error);
     }
 
+    if(state->fd_count > 0){
+        size_t used;
+
+        used = dc_strlen(env, line);
+        used += (size_t)sprintf(line + used, ", fds = [");
+
+        for(size_t i = 0; i < state->fd_count; i++){
+            used += (size_t)sprintf(line + used, i == 0 ? "%d" : ", %d", state->fds[i]);
+        }
+
+        sprintf(line + used, "]");
+    }
+
+    if(state->arena != NULL){
+        sprintf(line + dc_strlen(env, line), ", arena_high_water_mark = %zu", state->arena->high_water_mark);
+    }
+
     return line;
 }
+
+/**
+ * Create an unlinked file for output that is kept until it is read back, O_TMPFILE where there is one.
+ *
+ * @param env the posix environment.
+ * @param err the error object.
+ * @return the file, O_CLOEXEC so only the child it is given to gets it.
+ */
+int open_temp(const struct dc_posix_env *env, struct dc_error *err){
+    char name[] = "/tmp/dc_shell_XXXXXX";
+    int fd;
+
+#ifdef O_TMPFILE
+    fd = dc_open(env, err, "/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+    if(dc_error_has_no_error(err)){
+        return fd;
+    }
+
+    // the file system of /tmp may not have O_TMPFILE, a named file is unlinked instead
+    dc_error_reset(err);
+#endif
+
+    fd = dc_mkstemp(env, err, name);
+
+    if(dc_error_has_error(err)){
+        return -1;
+    }
+
+    dc_unlink(env, err, name);
+    dc_fcntl(env, err, fd, F_SETFD, FD_CLOEXEC);
+
+    if(dc_error_has_error(err)){
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Move a descriptor the shell keeps open to SHELL_FD_FLOOR or above, keeping O_CLOEXEC, so the
+ * descriptors below it are left for exec n>file.
+ *
+ * @param fd the descriptor, it is closed if it was moved.
+ * @return the descriptor to use, fd itself if it is -1, already high enough or could not be moved.
+ */
+int move_shell_fd(int fd){
+    int moved;
+
+    if(fd < STDIN_FILENO || fd >= SHELL_FD_FLOOR){
+        return fd;
+    }
+
+    moved = fcntl(fd, F_DUPFD_CLOEXEC, SHELL_FD_FLOOR);
+
+    // the low descriptor still works, it only limits exec
+    if(moved == -1){
+        return fd;
+    }
+
+    close(fd);
+
+    return moved;
+}
@@ -0,0 +1,166 @@
+#include "tests.h"
+#include "arena.h"
+#include <stdint.h>
+
+Describe(arena);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+
+BeforeEach(arena)
+{
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+}
+
+AfterEach(arena)
+{
+    dc_error_reset(&error);
+}
+
+Ensure(arena, arena_create)
+{
+    struct arena *arena;
+
+    arena = arena_create(&environ, &error, 0);
+    assert_false(dc_error_has_error(&error));
+    assert_that(arena, is_not_null);
+    assert_that(arena->block_size, is_equal_to(ARENA_DEFAULT_BLOCK_SIZE));
+    assert_that(arena->blocks, is_not_null);
+    assert_that(arena->allocated, is_equal_to(0));
+    assert_that(arena->high_water_mark, is_equal_to(0));
+    assert_that(arena->block_allocations, is_equal_to(1));
+    arena_destroy(&environ, &arena);
+    assert_that(arena, is_null);
+
+    arena = arena_create(&environ, &error, 100);
+    assert_that(arena->blocks->size, is_greater_than(99));
+    arena_destroy(&environ, &arena);
+}
+
+Ensure(arena, arena_alloc)
+{
+    struct arena *arena;
+    char *a;
+    char *b;
+
+    arena = arena_create(&environ, &error, 256);
+    a = arena_alloc(&environ, &error, arena, 3);
+    b = arena_alloc(&environ, &error, arena, 5);
+    assert_false(dc_error_has_error(&error));
+    assert_that(a, is_not_null);
+    assert_that(b, is_greater_than(a + 2));
+    assert_that((uintptr_t)b % _Alignof(max_align_t), is_equal_to(0));
+    assert_that(arena->block_allocations, is_equal_to(1));
+
+    // bigger than a block
+    a = arena_alloc(&environ, &error, arena, 1000);
+    assert_that(a, is_not_null);
+    memset(a, 'x', 1000);
+    assert_that(arena->block_allocations, is_equal_to(2));
+    assert_that(arena->high_water_mark, is_greater_than(1007));
+    arena_destroy(&environ, &arena);
+}
+
+Ensure(arena, arena_calloc)
+{
+    struct arena *arena;
+    size_t *values;
+
+    arena = arena_create(&environ, &error, 0);
+    arena_alloc(&environ, &error, arena, 64);
+    arena_reset(&environ, arena);
+    values = arena_calloc(&environ, &error, arena, 8, sizeof(size_t));
+
+    for(size_t i = 0; i < 8; i++)
+    {
+        assert_that(values[i], is_equal_to(0));
+    }
+
+    arena_calloc(&environ, &error, arena, SIZE_MAX, 2);
+    assert_true(dc_error_is_errno(&error, ENOMEM));
+    arena_destroy(&environ, &arena);
+}
+
+Ensure(arena, arena_realloc)
+{
+    struct arena *arena;
+    char *a;
+    char *b;
+
+    arena = arena_create(&environ, &error, 256);
+    a = arena_strndup(&environ, &error, arena, "hello", 5);
+    b = arena_realloc(&environ, &error, arena, a, 6, 64);
+    assert_that(b, is_equal_to(a));
+    assert_that(b, is_equal_to_string("hello"));
+
+    arena_alloc(&environ, &error, arena, 1);
+    b = arena_realloc(&environ, &error, arena, a, 64, 128);
+    assert_that(b, is_not_equal_to(a));
+    assert_that(b, is_equal_to_string("hello"));
+    arena_destroy(&environ, &arena);
+}
+
+Ensure(arena, arena_strndup)
+{
+    struct arena *arena;
+    char *str;
+
+    arena = arena_create(&environ, &error, 0);
+    str = arena_strndup(&environ, &error, arena, "hello world", 5);
+    assert_that(str, is_equal_to_string("hello"));
+    str = arena_strndup(&environ, &error, arena, "", 0);
+    assert_that(str, is_equal_to_string(""));
+    arena_destroy(&environ, &arena);
+}
+
+Ensure(arena, arena_reset)
+{
+    struct arena *arena;
+    size_t block_allocations;
+
+    arena = arena_create(&environ, &error, 128);
+    arena_alloc(&environ, &error, arena, 100);
+    arena_reset(&environ, arena);
+    assert_that(arena->allocated, is_equal_to(0));
+    assert_that(arena->block_allocations, is_equal_to(1));
+    assert_that(arena->high_water_mark, is_greater_than(99));
+
+    // a line that spills over settles on one bigger block after the reset
+    for(int i = 0; i < 3; i++)
+    {
+        arena_alloc(&environ, &error, arena, 100);
+        arena_alloc(&environ, &error, arena, 100);
+        arena_alloc(&environ, &error, arena, 100);
+        arena_reset(&environ, arena);
+    }
+
+    block_allocations = arena->block_allocations;
+
+    for(int i = 0; i < 10; i++)
+    {
+        arena_alloc(&environ, &error, arena, 100);
+        arena_alloc(&environ, &error, arena, 100);
+        arena_alloc(&environ, &error, arena, 100);
+        arena_reset(&environ, arena);
+    }
+
+    assert_that(arena->block_allocations, is_equal_to(block_allocations));
+    assert_that(arena->blocks->next, is_null);
+    arena_destroy(&environ, &arena);
+}
+
+TestSuite *arena_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, arena, arena_create);
+    add_test_with_context(suite, arena, arena_alloc);
+    add_test_with_context(suite, arena, arena_calloc);
+    add_test_with_context(suite, arena, arena_realloc);
+    add_test_with_context(suite, arena, arena_strndup);
+    add_test_with_context(suite, arena, arena_reset);
+
+    return suite;
+}
@@ -4,9 +4,13 @@
 #include <dc_util/filesystem.h>
 #include <dc_util/path.h>
 #include <dc_util/strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 static void test_builtin_cd(const char *line, const char *cmd, size_t argc, char **argv, const char *expected_dir, const char *expected_message);
+static void test_builtin_hash(struct path_cache *cache, char **path, size_t argc, char **argv, int expected_exit_code, const char *expected_out, const char *expected_err);
+static void test_builtin(const char *name, size_t argc, char **argv, int expected_exit_code, const char *expected_out, const char *expected_err);
 
 Describe(builtin);
 
@@ -55,7 +59,6 @@ Ensure(builtin, builtin_cd)
     chdir("/tmp");
     argv = dc_strs_to_array(&environ, &error, 3, NULL, "/dev/null", NULL);
     test_builtin_cd("cd /dev/null\n", "cd", 2, argv, "/tmp", "/dev/null: is not a directory\n");
-    dc_error_reset(&error);
 
     strcpy(template, "/tmp/fileXXXXXX");
     mkdtemp(template);
@@ -68,24 +71,29 @@ Ensure(builtin, builtin_cd)
 static void test_builtin_cd(const char *line, const char *cmd, size_t argc, char **argv, const char *expected_dir, const char *expected_message)
 {
     struct command command;
+    struct state state;
     char message[1024];
     FILE *stderr_file;
     char *working_dir;
 
     memset(&command, 0, sizeof(struct command));
+    memset(&state, 0, sizeof(struct state));
     command.line = strdup(line);
     command.command = strdup(cmd);
     command.argc = argc;
     command.argv = argv;
     memset(message, 0, sizeof(message));
     stderr_file = fmemopen(message, sizeof(message), "w");
-    builtin_cd(&environ, &error, &command, stderr_file);
+    state.stderr = stderr_file;
+    builtin_cd(&environ, &error, &command, &state);
+    assert_false(dc_error_has_error(&error));
 
-    if(dc_error_has_no_error(&error))
+    if(expected_message == NULL)
     {
         // TODO: wny does this hang if chdir failed?
         working_dir = dc_get_working_dir(&environ, &error);
         assert_that(working_dir, is_equal_to_string(expected_dir));
+        assert_that(state.cwd, is_equal_to_string(expected_dir));
         assert_that(command.exit_code, is_equal_to(0));
         free(working_dir);
     }
@@ -94,18 +102,428 @@ static void test_builtin_cd(const char *line, const char *cmd, size_t argc, char
         fflush(stderr_file);
         assert_that(message, is_equal_to_string(expected_message));
         assert_that(command.exit_code, is_equal_to(1));
+        assert_that(state.cwd, is_null);
     }
 
+    forget_current_directory(&environ, &state);
     fclose(stderr_file);
     destroy_command(&environ, &command);
 }
 
+Ensure(builtin, builtin_cd_relative_path)
+{
+    struct command command;
+    struct state state;
+    const struct path_cache_entry *entry;
+    char dot[] = ".";
+    char *path[] = {dot, NULL};
+    char dir1[32];
+    char dir2[32];
+    char tool[64];
+    struct stat dir_stat;
+    struct stat entry_stat;
+
+    strcpy(dir1, "/tmp/cdXXXXXX");
+    strcpy(dir2, "/tmp/cdXXXXXX");
+    mkdtemp(dir1);
+    mkdtemp(dir2);
+    sprintf(tool, "%s/tool", dir1);
+    close(open(tool, O_WRONLY | O_CREAT, 0755));
+    sprintf(tool, "%s/tool", dir2);
+    close(open(tool, O_WRONLY | O_CREAT, 0755));
+
+    memset(&command, 0, sizeof(struct command));
+    memset(&state, 0, sizeof(struct state));
+    state.stderr = stderr;
+    state.path = path;
+    state.path_cache = path_cache_create(&environ, &error);
+    chdir(dir1);
+    path_cache_validate(&environ, &error, state.path_cache, ".", path);
+    entry = path_cache_lookup(&environ, &error, state.path_cache, path, "tool");
+    assert_that(entry, is_not_null);
+
+    // the . of PATH follows the cd, the tool of dir2 is found instead of the one of dir1
+    command.line = strdup("cd");
+    command.command = strdup("cd");
+    command.argc = 2;
+    command.argv = dc_strs_to_array(&environ, &error, 3, NULL, dir2, NULL);
+    builtin_cd(&environ, &error, &command, &state);
+    assert_that(command.exit_code, is_equal_to(0));
+    assert_that(state.path_cache->count, is_equal_to(0));
+    path_cache_validate(&environ, &error, state.path_cache, ".", path);
+    entry = path_cache_lookup(&environ, &error, state.path_cache, path, "tool");
+    assert_that(entry, is_not_null);
+    fstat(entry->dir_fd, &entry_stat);
+    stat(dir2, &dir_stat);
+    assert_that(entry_stat.st_ino, is_equal_to(dir_stat.st_ino));
+    assert_false(dc_error_has_error(&error));
+
+    chdir("/tmp");
+    path_cache_destroy(&environ, &state.path_cache);
+    forget_current_directory(&environ, &state);
+    destroy_command(&environ, &command);
+    unlink(tool);
+    sprintf(tool, "%s/tool", dir1);
+    unlink(tool);
+    rmdir(dir1);
+    rmdir(dir2);
+}
+
+Ensure(builtin, builtin_hash)
+{
+    struct path_cache *cache;
+    char **path;
+    char **argv;
+
+    path = dc_strs_to_array(&environ, &error, 3, "/bin", "/usr/bin", NULL);
+    cache = path_cache_create(&environ, &error);
+    path_cache_validate(&environ, &error, cache, "/bin:/usr/bin", path);
+
+    argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    test_builtin_hash(cache, path, 1, argv, 0, "hash: hash table empty\n", "");
+
+    argv = dc_strs_to_array(&environ, &error, 3, NULL, "sh", NULL);
+    test_builtin_hash(cache, path, 2, argv, 0, "", "");
+    assert_that(cache->count, is_equal_to(1));
+
+    argv = dc_strs_to_array(&environ, &error, 3, NULL, "-s", NULL);
+    test_builtin_hash(cache, path, 2, argv, 0, "hits 0, misses 1, entries 1, not found hits 0, not found entries 0\n", "");
+
+    argv = dc_strs_to_array(&environ, &error, 4, NULL, "sh", "asdasdasdfddfgsdfgasderdfdsf", NULL);
+    test_builtin_hash(cache, path, 3, argv, 1, "", "hash: asdasdasdfddfgsdfgasderdfdsf: not found\n");
+    assert_that(cache->hits, is_equal_to(1));
+    assert_that(cache->negative_count, is_equal_to(1));
+
+    argv = dc_strs_to_array(&environ, &error, 3, NULL, "-r", NULL);
+    test_builtin_hash(cache, path, 2, argv, 0, "", "");
+    assert_that(cache->count, is_equal_to(0));
+
+    argv = dc_strs_to_array(&environ, &error, 3, NULL, "-x", NULL);
+    test_builtin_hash(cache, path, 2, argv, 2, "", "hash: -x: invalid option\nhash: usage: hash [-rs] [name ...]\n");
+
+    path_cache_destroy(&environ, &cache);
+    dc_strs_destroy_array(&environ, 3, path);
+    free(path);
+}
+
+Ensure(builtin, builtin_find)
+{
+    const struct builtin *builtins;
+    const struct builtin *builtin;
+    size_t count;
+
+    builtins = builtin_list(&count);
+    assert_that(count, is_greater_than(2));
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(i > 0)
+        {
+            // builtin_find relies on the order
+            assert_that(strcmp(builtins[i - 1].name, builtins[i].name), is_less_than(0));
+        }
+
+        assert_that(builtin_find(&environ, builtins[i].name), is_equal_to(&builtins[i]));
+    }
+
+    builtin = builtin_find(&environ, "cd");
+    assert_that(builtin->handler, is_equal_to(builtin_cd));
+    assert_that(builtin->flags & BUILTIN_PARENT, is_not_equal_to(0));
+
+    builtin = builtin_find(&environ, "exit");
+    assert_that(builtin->flags & BUILTIN_EXIT, is_not_equal_to(0));
+
+    assert_that(builtin_find(&environ, "ls"), is_null);
+    assert_that(builtin_find(&environ, "c"), is_null);
+    assert_that(builtin_find(&environ, "zzz"), is_null);
+    assert_that(builtin_find(&environ, ""), is_null);
+}
+
+static void test_builtin_hash(struct path_cache *cache, char **path, size_t argc, char **argv, int expected_exit_code, const char *expected_out, const char *expected_err)
+{
+    struct command command;
+    struct state state;
+    char out[1024];
+    char err[1024];
+    FILE *out_file;
+    FILE *err_file;
+
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup("hash");
+    command.argc = argc;
+    command.argv = argv;
+    memset(out, 0, sizeof(out));
+    memset(err, 0, sizeof(err));
+    out_file = fmemopen(out, sizeof(out), "w");
+    err_file = fmemopen(err, sizeof(err), "w");
+    memset(&state, 0, sizeof(struct state));
+    state.stdout = out_file;
+    state.stderr = err_file;
+    state.path = path;
+    state.path_cache = cache;
+    builtin_hash(&environ, &error, &command, &state);
+    fclose(out_file);
+    fclose(err_file);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(expected_exit_code));
+    assert_that(out, is_equal_to_string(expected_out));
+    assert_that(err, is_equal_to_string(expected_err));
+    destroy_command(&environ, &command);
+}
+
+Ensure(builtin, builtin_echo)
+{
+    test_builtin("echo", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 0, "\n", "");
+    test_builtin("echo", 3, dc_strs_to_array(&environ, &error, 4, NULL, "a", "b c", NULL), 0, "a b c\n", "");
+    test_builtin("echo", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-n", "a", NULL), 0, "a", "");
+    test_builtin("echo", 3, dc_strs_to_array(&environ, &error, 4, NULL, "a", "-n", NULL), 0, "a -n\n", "");
+}
+
+Ensure(builtin, builtin_true_false)
+{
+    test_builtin("true", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 0, "", "");
+    test_builtin("true", 2, dc_strs_to_array(&environ, &error, 3, NULL, "x", NULL), 0, "", "");
+    test_builtin("false", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 1, "", "");
+}
+
+Ensure(builtin, builtin_printf)
+{
+    test_builtin("printf", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 2, "", "printf: usage: printf format [arguments]\n");
+    test_builtin("printf", 2, dc_strs_to_array(&environ, &error, 3, NULL, "a\\tb\\n", NULL), 0, "a\tb\n", "");
+    test_builtin("printf", 2, dc_strs_to_array(&environ, &error, 3, NULL, "\\101\\\\%%", NULL), 0, "A\\%", "");
+    test_builtin("printf", 5, dc_strs_to_array(&environ, &error, 6, NULL, "%s=%d\n", "a", "1", "b", NULL), 0, "a=1\nb=0\n", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "[%5s][%-3s]", "ab", NULL), 0, "[   ab][   ]", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "[%.2s][%c]", "abc", NULL), 0, "[ab][]", "");
+    test_builtin("printf", 6, dc_strs_to_array(&environ, &error, 7, NULL, "%05d %+d %x %#X %o", "-42", "7", "255", "255", NULL), 0, "-0042 +7 ff 0XFF 0", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "%.3d|%4.2d", "5", NULL), 0, "005|  00", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "%d %d", "'A", NULL), 0, "65 0", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "%b|", "a\\nb\\0101\\cx", NULL), 0, "a\nbA", "");
+    test_builtin("printf", 3, dc_strs_to_array(&environ, &error, 4, NULL, "%d\n", "12x", NULL), 1, "12\n", "printf: 12x: invalid number\n");
+    test_builtin("printf", 2, dc_strs_to_array(&environ, &error, 3, NULL, "a%q", NULL), 1, "a", "printf: %q: invalid directive\n");
+}
+
+Ensure(builtin, builtin_pwd)
+{
+    char *working_dir;
+
+    chdir("/tmp");
+    working_dir = dc_get_working_dir(&environ, &error);
+    working_dir = realloc(working_dir, strlen(working_dir) + 2);
+    strcat(working_dir, "\n");
+    test_builtin("pwd", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 0, working_dir, "");
+    free(working_dir);
+}
+
+Ensure(builtin, builtin_test)
+{
+    test_builtin("test", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 1, "", "");
+    test_builtin("test", 2, dc_strs_to_array(&environ, &error, 3, NULL, "x", NULL), 0, "", "");
+    test_builtin("test", 2, dc_strs_to_array(&environ, &error, 3, NULL, "", NULL), 1, "", "");
+    test_builtin("test", 2, dc_strs_to_array(&environ, &error, 3, NULL, "-n", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "!", "", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-z", "", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-d", "/", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-f", "/", NULL), 1, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-e", "/no/such/file", NULL), 1, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-c", "/dev/null", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-x", "/bin/sh", NULL), 0, "", "");
+    test_builtin("test", 3, dc_strs_to_array(&environ, &error, 4, NULL, "x", "y", NULL), 2, "", "test: x: unexpected argument\n");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "a", "=", "a", NULL), 0, "", "");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "a", "!=", "a", NULL), 1, "", "");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "=", "=", "=", NULL), 0, "", "");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "10", "-gt", "9", NULL), 0, "", "");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "-3", "-le", "-4", NULL), 1, "", "");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "a", "-eq", "1", NULL), 2, "", "test: a: unexpected argument\n");
+    test_builtin("test", 4, dc_strs_to_array(&environ, &error, 5, NULL, "(", "x", ")", NULL), 0, "", "");
+    test_builtin("test", 5, dc_strs_to_array(&environ, &error, 6, NULL, "!", "1", "-eq", "2", NULL), 0, "", "");
+    test_builtin("test", 6, dc_strs_to_array(&environ, &error, 7, NULL, "x", "-a", "", "-o", "y", NULL), 0, "", "");
+    test_builtin("test", 6, dc_strs_to_array(&environ, &error, 7, NULL, "x", "-a", "(", "", ")", NULL), 1, "", "");
+    test_builtin("test", 8, dc_strs_to_array(&environ, &error, 9, NULL, "!", "(", "1", "-lt", "2", ")", "-o", NULL), 2, "", "test: -o: unexpected argument\n");
+}
+
+Ensure(builtin, builtin_bracket)
+{
+    test_builtin("[", 2, dc_strs_to_array(&environ, &error, 3, NULL, "]", NULL), 1, "", "");
+    test_builtin("[", 4, dc_strs_to_array(&environ, &error, 5, NULL, "-d", "/", "]", NULL), 0, "", "");
+    test_builtin("[", 3, dc_strs_to_array(&environ, &error, 4, NULL, "-d", "/", NULL), 2, "", "[: missing ]\n");
+    test_builtin("[", 1, dc_strs_to_array(&environ, &error, 2, NULL, NULL), 2, "", "[: missing ]\n");
+}
+
+Ensure(builtin, builtin_run)
+{
+    struct command command;
+    struct state state;
+    char template[32];
+    char out[1024];
+    FILE *out_file;
+    FILE *file;
+    int fd;
+
+    strcpy(template, "/tmp/builtinXXXXXX");
+    fd = mkstemp(template);
+    close(fd);
+    memset(out, 0, sizeof(out));
+    out_file = fmemopen(out, sizeof(out), "w");
+    memset(&state, 0, sizeof(struct state));
+    state.stdout = out_file;
+    state.stderr = out_file;
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup("echo");
+    command.argc = 2;
+    command.argv = dc_strs_to_array(&environ, &error, 3, NULL, "hello", NULL);
+    command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 1, strdup(template), -1);
+
+    // the output goes to the file, the shell streams are put back
+    builtin_run(&environ, &error, builtin_find(&environ, "echo"), &command, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(0));
+    assert_that(state.stdout, is_equal_to(out_file));
+    assert_that(state.stderr, is_equal_to(out_file));
+
+    // >> appends
+    command.redirections[0].type = REDIRECT_APPEND;
+    builtin_run(&environ, &error, builtin_find(&environ, "echo"), &command, &state);
+    file = fopen(template, "r");
+    memset(out, 0, sizeof(out));
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    assert_that(out, is_equal_to_string("hello\nhello\n"));
+
+    // a missing stdin file fails the builtin without running it
+    memset(out, 0, sizeof(out));
+    rewind(out_file);
+    command.redirections[0].type = REDIRECT_INPUT;
+    command.redirections[0].fd = 0;
+    free(command.redirections[0].target);
+    command.redirections[0].target = strdup("/no/such/file");
+    builtin_run(&environ, &error, builtin_find(&environ, "echo"), &command, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(1));
+    assert_that(strstr(out, "hello"), is_null);
+
+    fclose(out_file);
+    unlink(template);
+    destroy_command(&environ, &command);
+}
+
+Ensure(builtin, builtin_exec)
+{
+    const struct builtin *builtin;
+    struct command command;
+    struct state state;
+    char template[32];
+    char line[64];
+    char out[1024];
+    char err[1024];
+    FILE *file;
+    int fd;
+
+    builtin = builtin_find(&environ, "exec");
+    strcpy(template, "/tmp/builtinXXXXXX");
+    fd = mkstemp(template);
+    close(fd);
+    memset(out, 0, sizeof(out));
+    memset(err, 0, sizeof(err));
+    memset(&state, 0, sizeof(struct state));
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = fmemopen(err, sizeof(err), "w");
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup("exec");
+    command.argc = 1;
+    command.argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 9, strdup(template), -1);
+
+    // the file is opened once, on 9, and a child inherits it
+    builtin_run(&environ, &error, builtin, &command, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(0));
+    assert_that(state.fd_count, is_equal_to(1));
+    assert_that(state.fds[0], is_equal_to(9));
+    assert_that(fcntl(9, F_GETFD), is_equal_to(0));
+    assert_that(write(9, "a\n", 2), is_equal_to(2));
+    assert_that(system("echo b >&9"), is_equal_to(0));
+
+    // >&- closes it again
+    command.redirections[0].type = REDIRECT_CLOSE;
+    builtin_run(&environ, &error, builtin, &command, &state);
+    assert_that(command.exit_code, is_equal_to(0));
+    assert_that(state.fd_count, is_equal_to(0));
+    assert_that(state.fds, is_null);
+    assert_that(fcntl(9, F_GETFD), is_equal_to(-1));
+    file = fopen(template, "r");
+    memset(line, 0, sizeof(line));
+    fread(line, 1, sizeof(line) - 1, file);
+    fclose(file);
+    assert_that(line, is_equal_to_string("a\nb\n"));
+
+    // a descriptor of the shell is left alone
+    fd = move_shell_fd(open("/dev/null", O_RDONLY | O_CLOEXEC));
+    command.redirections[0].type = REDIRECT_CLOSE;
+    command.redirections[0].fd = fd;
+    builtin_run(&environ, &error, builtin, &command, &state);
+    assert_that(command.exit_code, is_equal_to(1));
+    assert_that(fcntl(fd, F_GETFD), is_equal_to(FD_CLOEXEC));
+    assert_that(state.fd_count, is_equal_to(0));
+    close(fd);
+
+    fclose(state.stdout);
+    fclose(state.stderr);
+    snprintf(line, sizeof(line), "exec: %d: the descriptor is used by the shell\n", fd);
+    assert_that(err, is_equal_to_string(line));
+    assert_that(out, is_equal_to_string(""));
+    unlink(template);
+    destroy_command(&environ, &command);
+
+    test_builtin("exec", 2, dc_strs_to_array(&environ, &error, 3, NULL, "ls", NULL), 2, "", "exec: usage: exec [n]>file [n]>&m [n]>&- ...\n");
+}
+
+static void test_builtin(const char *name, size_t argc, char **argv, int expected_exit_code, const char *expected_out, const char *expected_err)
+{
+    const struct builtin *builtin;
+    struct command command;
+    struct state state;
+    char out[1024];
+    char err[1024];
+
+    builtin = builtin_find(&environ, name);
+    assert_that(builtin, is_not_null);
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup(name);
+    command.argc = argc;
+    command.argv = argv;
+    memset(out, 0, sizeof(out));
+    memset(err, 0, sizeof(err));
+    memset(&state, 0, sizeof(struct state));
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = fmemopen(err, sizeof(err), "w");
+    builtin->handler(&environ, &error, &command, &state);
+    fclose(state.stdout);
+    fclose(state.stderr);
+    forget_current_directory(&environ, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(expected_exit_code));
+    assert_that(out, is_equal_to_string(expected_out));
+    assert_that(err, is_equal_to_string(expected_err));
+    destroy_command(&environ, &command);
+}
+
 TestSuite *builtin_tests(void)
 {
     TestSuite *suite;
 
     suite = create_test_suite();
     add_test_with_context(suite, builtin, builtin_cd);
+    add_test_with_context(suite, builtin, builtin_cd_relative_path);
+    add_test_with_context(suite, builtin, builtin_hash);
+    add_test_with_context(suite, builtin, builtin_find);
+    add_test_with_context(suite, builtin, builtin_echo);
+    add_test_with_context(suite, builtin, builtin_true_false);
+    add_test_with_context(suite, builtin, builtin_printf);
+    add_test_with_context(suite, builtin, builtin_pwd);
+    add_test_with_context(suite, builtin, builtin_test);
+    add_test_with_context(suite, builtin, builtin_bracket);
+    add_test_with_context(suite, builtin, builtin_run);
+    add_test_with_context(suite, builtin, builtin_exec);
 
     return suite;
 }
@@ -13,6 +13,8 @@ static void test_parse_command(const char *expected_line,
                                bool expected_stdout_overwrite,
                                const char *expected_stderr_file,
                                bool expected_stderr_overwrite);
+static void check_redirection(const struct command *command, int fd, const char *expected_file,
+                              enum redirection_type expected_type);
 static void expand_path(const char *expected_file, char **expanded_file);
 static void test_destroy_command(const char *expected_line);
 
@@ -179,6 +181,32 @@ Ensure(command, parse_command)
     dc_strs_destroy_array(&environ, 5, argv);
     free(argv);
 
+    argv = dc_strs_to_array(&environ, &error, 4, NULL, "a b", "c>d", NULL);
+    test_parse_command("echo \"a b\" c\\>d>out 2>>\"e r r\"",
+                       "echo",
+                       3,
+                       argv,
+                       NULL,
+                       "out",
+                       false,
+                       "e r r",
+                       true);
+    dc_strs_destroy_array(&environ, 4, argv);
+    free(argv);
+
+    argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    test_parse_command("cat<in>out",
+                       "cat",
+                       1,
+                       argv,
+                       "in",
+                       "out",
+                       false,
+                       NULL,
+                       false);
+    dc_strs_destroy_array(&environ, 2, argv);
+    free(argv);
+
     /*
     argv = dc_strs_to_array(&environ, &error, 5, NULL, "/User/ds/hello", "evil", "world", NULL);
     test_parse_command("foo ~/hello ~/def/evil \"world rocks\"",
@@ -211,6 +239,7 @@ static void test_parse_command(const char *expected_line,
     expand_path(expected_stdin_file, &expanded_stdin_file);
     expand_path(expected_stdout_file, &expanded_stdout_file);
     expand_path(expected_stderr_file, &expanded_stderr_file);
+    memset(&state, 0, sizeof(state));
     state.stdin = NULL;
     state.stdout = NULL;
     state.stderr = NULL;
@@ -218,7 +247,8 @@ static void test_parse_command(const char *expected_line,
     state.command = calloc(1, sizeof(struct command));
     state.command->line = strdup(expected_line);
     parse_command(&environ, &error, &state, state.command);
-    assert_that(state.command->line, is_equal_to_string(expected_line));
+    // the command is a view into the line, not a copy
+    assert_that(state.command->command, is_equal_to(state.command->line + strspn(expected_line, " ")));
     assert_that(state.command->command, is_equal_to_string(expected_command));
     assert_that(state.command->argc, is_equal_to(expected_argc));
 
@@ -230,11 +260,11 @@ static void test_parse_command(const char *expected_line,
         assert_that(state.command->argv[i], is_equal_to_string(expected_argv[i]));
     }
 
-    assert_that(state.command->stdin_file, is_equal_to_string(expanded_stdin_file));
-    assert_that(state.command->stdout_file, is_equal_to_string(expanded_stdout_file));
-    assert_that(state.command->stdout_overwrite, is_equal_to(expected_stdout_overwrite));
-    assert_that(state.command->stderr_file, is_equal_to_string(expanded_stderr_file));
-    assert_that(state.command->stderr_overwrite, is_equal_to(expected_stderr_overwrite));
+    check_redirection(state.command, 0, expanded_stdin_file, REDIRECT_INPUT);
+    check_redirection(state.command, 1, expanded_stdout_file,
+                      expected_stdout_overwrite ? REDIRECT_APPEND : REDIRECT_OUTPUT);
+    check_redirection(state.command, 2, expanded_stderr_file,
+                      expected_stderr_overwrite ? REDIRECT_APPEND : REDIRECT_OUTPUT);
     assert_that(state.command->exit_code, is_equal_to(0));
     free(expanded_stdin_file);
     free(expanded_stdout_file);
@@ -242,6 +272,32 @@ static void test_parse_command(const char *expected_line,
     destroy_state(&environ, &error, &state);
 }
 
+static void check_redirection(const struct command *command, int fd, const char *expected_file,
+                              enum redirection_type expected_type)
+{
+    const struct redirection *redirection = NULL;
+
+    // the last redirection of a descriptor is the one that counts
+    for(size_t i = 0; i < command->redirection_count; i++)
+    {
+        if(command->redirections[i].fd == fd)
+        {
+            redirection = &command->redirections[i];
+        }
+    }
+
+    if(expected_file == NULL)
+    {
+        assert_that(redirection, is_null);
+    }
+    else
+    {
+        assert_that(redirection, is_not_null);
+        assert_that(redirection->type, is_equal_to(expected_type));
+        assert_that(redirection->target, is_equal_to_string(expected_file));
+    }
+}
+
 static void expand_path(const char *expected_file, char **expanded_file)
 {
     if(expected_file == NULL)
@@ -259,6 +315,84 @@ static void expand_path(const char *expected_file, char **expanded_file)
     }
 }
 
+Ensure(command, redirections)
+{
+    struct state state;
+    const struct redirection *redirections;
+    char message[128];
+
+    memset(&state, 0, sizeof(state));
+    init_state(&environ, &error, &state);
+
+    // the redirections are kept in the order they are on the line
+    state.command = calloc(1, sizeof(struct command));
+    state.command->line = strdup("cmd <in >out 2>&1 3>>log 4<&0 5>&- 0<<<'a b' 10>x");
+    parse_command(&environ, &error, &state, state.command);
+    assert_false(dc_error_has_error(&error));
+    assert_that(state.command->redirection_count, is_equal_to(8));
+    redirections = state.command->redirections;
+    assert_that(redirections[0].type, is_equal_to(REDIRECT_INPUT));
+    assert_that(redirections[0].fd, is_equal_to(0));
+    assert_that(redirections[0].target, is_equal_to_string("in"));
+    assert_that(redirections[1].type, is_equal_to(REDIRECT_OUTPUT));
+    assert_that(redirections[1].fd, is_equal_to(1));
+    assert_that(redirections[1].target, is_equal_to_string("out"));
+    assert_that(redirections[2].type, is_equal_to(REDIRECT_DUP));
+    assert_that(redirections[2].fd, is_equal_to(2));
+    assert_that(redirections[2].target_fd, is_equal_to(1));
+    assert_that(redirections[3].type, is_equal_to(REDIRECT_APPEND));
+    assert_that(redirections[3].fd, is_equal_to(3));
+    assert_that(redirections[3].target, is_equal_to_string("log"));
+    assert_that(redirections[4].type, is_equal_to(REDIRECT_DUP));
+    assert_that(redirections[4].fd, is_equal_to(4));
+    assert_that(redirections[4].target_fd, is_equal_to(0));
+    assert_that(redirections[5].type, is_equal_to(REDIRECT_CLOSE));
+    assert_that(redirections[5].fd, is_equal_to(5));
+    assert_that(redirections[6].type, is_equal_to(REDIRECT_HERE_STRING));
+    assert_that(redirections[6].fd, is_equal_to(0));
+    assert_that(redirections[6].target, is_equal_to_string("a b"));
+    assert_that(redirections[7].type, is_equal_to(REDIRECT_OUTPUT));
+    assert_that(redirections[7].fd, is_equal_to(10));
+    assert_that(state.command->argc, is_equal_to(1));
+    destroy_command(&environ, state.command);
+    free(state.command);
+
+    // a copy needs a descriptor or -
+    state.command = calloc(1, sizeof(struct command));
+    state.command->line = strdup("cmd 2>&file");
+    parse_command(&environ, &error, &state, state.command);
+    assert_true(dc_error_has_error(&error));
+    assert_that(error.err_code, is_equal_to(PARSE_ERROR));
+    assert_false(state.fatal_error);
+    dc_error_reset(&error);
+    destroy_command(&environ, state.command);
+    free(state.command);
+
+    state.command = calloc(1, sizeof(struct command));
+    state.command->line = strdup("cmd <<<");
+    parse_command(&environ, &error, &state, state.command);
+    assert_true(dc_error_has_error(&error));
+    dc_error_reset(&error);
+    destroy_command(&environ, state.command);
+    free(state.command);
+
+    // a ~ that cannot be expanded fails the command, not the shell
+    memset(message, 0, sizeof(message));
+    state.stderr = fmemopen(message, sizeof(message), "w");
+    state.command = calloc(1, sizeof(struct command));
+    state.command->line = strdup("cmd >~nosuchuserxyz/file");
+    parse_command(&environ, &error, &state, state.command);
+    fclose(state.stderr);
+    assert_false(dc_error_has_error(&error));
+    assert_false(state.fatal_error);
+    assert_that(state.command->exit_code, is_equal_to(1));
+    assert_that(message, contains_string("~nosuchuserxyz/file: "));
+    destroy_command(&environ, state.command);
+    free(state.command);
+    state.stderr = stderr;
+    destroy_state(&environ, &error, &state);
+}
+
 Ensure(command, destroy_command)
 {
     test_destroy_command("ls");
@@ -270,6 +404,7 @@ static void test_destroy_command(const char *expected_line)
 {
     struct state state;
 
+    memset(&state, 0, sizeof(state));
     state.stdin = NULL;
     state.stdout = NULL;
     state.stderr = NULL;
@@ -281,9 +416,8 @@ static void test_destroy_command(const char *expected_line)
     assert_that(state.command->line, is_null);
     assert_that(state.command->command, is_null);
     assert_that(state.command->argv, is_null);
-    assert_that(state.command->stdin_file, is_null);
-    assert_that(state.command->stdout_file, is_null);
-    assert_that(state.command->stderr_file, is_null);
+    assert_that(state.command->redirections, is_null);
+    assert_that(state.command->redirection_count, is_equal_to(0));
     destroy_state(&environ, &error, &state);
 }
 
@@ -292,7 +426,8 @@ TestSuite *command_tests(void)
     TestSuite *suite;
 
     suite = create_test_suite();
-//    add_test_with_context(suite, command, parse_command);
+    add_test_with_context(suite, command, parse_command);
+    add_test_with_context(suite, command, redirections);
     add_test_with_context(suite, command, destroy_command);
 
     return suite;
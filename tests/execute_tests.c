@@ -1,11 +1,15 @@
 #include "tests.h"
 #include "execute.h"
 #include <dc_util/strings.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-static void test_execute(const char *cmd, size_t argc, char **argv, char **path, bool check_exit_code, int expected_exit_code, const char *out_file_name, const char *err_file_name);
+static void test_execute_backend(enum spawn_backend backend);
+static void test_execute(enum spawn_backend backend, const char *cmd, size_t argc, char **argv, char **path, bool check_exit_code, int expected_exit_code, const char *out_file_name, const char *err_file_name);
 static void check_redirection(const char *file_name);
+static void test_exec_plan(const char *cmd, char **path, const char *expected_file, int expected_error);
+static void test_redirections(enum spawn_backend backend);
 
 Describe(execute);
 
@@ -24,6 +28,164 @@ AfterEach(execute)
 }
 
 Ensure(execute, execute)
+{
+    test_execute_backend(SPAWN_POSIX_SPAWN);
+    test_execute_backend(SPAWN_VFORK);
+    test_execute_backend(SPAWN_FORK);
+}
+
+Ensure(execute, redirections)
+{
+    test_redirections(SPAWN_POSIX_SPAWN);
+    test_redirections(SPAWN_VFORK);
+    test_redirections(SPAWN_FORK);
+}
+
+Ensure(execute, exec_plan)
+{
+    struct exec_plan plan;
+    struct command command;
+    char **path;
+    char **argv;
+    int pipe_fds[3] = {-1, 42, -1};
+
+    path = dc_strs_to_array(&environ, &error, 4, "/nonexistent", "/", "/bin", NULL);
+    test_exec_plan("sh", path, "/bin/sh", 0);
+    test_exec_plan("/bin/sh", path, "/bin/sh", 0);
+    test_exec_plan("nosuchcommandxyz", path, "", ENOENT);
+    // a directory in the path is not something to run
+    test_exec_plan("tmp", path, "", EACCES);
+    test_exec_plan("nosuchcommandxyz/x", path, "nosuchcommandxyz/x", 0);
+
+    // the pipe is dup2d first, so a redirection of the same descriptor wins over it
+    argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup("cat");
+    command.argc = 1;
+    command.argv = argv;
+    command_add_redirection(&environ, &error, &command, REDIRECT_INPUT, 0, strdup("/dev/null"), -1);
+    exec_plan_init(&environ, &error, &plan, &command, path, pipe_fds);
+    assert_false(dc_error_has_error(&error));
+    assert_that(plan.error, is_equal_to(0));
+    assert_that(plan.argv[0], is_equal_to_string("cat"));
+    assert_that(plan.dup_count, is_equal_to(2));
+    assert_that(plan.dups[0].from, is_equal_to(42));
+    assert_that(plan.dups[0].to, is_equal_to(1));
+    assert_false(plan.dups[0].opened);
+    assert_that(plan.dups[1].from, is_greater_than(2));
+    assert_that(plan.dups[1].to, is_equal_to(0));
+    assert_true(plan.dups[1].opened);
+    exec_plan_destroy(&environ, &error, &plan);
+    assert_that(plan.dups, is_null);
+    command.argv[0] = NULL;
+    destroy_command(&environ, &command);
+
+    dc_strs_destroy_array(&environ, 4, path);
+    free(path);
+}
+
+static void test_exec_plan(const char *cmd, char **path, const char *expected_file, int expected_error)
+{
+    struct exec_plan plan;
+    struct command command;
+    static const int no_pipe[3] = {-1, -1, -1};
+
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup(cmd);
+    command.argc = 1;
+    command.argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    exec_plan_init(&environ, &error, &plan, &command, path, no_pipe);
+    assert_false(dc_error_has_error(&error));
+    assert_that(plan.error, is_equal_to(expected_error));
+    assert_that(plan.file, is_equal_to_string(expected_file));
+    assert_that(plan.dup_count, is_equal_to(0));
+    assert_that(plan.envp, is_not_null);
+    exec_plan_destroy(&environ, &error, &plan);
+    command.argv[0] = NULL;
+    destroy_command(&environ, &command);
+}
+
+static void test_redirections(enum spawn_backend backend)
+{
+    struct command command;
+    char **path;
+    char template[32];
+    char out[64];
+    char *text;
+    FILE *file;
+    int fd;
+
+    path = dc_strs_to_array(&environ, &error, 3, "/bin", "/usr/bin", NULL);
+    strcpy(template, "/tmp/redirectXXXXXX");
+    fd = mkstemp(template);
+    close(fd);
+
+    // <<<hi >file 2>&1 5>>file in one child, applied in order
+    memset(&command, 0, sizeof(struct command));
+    command.command = strdup("sh");
+    command.argc = 3;
+    command.argv = dc_strs_to_array(&environ, &error, 4, NULL, "-c", "cat; echo e >&2; echo f >&5", NULL);
+    command_add_redirection(&environ, &error, &command, REDIRECT_HERE_STRING, 0, strdup("hi"), -1);
+    command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 1, strdup(template), -1);
+    command_add_redirection(&environ, &error, &command, REDIRECT_DUP, 2, NULL, 1);
+    command_add_redirection(&environ, &error, &command, REDIRECT_APPEND, 5, strdup(template), -1);
+    execute(&environ, &error, &command, path, backend);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(0));
+    memset(out, 0, sizeof(out));
+    file = fopen(template, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    assert_that(out, is_equal_to_string("hi\ne\nf\n"));
+
+    // a copy of a descriptor that is not open fails like a file that cannot be opened, without a child
+    command.redirections[2].target_fd = 99;
+    execute(&environ, &error, &command, path, backend);
+    assert_false(dc_error_has_error(&error));
+    assert_that(command.exit_code, is_equal_to(1));
+
+    // a closed descriptor is closed in the child
+    free(command.redirections[3].target);
+    command.redirection_count = 2;
+    command.redirections[1].type = REDIRECT_CLOSE;
+    free(command.argv[2]);
+    command.argv[2] = strdup("[ -e /dev/fd/1 ]; echo $? >&2");
+    command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 2, strdup(template), -1);
+    execute(&environ, &error, &command, path, backend);
+    memset(out, 0, sizeof(out));
+    file = fopen(template, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    assert_that(out, is_equal_to_string("1\n"));
+
+    // a here-document too big for a pipe is a sealed memfd, which still reads from the start
+    for(size_t i = 0; i < command.redirection_count; i++)
+    {
+        free(command.redirections[i].target);
+    }
+
+    command.redirection_count = 0;
+    free(command.argv[2]);
+    command.argv[2] = strdup("wc -c");
+    text = malloc(PIPE_BUF * 4 + 1);
+    memset(text, 'x', PIPE_BUF * 4);
+    text[PIPE_BUF * 4] = '\0';
+    command_add_redirection(&environ, &error, &command, REDIRECT_HERE_DOC, 0, text, -1);
+    command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 1, strdup(template), -1);
+    execute(&environ, &error, &command, path, backend);
+    memset(out, 0, sizeof(out));
+    file = fopen(template, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    assert_that(atoi(out), is_equal_to(PIPE_BUF * 4));
+
+    unlink(template);
+    destroy_command(&environ, &command);
+    dc_strs_destroy_array(&environ, 3, path);
+    free(path);
+}
+
+static void test_execute_backend(enum spawn_backend backend)
 {
     char **path;
     char **argv;
@@ -32,15 +194,25 @@ Ensure(execute, execute)
     path = dc_strs_to_array(&environ, &error, 3, "/bin", "/usr/bin", NULL);
 
     argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
-    test_execute("pwd", 1, argv, path, true, 0, NULL, NULL);
+    test_execute(backend, "pwd", 1, argv, path, true, 0, NULL, NULL);
 
     argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
     strcpy(template, "/tmp/fileXXXXXX");
-    test_execute("ls", 1, argv, path, true, 0, template, NULL);
+    test_execute(backend, "ls", 1, argv, path, true, 0, template, NULL);
 
     argv = dc_strs_to_array(&environ, &error, 3, NULL, "asdasdasdfddfgsdfgasderdfdsf", NULL);
     strcpy(template, "/tmp/fileXXXXXX");
-    test_execute("ls", 2, argv, path, false, ENOENT, NULL, template);
+    test_execute(backend, "ls", 2, argv, path, false, ENOENT, NULL, template);
+
+    // a program's own exit code is never mistaken for a failed exec, that is only 126 or 127
+    argv = dc_strs_to_array(&environ, &error, 4, NULL, "-c", "exit 7", NULL);
+    test_execute(backend, "sh", 3, argv, path, true, 7, NULL, NULL);
+
+    argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    test_execute(backend, "/etc/passwd", 1, argv, path, true, 126, NULL, NULL);
+
+    argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
+    test_execute(backend, "/nonexistent/ls", 1, argv, path, true, 127, NULL, NULL);
 
     dc_strs_destroy_array(&environ, 3, path);
     free(path);
@@ -48,20 +220,20 @@ Ensure(execute, execute)
     path = dc_strs_to_array(&environ, &error, 1, NULL);
 
     argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
-    test_execute("ls", 1, argv, path, true, 127, NULL, NULL);
+    test_execute(backend, "ls", 1, argv, path, true, 127, NULL, NULL);
 
     dc_strs_destroy_array(&environ, 1, path);
     free(path);
     path = dc_strs_to_array(&environ, &error, 2, "/", NULL);
 
     argv = dc_strs_to_array(&environ, &error, 2, NULL, NULL);
-    test_execute("ls", 1, argv, path, true, 127, NULL, NULL);
+    test_execute(backend, "ls", 1, argv, path, true, 127, NULL, NULL);
 
     dc_strs_destroy_array(&environ, 2, path);
     free(path);
 }
 
-static void test_execute(const char *cmd, size_t argc, char **argv, char **path, bool check_exit_code, int expected_exit_code, const char *out_file_name, const char *err_file_name)
+static void test_execute(enum spawn_backend backend, const char *cmd, size_t argc, char **argv, char **path, bool check_exit_code, int expected_exit_code, const char *out_file_name, const char *err_file_name)
 {
     struct command command;
 
@@ -72,15 +244,15 @@ static void test_execute(const char *cmd, size_t argc, char **argv, char **path,
 
     if(out_file_name)
     {
-        command.stdout_file = strdup(out_file_name);
+        command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 1, strdup(out_file_name), -1);
     }
 
     if(err_file_name)
     {
-        command.stderr_file = strdup(err_file_name);
+        command_add_redirection(&environ, &error, &command, REDIRECT_OUTPUT, 2, strdup(err_file_name), -1);
     }
 
-    execute(&environ, &error, &command, path);
+    execute(&environ, &error, &command, path, backend);
 
     if(check_exit_code)
     {
@@ -114,6 +286,8 @@ TestSuite *execute_tests(void)
 
     suite = create_test_suite();
     add_test_with_context(suite, execute, execute);
+    add_test_with_context(suite, execute, exec_plan);
+    add_test_with_context(suite, execute, redirections);
 
     return suite;
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include "tests.h"
 #include "util.h"
 #include "input.h"
+#include <errno.h>
+#include <unistd.h>
 
 static void test_read_command_line(const char *data, ...);
+static void test_read_here_document(const char *data, const char *delimiter, const char *expected_body,
+                                    const char *expected_rest);
+static struct script *open_script(const char *data, char *path);
+static struct line_reader *open_reader(const char *data, size_t capacity);
 
 Describe(input);
 
@@ -29,6 +35,206 @@ Ensure(input, read_command_line)
     test_read_command_line("./a.out hello < in.txt > out.txt 2>err.txt\n", "./a.out hello < in.txt > out.txt 2>err.txt", NULL);
 }
 
+Ensure(input, read_here_document)
+{
+    test_read_here_document("a\n  b\t\nEOF\nls\n", "EOF", "a\n  b\t\n", "ls\n");
+    test_read_here_document("EOF\n", "EOF", "", NULL);
+    test_read_here_document("EOFX\n EOF\nEOF", "EOF", "EOFX\n EOF\n", NULL);
+    test_read_here_document("x\ny", "EOF", "x\ny", NULL);
+}
+
+Ensure(input, script)
+{
+    struct script *script;
+    const char *line;
+    char path[32];
+    size_t length;
+
+    script = open_script(" echo a \n\ncat <<EOF\nx\n y\nEOF\nlast", path);
+    line = script_read_line(script, &length);
+    assert_that(length, is_equal_to(6));
+    assert_that(strncmp(line, "echo a", length), is_equal_to(0));
+    line = script_read_line(script, &length);
+    assert_that(line, is_not_null);
+    assert_that(length, is_equal_to(0));
+    line = script_read_line(script, &length);
+    assert_that(strncmp(line, "cat <<EOF", length), is_equal_to(0));
+
+    // the body is the lines in the file, up to the delimiter
+    line = script_read_here_document(&environ, script, "EOF", &length);
+    assert_that(length, is_equal_to(5));
+    assert_that(strncmp(line, "x\n y\n", length), is_equal_to(0));
+
+    // the last line has no newline
+    line = script_read_line(script, &length);
+    assert_that(strncmp(line, "last", length), is_equal_to(0));
+    assert_that(length, is_equal_to(4));
+    assert_that(script_read_line(script, &length), is_null);
+    script_close(&environ, &script);
+    assert_that(script, is_null);
+    unlink(path);
+
+    // an empty file has no lines
+    script = open_script("", path);
+    assert_that(script_read_line(script, &length), is_null);
+    script_read_here_document(&environ, script, "EOF", &length);
+    assert_that(length, is_equal_to(0));
+    script_close(&environ, &script);
+    unlink(path);
+
+    script = script_open(&environ, &error, "/no/such/script");
+    assert_that(script, is_null);
+    assert_true(dc_error_is_errno(&error, ENOENT));
+}
+
+Ensure(input, line_reader)
+{
+    struct line_reader *reader;
+    const char *line;
+    char *body;
+    char long_line[200];
+    size_t length;
+
+    reader = open_reader(" echo a \n\ncat <<EOF\nx\n y\nEOF\nlast", 8);
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(length, is_equal_to(6));
+    assert_that(strncmp(line, "echo a", length), is_equal_to(0));
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(line, is_not_null);
+    assert_that(length, is_equal_to(0));
+
+    // the raw line keeps its newline
+    line = line_reader_next_line(&environ, &error, reader, &length);
+    assert_that(length, is_equal_to(10));
+    assert_that(strncmp(line, "cat <<EOF\n", length), is_equal_to(0));
+    body = line_reader_read_here_document(&environ, &error, reader, "EOF", NULL, &length);
+    assert_that(body, is_equal_to_string("x\n y\n"));
+    assert_that(length, is_equal_to(5));
+    free(body);
+
+    // the last line has no newline
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(length, is_equal_to(4));
+    assert_that(strncmp(line, "last", length), is_equal_to(0));
+    assert_that(line_reader_read_line(&environ, &error, reader, &length), is_null);
+    assert_false(dc_error_has_error(&error));
+    close(reader->fd);
+    line_reader_destroy(&environ, &reader);
+    assert_that(reader, is_null);
+
+    // a line longer than the buffer grows it
+    memset(long_line, 'a', sizeof(long_line) - 2);
+    long_line[sizeof(long_line) - 2] = '\n';
+    long_line[sizeof(long_line) - 1] = '\0';
+    reader = open_reader(long_line, 16);
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(length, is_equal_to(sizeof(long_line) - 2));
+    assert_that(line[0], is_equal_to('a'));
+    assert_that(reader->capacity, is_greater_than(sizeof(long_line) - 2));
+    assert_that(line_reader_read_line(&environ, &error, reader, &length), is_null);
+    close(reader->fd);
+    line_reader_destroy(&environ, &reader);
+
+    reader = open_reader("", 16);
+    assert_that(line_reader_read_line(&environ, &error, reader, &length), is_null);
+    assert_false(dc_error_has_error(&error));
+    close(reader->fd);
+    line_reader_destroy(&environ, &reader);
+}
+
+Ensure(input, line_reader_pipe)
+{
+    struct line_reader *reader;
+    const char *line;
+    size_t length;
+    int fds[2];
+
+    assert_that(pipe(fds), is_equal_to(0));
+    reader = line_reader_create(&environ, &error, fds[0], LINE_READER_CAPACITY);
+    assert_false(line_reader_has_line(reader));
+
+    // half a line is not a line, the rest of it is searched without the start
+    assert_that(write(fds[1], "ech", 3), is_equal_to(3));
+    assert_that(write(fds[1], "o a\nec", 6), is_equal_to(6));
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(strncmp(line, "echo a", length), is_equal_to(0));
+    assert_false(line_reader_has_line(reader));
+    assert_that(write(fds[1], "ho b\n", 5), is_equal_to(5));
+    close(fds[1]);
+    line = line_reader_read_line(&environ, &error, reader, &length);
+    assert_that(length, is_equal_to(6));
+    assert_that(strncmp(line, "echo b", length), is_equal_to(0));
+    assert_that(line_reader_read_line(&environ, &error, reader, &length), is_null);
+    assert_true(line_reader_has_line(reader));
+    assert_false(dc_error_has_error(&error));
+    close(fds[0]);
+    line_reader_destroy(&environ, &reader);
+}
+
+static struct line_reader *open_reader(const char *data, size_t capacity)
+{
+    struct line_reader *reader;
+    char path[] = "/tmp/readerXXXXXX";
+    int fd;
+
+    fd = mkstemp(path);
+    assert_that(write(fd, data, strlen(data)), is_equal_to(strlen(data)));
+    lseek(fd, 0, SEEK_SET);
+    unlink(path);
+    reader = line_reader_create(&environ, &error, fd, capacity);
+    assert_false(dc_error_has_error(&error));
+    assert_that(reader, is_not_null);
+
+    return reader;
+}
+
+static struct script *open_script(const char *data, char *path)
+{
+    struct script *script;
+    int fd;
+
+    strcpy(path, "/tmp/scriptXXXXXX");
+    fd = mkstemp(path);
+    assert_that(write(fd, data, strlen(data)), is_equal_to(strlen(data)));
+    close(fd);
+    script = script_open(&environ, &error, path);
+    assert_false(dc_error_has_error(&error));
+    assert_that(script, is_not_null);
+
+    return script;
+}
+
+static void test_read_here_document(const char *data, const char *delimiter, const char *expected_body,
+                                    const char *expected_rest)
+{
+    FILE *strstream;
+    char *str;
+    char *body;
+    char rest[64];
+    size_t length;
+
+    str = strdup(data);
+    strstream = fmemopen(str, strlen(data), "r");
+    body = read_here_document(&environ, &error, strstream, delimiter, NULL, &length);
+    assert_false(dc_error_has_error(&error));
+    assert_that(body, is_equal_to_string(expected_body));
+    assert_that(length, is_equal_to(strlen(expected_body)));
+
+    if(expected_rest == NULL)
+    {
+        assert_that(fgets(rest, sizeof(rest), strstream), is_null);
+    }
+    else
+    {
+        assert_that(fgets(rest, sizeof(rest), strstream), is_not_null);
+        assert_that(rest, is_equal_to_string(expected_rest));
+    }
+
+    free(body);
+    fclose(strstream);
+    free(str);
+}
+
 static void test_read_command_line(const char *data, ...)
 {
     FILE *strstream;
@@ -79,6 +285,10 @@ TestSuite *input_tests(void)
 
     suite = create_test_suite();
     add_test_with_context(suite, input, read_command_line);
+    add_test_with_context(suite, input, read_here_document);
+    add_test_with_context(suite, input, script);
+    add_test_with_context(suite, input, line_reader);
+    add_test_with_context(suite, input, line_reader_pipe);
 
     return suite;
 }
@@ -0,0 +1,248 @@
+#include "tests.h"
+#include "jobs.h"
+#include "shell_impl.h"
+#include "state.h"
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+static pid_t start_child(int exit_code, long delay_ms);
+static void add_child_job(struct job_table *table, int exit_code, long delay_ms, int expected_id);
+static void run_line(struct state *state, const char *line, int expected_exit_code);
+static double elapsed(const struct timeval *start);
+
+Describe(jobs);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+
+BeforeEach(jobs)
+{
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+}
+
+AfterEach(jobs)
+{
+    dc_error_reset(&error);
+}
+
+Ensure(jobs, job_table)
+{
+    struct job_table *table;
+    struct job *job;
+    char pid[32];
+    char out[256];
+    FILE *stream;
+
+    table = job_table_create(&environ, &error, 0);
+    assert_false(dc_error_has_error(&error));
+    assert_that(job_table_running(table), is_equal_to(0));
+
+    add_child_job(table, 3, 0, 1);
+    assert_that(job_table_running(table), is_equal_to(1));
+    sprintf(pid, "%d", table->jobs[0].pids[0]);
+    job_table_wait(&environ, &error, table);
+    assert_false(dc_error_has_error(&error));
+    assert_that(job_table_running(table), is_equal_to(0));
+    assert_that(job_table_find(table, "%1"), is_equal_to(&table->jobs[0]));
+    assert_that(job_table_find(table, pid), is_equal_to(&table->jobs[0]));
+    assert_that(job_table_find(table, "%2"), is_null);
+    assert_that(job_table_find(table, "x"), is_null);
+    assert_that(job_table_find_done(table), is_equal_to(&table->jobs[0]));
+    assert_that(job_status(&table->jobs[0]), is_equal_to(3));
+
+    // the next id is one more than the highest, whatever finished in between
+    add_child_job(table, 0, 200, 2);
+    memset(out, 0, sizeof(out));
+    stream = fmemopen(out, sizeof(out), "w");
+    job_table_report(&environ, table, stream);
+    fclose(stream);
+    assert_that(out, is_equal_to_string("[1]  Exit 3     job\n[2]  Running    job\n"));
+    assert_that(table->count, is_equal_to(1));
+
+    job = job_table_find(table, "%2");
+    assert_that(job, is_not_null);
+
+    while(job->running > 0){
+        job_table_wait(&environ, &error, table);
+    }
+
+    assert_that(job_status(job), is_equal_to(0));
+    job_table_remove(&environ, table, job);
+    assert_that(table->count, is_equal_to(0));
+
+    // nothing is running, so it does not block
+    job_table_wait(&environ, &error, table);
+    assert_false(dc_error_has_error(&error));
+    job_table_destroy(&environ, &table);
+    assert_that(table, is_null);
+}
+
+Ensure(jobs, grow)
+{
+    struct job_table *table;
+
+    table = job_table_create(&environ, &error, 0);
+
+    for(int i = 0; i < JOB_TABLE_INITIAL_CAPACITY * 2 + 1; i++){
+        add_child_job(table, i, 0, i + 1);
+    }
+
+    while(job_table_running(table) > 0){
+        job_table_wait(&environ, &error, table);
+    }
+
+    for(size_t i = 0; i < table->count; i++){
+        assert_that(job_status(&table->jobs[i]), is_equal_to((int)i));
+    }
+
+    job_table_destroy(&environ, &table);
+}
+
+Ensure(jobs, max_running)
+{
+    struct job_table *table;
+    struct timeval start;
+
+    table = job_table_create(&environ, &error, 2);
+    add_child_job(table, 0, 200, 1);
+    add_child_job(table, 0, 200, 2);
+    gettimeofday(&start, NULL);
+    job_table_wait_for_slot(&environ, &error, table);
+    assert_false(dc_error_has_error(&error));
+    assert_that(job_table_running(table), is_less_than(2));
+    assert_that_double(elapsed(&start), is_greater_than_double(0.1));
+    job_table_destroy(&environ, &table);
+}
+
+Ensure(jobs, background)
+{
+    struct state state;
+    struct timeval start;
+    char out[1024];
+
+    memset(&state, 0, sizeof(state));
+    memset(out, 0, sizeof(out));
+    state.stdin = stdin;
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = stderr;
+    init_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+
+    run_line(&state, "sh -c 'exit 4' &", 0);
+    assert_that(state.jobs->count, is_equal_to(1));
+    run_line(&state, "wait %1", 4);
+    assert_that(state.jobs->count, is_equal_to(0));
+    run_line(&state, "wait -n", 127);
+    run_line(&state, "wait %1", 127);
+
+    // the jobs run at the same time
+    gettimeofday(&start, NULL);
+    run_line(&state, "sleep 0.3 & sleep 0.3 & sh -c 'exit 2' | true &", 0);
+    assert_that(state.jobs->count, is_equal_to(3));
+    run_line(&state, "wait -n", 0);
+    run_line(&state, "jobs", 0);
+    run_line(&state, "wait", 0);
+    assert_that_double(elapsed(&start), is_less_than_double(0.55));
+    assert_that(state.jobs->count, is_equal_to(0));
+    fflush(state.stdout);
+    assert_that(out, is_equal_to_string("[1]  Running    sleep 0.3\n[2]  Running    sleep 0.3\n"));
+
+    // a job does not read the input of the shell
+    run_line(&state, "cat & wait -n", 0);
+
+    fclose(state.stdout);
+    state.stdout = stdout;
+    destroy_state(&environ, &error, &state);
+}
+
+Ensure(jobs, max_jobs)
+{
+    struct state state;
+    struct timeval start;
+
+    memset(&state, 0, sizeof(state));
+    state.stdin = stdin;
+    state.stdout = stdout;
+    state.stderr = stderr;
+    state.settings.max_jobs = 1;
+    init_state(&environ, &error, &state);
+
+    // the second job waits for the first to finish before it starts
+    gettimeofday(&start, NULL);
+    run_line(&state, "sleep 0.2 & sleep 0.2 &", 0);
+    assert_that_double(elapsed(&start), is_greater_than_double(0.15));
+    run_line(&state, "wait", 0);
+    assert_that_double(elapsed(&start), is_greater_than_double(0.35));
+
+    destroy_state(&environ, &error, &state);
+}
+
+static pid_t start_child(int exit_code, long delay_ms)
+{
+    pid_t pid;
+
+    pid = fork();
+
+    if(pid == 0){
+        struct timespec delay;
+
+        delay.tv_sec = delay_ms / 1000;
+        delay.tv_nsec = (delay_ms % 1000) * 1000000;
+        nanosleep(&delay, NULL);
+        _exit(exit_code);
+    }
+
+    return pid;
+}
+
+static void add_child_job(struct job_table *table, int exit_code, long delay_ms, int expected_id)
+{
+    pid_t pid;
+    int code;
+    int id;
+
+    pid = start_child(exit_code, delay_ms);
+    code = JOB_RUNNING;
+    id = job_table_add(&environ, &error, table, "job", &pid, &code, 1, false);
+    assert_false(dc_error_has_error(&error));
+    assert_that(id, is_equal_to(expected_id));
+}
+
+static void run_line(struct state *state, const char *line, int expected_exit_code)
+{
+    state->current_line = strdup(line);
+    state->current_line_length = strlen(line);
+    separate_commands(&environ, &error, state);
+    parse_commands(&environ, &error, state);
+    execute_commands(&environ, &error, state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(state->exit_code, is_equal_to(expected_exit_code));
+    free(state->current_line);
+    state->current_line = NULL;
+    reset_state(&environ, &error, state);
+}
+
+static double elapsed(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+TestSuite *jobs_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, jobs, job_table);
+    add_test_with_context(suite, jobs, grow);
+    add_test_with_context(suite, jobs, max_running);
+    add_test_with_context(suite, jobs, background);
+    add_test_with_context(suite, jobs, max_jobs);
+
+    return suite;
+}
@@ -0,0 +1,132 @@
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static char *argument_list(size_t length);
+static double lex(const char *line, size_t length, enum lexer_scanner scanner, size_t rounds, size_t *tokens);
+
+/**
+ * Lex a line as long as the longest command line (_SC_ARG_MAX) of plain, quoted and escaped
+ * arguments with each scanner the CPU can run, and print the throughput of each. The fastest of
+ * the rounds is kept, so another process taking the CPU for a while does not count.
+ *
+ * usage: lexer_benchmark [rounds]
+ */
+int main(int argc, char *argv[]){
+    static const char *const names[] = {"scalar", "sse2", "avx2"};
+    char *line;
+    long arg_max;
+    size_t length;
+    size_t rounds;
+
+    arg_max = sysconf(_SC_ARG_MAX);
+    length = arg_max > 0 ? (size_t)arg_max : 2097152;
+    rounds = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 20;
+    line = argument_list(length);
+
+    if(line == NULL){
+        perror("lexer_benchmark");
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu bytes, %zu rounds\n", length, rounds);
+
+    for(int scanner = LEXER_SCAN_SCALAR; scanner <= LEXER_SCAN_AVX2; scanner++){
+        double seconds;
+        size_t tokens = 0;
+
+        if(!lexer_has_scanner((enum lexer_scanner)scanner)){
+            continue;
+        }
+
+        seconds = lex(line, length, (enum lexer_scanner)scanner, rounds, &tokens);
+        printf("%-7s %9.1f MB/s %9zu tokens\n", names[scanner], (double)length / seconds / 1000000.0, tokens);
+    }
+
+    free(line);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Make a line of arguments like the ones of a long command (file names, options, quoted text).
+ *
+ * @param length the length of the line.
+ * @return the line, not NUL terminated, free it with free.
+ */
+static char *argument_list(size_t length){
+    static const char *const arguments[] = {"src/some/directory/file_name.c", "--option=value",
+                                            "'a quoted argument'", "\"double $quoted\"", "escaped\\ space", "x"};
+    char *line;
+    size_t used;
+    size_t i;
+
+    line = malloc(length);
+
+    if(line == NULL){
+        return NULL;
+    }
+
+    used = 0;
+    i = 0;
+
+    while(used < length){
+        const char *argument = arguments[i++ % (sizeof(arguments) / sizeof(arguments[0]))];
+        size_t n = strlen(argument);
+
+        if(used + n + 1 > length){
+            break;
+        }
+
+        memcpy(&line[used], argument, n);
+        line[used + n] = ' ';
+        used += n + 1;
+    }
+
+    memset(&line[used], ' ', length - used);
+
+    return line;
+}
+
+/**
+ * Lex the line to the end a number of times.
+ *
+ * @param line the line.
+ * @param length the length of the line.
+ * @param scanner the scanner to use.
+ * @param rounds the number of times to lex the line.
+ * @param tokens set to the number of tokens on the line.
+ * @return the seconds the fastest round took.
+ */
+static double lex(const char *line, size_t length, enum lexer_scanner scanner, size_t rounds, size_t *tokens){
+    double best = 0;
+
+    for(size_t round = 0; round < rounds; round++){
+        struct lexer lexer;
+        struct token token;
+        struct timespec start;
+        struct timespec end;
+        double seconds;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        lexer_init(&lexer, line, length);
+        lexer.scanner = scanner;
+        *tokens = 0;
+
+        while(lexer_next(&lexer, &token) != TOKEN_END){
+            (*tokens)++;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+        if(round == 0 || seconds < best){
+            best = seconds;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,175 @@
+#include "tests.h"
+#include "lexer.h"
+
+static void test_lexer_next(const char *line, ...);
+static void test_lexer_unquote(const char *word, const char *expected_word);
+static void test_scanners(const char *line, size_t length);
+
+Describe(lexer);
+
+BeforeEach(lexer)
+{
+}
+
+AfterEach(lexer)
+{
+}
+
+Ensure(lexer, lexer_next)
+{
+    test_lexer_next("", TOKEN_END);
+    test_lexer_next(" \t\f\v", TOKEN_END);
+    test_lexer_next("hello", TOKEN_WORD, "hello", TOKEN_END);
+    test_lexer_next("  a b\tc ", TOKEN_WORD, "a", TOKEN_WORD, "b", TOKEN_WORD, "c", TOKEN_END);
+    test_lexer_next("./a.out < in.txt", TOKEN_WORD, "./a.out", TOKEN_REDIRECT_IN, "<", TOKEN_WORD, "in.txt", TOKEN_END);
+    test_lexer_next("ls>out", TOKEN_WORD, "ls", TOKEN_REDIRECT_OUT, ">", TOKEN_WORD, "out", TOKEN_END);
+    test_lexer_next("ls >> out", TOKEN_WORD, "ls", TOKEN_APPEND_OUT, ">>", TOKEN_WORD, "out", TOKEN_END);
+    test_lexer_next("ls 1> out 1>>out", TOKEN_WORD, "ls", TOKEN_REDIRECT_OUT, "1>", TOKEN_WORD, "out", TOKEN_APPEND_OUT, "1>>", TOKEN_WORD, "out", TOKEN_END);
+    test_lexer_next("./a.out 2>err.txt", TOKEN_WORD, "./a.out", TOKEN_REDIRECT_ERR, "2>", TOKEN_WORD, "err.txt", TOKEN_END);
+    test_lexer_next("./a.out 2>>    err.txt", TOKEN_WORD, "./a.out", TOKEN_APPEND_ERR, "2>>", TOKEN_WORD, "err.txt", TOKEN_END);
+    test_lexer_next("a2>x 22", TOKEN_WORD, "a2", TOKEN_REDIRECT_OUT, ">", TOKEN_WORD, "x", TOKEN_WORD, "22", TOKEN_END);
+    test_lexer_next("cmd 0<in 10>out 3>>log", TOKEN_WORD, "cmd", TOKEN_REDIRECT_IN, "0<", TOKEN_WORD, "in", TOKEN_REDIRECT_OUT, "10>", TOKEN_WORD, "out", TOKEN_APPEND_OUT, "3>>", TOKEN_WORD, "log", TOKEN_END);
+    test_lexer_next("cmd >out 2>&1 <&3 4>&-", TOKEN_WORD, "cmd", TOKEN_REDIRECT_OUT, ">", TOKEN_WORD, "out", TOKEN_DUP_OUT, "2>&", TOKEN_WORD, "1", TOKEN_DUP_IN, "<&", TOKEN_WORD, "3", TOKEN_DUP_OUT, "4>&", TOKEN_WORD, "-", TOKEN_END);
+    test_lexer_next("cat <<<'a b' 3<<<x", TOKEN_WORD, "cat", TOKEN_HERE_STRING, "<<<", TOKEN_WORD, "'a b'", TOKEN_HERE_STRING, "3<<<", TOKEN_WORD, "x", TOKEN_END);
+    test_lexer_next("cat <<EOF 3<< 'E F'", TOKEN_WORD, "cat", TOKEN_HERE_DOC, "<<", TOKEN_WORD, "EOF", TOKEN_HERE_DOC, "3<<", TOKEN_WORD, "'E F'", TOKEN_END);
+    test_lexer_next("echo \"a b\" 'c > d'", TOKEN_WORD, "echo", TOKEN_WORD, "\"a b\"", TOKEN_WORD, "'c > d'", TOKEN_END);
+    test_lexer_next("echo a\\ b\\>c", TOKEN_WORD, "echo", TOKEN_WORD, "a\\ b\\>c", TOKEN_END);
+    test_lexer_next("echo \"abc", TOKEN_WORD, "echo", TOKEN_ERROR, "\"abc", TOKEN_END);
+    test_lexer_next("ls | wc", TOKEN_WORD, "ls", TOKEN_PIPE, "|", TOKEN_WORD, "wc", TOKEN_END);
+    test_lexer_next("a|b>c|d", TOKEN_WORD, "a", TOKEN_PIPE, "|", TOKEN_WORD, "b", TOKEN_REDIRECT_OUT, ">", TOKEN_WORD, "c", TOKEN_PIPE, "|", TOKEN_WORD, "d", TOKEN_END);
+    test_lexer_next("a;b && c||d", TOKEN_WORD, "a", TOKEN_SEQUENCE, ";", TOKEN_WORD, "b", TOKEN_AND, "&&", TOKEN_WORD, "c", TOKEN_OR, "||", TOKEN_WORD, "d", TOKEN_END);
+    test_lexer_next("a&b a&&b &", TOKEN_WORD, "a", TOKEN_BACKGROUND, "&", TOKEN_WORD, "b", TOKEN_WORD, "a", TOKEN_AND, "&&", TOKEN_WORD, "b", TOKEN_BACKGROUND, "&", TOKEN_END);
+    test_lexer_next("sleep 1 &&& a\\&b", TOKEN_WORD, "sleep", TOKEN_WORD, "1", TOKEN_AND, "&&", TOKEN_BACKGROUND, "&", TOKEN_WORD, "a\\&b", TOKEN_END);
+    test_lexer_next("echo 'a;b' \"c&&d\"", TOKEN_WORD, "echo", TOKEN_WORD, "'a;b'", TOKEN_WORD, "\"c&&d\"", TOKEN_END);
+    test_lexer_next("echo 'a|b' c\\|d", TOKEN_WORD, "echo", TOKEN_WORD, "'a|b'", TOKEN_WORD, "c\\|d", TOKEN_END);
+}
+
+static void test_lexer_next(const char *line, ...)
+{
+    struct lexer lexer;
+    struct token token;
+    va_list tokens;
+    enum token_type expected_type;
+
+    lexer_init(&lexer, line, strlen(line));
+    va_start(tokens, line);
+
+    do
+    {
+        expected_type = va_arg(tokens, enum token_type);
+        lexer_next(&lexer, &token);
+        assert_that(token.type, is_equal_to(expected_type));
+
+        if(expected_type != TOKEN_END)
+        {
+            const char *expected_text;
+
+            expected_text = va_arg(tokens, const char *);
+            assert_that(token.length, is_equal_to(strlen(expected_text)));
+            assert_that(strncmp(token.text, expected_text, token.length), is_equal_to(0));
+        }
+    }
+    while(expected_type != TOKEN_END && expected_type != TOKEN_ERROR);
+
+    va_end(tokens);
+}
+
+Ensure(lexer, scanners)
+{
+    static const char *const pieces[] = {"a", "bc", " ", "\t", "\n", "'q r'", "\"s\\\"t\"", "\\ ", "<", ">>", "2>&1",
+                                         "|", "||", ";", "&", "&&", "\xC3\xA9", "\x89", "$x", "0123456789abcdef"};
+    char line[1024];
+    size_t length;
+    unsigned seed;
+
+    // a special character at every offset of a block, and words that span blocks
+    seed = 1;
+    length = 0;
+
+    while(length < sizeof(line) - 32){
+        const char *piece;
+
+        seed = seed * 1103515245 + 12345;
+        piece = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+        memcpy(&line[length], piece, strlen(piece));
+        length += strlen(piece);
+    }
+
+    for(size_t end = length - 40; end <= length; end++){
+        test_scanners(line, end);
+    }
+
+    // a long word that only ends at the end of the line, and one in single quotes that does not end
+    memset(line, 'w', sizeof(line));
+    test_scanners(line, sizeof(line));
+    line[0] = '\'';
+    test_scanners(line, sizeof(line));
+}
+
+static void test_scanners(const char *line, size_t length)
+{
+    static const enum lexer_scanner scanners[] = {LEXER_SCAN_SSE2, LEXER_SCAN_AVX2};
+    struct lexer scalar;
+    struct lexer lexer;
+    struct token expected;
+    struct token token;
+
+    // every scanner gives the tokens of the scalar one, a scanner the CPU does not have is skipped
+    for(size_t i = 0; i < sizeof(scanners) / sizeof(scanners[0]); i++)
+    {
+        if(!lexer_has_scanner(scanners[i]))
+        {
+            continue;
+        }
+
+        lexer_init(&scalar, line, length);
+        scalar.scanner = LEXER_SCAN_SCALAR;
+        lexer_init(&lexer, line, length);
+        lexer.scanner = scanners[i];
+
+        do
+        {
+            lexer_next(&scalar, &expected);
+            lexer_next(&lexer, &token);
+            assert_that(token.type, is_equal_to(expected.type));
+            assert_that(token.text, is_equal_to(expected.text));
+            assert_that(token.length, is_equal_to(expected.length));
+        }
+        while(expected.type != TOKEN_END && expected.type != TOKEN_ERROR);
+    }
+}
+
+Ensure(lexer, lexer_unquote)
+{
+    test_lexer_unquote("hello", "hello");
+    test_lexer_unquote("\"a b\"", "a b");
+    test_lexer_unquote("'c > d'", "c > d");
+    test_lexer_unquote("a\\ b", "a b");
+    test_lexer_unquote("x\"y\"'z'", "xyz");
+    test_lexer_unquote("\"\\\"q\\\" \\n\"", "\"q\" \\n");
+    test_lexer_unquote("'\\n'", "\\n");
+}
+
+static void test_lexer_unquote(const char *word, const char *expected_word)
+{
+    char *text;
+    size_t length;
+
+    text = strdup(word);
+    length = lexer_unquote(text, text, strlen(text));
+    assert_that(text, is_equal_to_string(expected_word));
+    assert_that(length, is_equal_to(strlen(expected_word)));
+    free(text);
+}
+
+TestSuite *lexer_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, lexer, lexer_next);
+    add_test_with_context(suite, lexer, scanners);
+    add_test_with_context(suite, lexer, lexer_unquote);
+
+    return suite;
+}
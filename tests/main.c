@@ -9,13 +9,20 @@ int main(int argc, char **argv)
 
     suite    = create_test_suite();
     reporter = create_text_reporter();
-//    add_suite(suite, builtin_tests());
-//    add_suite(suite, command_tests());
-//    add_suite(suite, execute_tests());
-//    add_suite(suite, input_tests());
+    add_suite(suite, arena_tests());
+    add_suite(suite, builtin_tests());
+    add_suite(suite, command_tests());
+    add_suite(suite, execute_tests());
+    add_suite(suite, input_tests());
+    add_suite(suite, jobs_tests());
+    add_suite(suite, lexer_tests());
+    add_suite(suite, parallel_tests());
+    add_suite(suite, path_cache_tests());
+    add_suite(suite, pipeline_tests());
+    add_suite(suite, reactor_tests());
     add_suite(suite, shell_impl_tests());
 //    add_suite(suite, shell_tests());
-//    add_suite(suite, util_tests());
+    add_suite(suite, util_tests());
 
 
     if(argc > 1)
@@ -0,0 +1,182 @@
+#include "tests.h"
+#include "parallel.h"
+#include "shell_impl.h"
+#include "state.h"
+#include <sys/time.h>
+#include <unistd.h>
+
+static void test_parallel(const char *line, int expected_exit_code, const char *expected_out, const char *expected_err);
+static double elapsed(const struct timeval *start);
+
+Describe(parallel);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+static struct state state;
+static char out[4096];
+static char err[1024];
+
+BeforeEach(parallel)
+{
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+    memset(&state, 0, sizeof(state));
+    memset(out, 0, sizeof(out));
+    memset(err, 0, sizeof(err));
+    state.stdin = stdin;
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = fmemopen(err, sizeof(err), "w");
+    init_state(&environ, &error, &state);
+}
+
+AfterEach(parallel)
+{
+    fclose(state.stdout);
+    fclose(state.stderr);
+    state.stdout = stdout;
+    state.stderr = stderr;
+    destroy_state(&environ, &error, &state);
+    dc_error_reset(&error);
+}
+
+Ensure(parallel, parallel_run)
+{
+    struct parallel_options options;
+    char echo[] = "echo";
+    char braces[] = "x{}y{}";
+    char no_newline[] = "-n";
+    char a[] = "a";
+    char b[] = "b";
+    char lines[] = "c\nd\n";
+    char *words[] = {echo, braces};
+    char *inputs[] = {a, b};
+
+    memset(&options, 0, sizeof(options));
+    options.words = words;
+    options.word_count = 2;
+    options.inputs = inputs;
+    options.input_count = 2;
+    options.max_procs = 1;
+    assert_that(parallel_run(&environ, &error, &state, &options), is_equal_to(0));
+    assert_false(dc_error_has_error(&error));
+    fflush(state.stdout);
+    assert_that(out, is_equal_to_string("xaya\nxbyb\n"));
+
+    // the lines of a stream are the inputs, added after the words without a {}
+    memset(out, 0, sizeof(out));
+    rewind(state.stdout);
+    words[1] = no_newline;
+    options.inputs = NULL;
+    options.input = fmemopen(lines, 4, "r");
+    assert_that(parallel_run(&environ, &error, &state, &options), is_equal_to(0));
+    fclose(options.input);
+    fflush(state.stdout);
+    assert_that(out, is_equal_to_string("cd"));
+}
+
+Ensure(parallel, builtin_parallel)
+{
+    test_parallel("parallel -j 1 echo ::: a b c", 0, "a\nb\nc\n", "");
+    test_parallel("parallel -j1 -- echo {}.txt :::", 0, "", "");
+    test_parallel("parallel -j 2 sh -c 'exit {}' ::: 0 1 2 0", 2, "", "");
+    test_parallel("parallel nosuchcommandxyz ::: a", 1, "", "parallel: nosuchcommandxyz: command not found\n");
+    test_parallel("parallel", 2, "", "parallel: usage: parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]\n");
+    test_parallel("parallel -j 0 echo ::: a", 2, "", "parallel: usage: parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]\n");
+    test_parallel("parallel -x echo ::: a", 2, "", "parallel: usage: parallel [-j jobs] [-a file] [-v] command [argument...] [::: input...]\n");
+    test_parallel("parallel -a /nonexistent/file echo", 1, "", "parallel: /nonexistent/file: No such file or directory\n");
+}
+
+Ensure(parallel, input_file)
+{
+    char path[] = "/tmp/parallel_testsXXXXXX";
+    char line[64];
+    int fd;
+
+    fd = mkstemp(path);
+    assert_that(write(fd, "a\nb\n", 4), is_equal_to(4));
+    close(fd);
+    snprintf(line, sizeof(line), "parallel -j 1 -a %s echo", path);
+    test_parallel(line, 0, "a\nb\n", "");
+    snprintf(line, sizeof(line), "parallel -j 1 echo < %s", path);
+    test_parallel(line, 0, "a\nb\n", "");
+    unlink(path);
+}
+
+Ensure(parallel, grouped_output)
+{
+    // each child writes, sleeps and writes again, the lines of one never land between those of another
+    test_parallel("parallel -j 3 sh -c 'echo {}1; sleep 0.1; echo {}2; echo {}3 >&2' ::: a b c", 0, NULL, NULL);
+    fflush(state.stdout);
+    fflush(state.stderr);
+    assert_that(strlen(out), is_equal_to(18));
+    assert_that(out, contains_string("a1\na2\n"));
+    assert_that(out, contains_string("b1\nb2\n"));
+    assert_that(out, contains_string("c1\nc2\n"));
+    assert_that(err, contains_string("a3\n"));
+    assert_that(err, contains_string("c3\n"));
+}
+
+Ensure(parallel, max_procs)
+{
+    struct timeval start;
+
+    gettimeofday(&start, NULL);
+    test_parallel("parallel -j 4 sleep ::: 0.2 0.2 0.2 0.2", 0, "", "");
+    assert_that_double(elapsed(&start), is_less_than_double(0.35));
+
+    gettimeofday(&start, NULL);
+    test_parallel("parallel -j 2 sleep ::: 0.2 0.2 0.2 0.2", 0, "", "");
+    assert_that_double(elapsed(&start), is_greater_than_double(0.35));
+}
+
+static void test_parallel(const char *line, int expected_exit_code, const char *expected_out, const char *expected_err)
+{
+    memset(out, 0, sizeof(out));
+    memset(err, 0, sizeof(err));
+    rewind(state.stdout);
+    rewind(state.stderr);
+    state.current_line = strdup(line);
+    state.current_line_length = strlen(line);
+    separate_commands(&environ, &error, &state);
+    parse_commands(&environ, &error, &state);
+    execute_commands(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(state.exit_code, is_equal_to(expected_exit_code));
+    fflush(state.stdout);
+    fflush(state.stderr);
+
+    if(expected_out != NULL){
+        assert_that(out, is_equal_to_string(expected_out));
+    }
+
+    if(expected_err != NULL){
+        assert_that(err, is_equal_to_string(expected_err));
+    }
+
+    free(state.current_line);
+    state.current_line = NULL;
+    reset_state(&environ, &error, &state);
+}
+
+static double elapsed(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+TestSuite *parallel_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, parallel, parallel_run);
+    add_test_with_context(suite, parallel, builtin_parallel);
+    add_test_with_context(suite, parallel, input_file);
+    add_test_with_context(suite, parallel, grouped_output);
+    add_test_with_context(suite, parallel, max_procs);
+
+    return suite;
+}
@@ -0,0 +1,228 @@
+#include "tests.h"
+#include "path_cache.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void make_file(const char *dir, const char *name, mode_t mode);
+static void remove_file(const char *dir, const char *name);
+
+Describe(path_cache);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+static char dir1[32];
+static char dir2[32];
+
+BeforeEach(path_cache)
+{
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+    strcpy(dir1, "/tmp/hashXXXXXX");
+    strcpy(dir2, "/tmp/hashXXXXXX");
+    mkdtemp(dir1);
+    mkdtemp(dir2);
+}
+
+AfterEach(path_cache)
+{
+    rmdir(dir1);
+    rmdir(dir2);
+    dc_error_reset(&error);
+}
+
+Ensure(path_cache, path_cache_lookup)
+{
+    struct path_cache *cache;
+    char *dirs[] = {dir1, dir2, NULL};
+    char expected[64];
+    const struct path_cache_entry *entry;
+
+    make_file(dir1, "plain", 0644);
+    make_file(dir2, "plain", 0755);
+    make_file(dir2, "tool", 0755);
+    cache = path_cache_create(&environ, &error);
+    assert_false(dc_error_has_error(&error));
+    path_cache_validate(&environ, &error, cache, "dirs", dirs);
+    assert_that(cache->dir_count, is_equal_to(2));
+    assert_that(cache->dir_fds[0], is_greater_than(2));
+
+    // not executable in dir1, so dir2 wins
+    entry = path_cache_lookup(&environ, &error, cache, dirs, "plain");
+    sprintf(expected, "%s/plain", dir2);
+    assert_that(entry->path, is_equal_to_string(expected));
+    assert_that(entry->name, is_equal_to_string("plain"));
+    assert_that(entry->dir_fd, is_equal_to(cache->dir_fds[1]));
+    assert_that(cache->misses, is_equal_to(1));
+    assert_that(cache->hits, is_equal_to(0));
+
+    assert_that(path_cache_lookup(&environ, &error, cache, dirs, "plain"), is_equal_to(entry));
+    assert_that(cache->misses, is_equal_to(1));
+    assert_that(cache->hits, is_equal_to(1));
+
+    entry = path_cache_lookup(&environ, &error, cache, dirs, "tool");
+    sprintf(expected, "%s/tool", dir2);
+    assert_that(entry->path, is_equal_to_string(expected));
+    assert_that(cache->count, is_equal_to(2));
+
+    entry = path_cache_lookup(&environ, &error, cache, dirs, "missing");
+    assert_that(entry, is_null);
+    assert_false(dc_error_has_error(&error));
+    assert_that(cache->count, is_equal_to(3));
+    assert_that(cache->negative_count, is_equal_to(1));
+    assert_that(cache->misses, is_equal_to(3));
+
+    // not found is remembered too
+    entry = path_cache_lookup(&environ, &error, cache, dirs, "missing");
+    assert_that(entry, is_null);
+    assert_that(cache->misses, is_equal_to(3));
+    assert_that(cache->negative_hits, is_equal_to(1));
+
+    path_cache_clear(&environ, cache);
+    assert_that(cache->count, is_equal_to(0));
+    assert_that(cache->negative_count, is_equal_to(0));
+    assert_that(cache->hits, is_equal_to(1));
+
+    path_cache_destroy(&environ, &cache);
+    assert_that(cache, is_null);
+    remove_file(dir1, "plain");
+    remove_file(dir2, "plain");
+    remove_file(dir2, "tool");
+}
+
+Ensure(path_cache, path_cache_grow)
+{
+    struct path_cache *cache;
+    char *dirs[] = {dir1, NULL};
+    char name[16];
+
+    cache = path_cache_create(&environ, &error);
+    path_cache_validate(&environ, &error, cache, dir1, dirs);
+
+    for(int i = 0; i < PATH_CACHE_INITIAL_BUCKETS * 2; i++)
+    {
+        sprintf(name, "cmd%d", i);
+        make_file(dir1, name, 0755);
+        assert_that(path_cache_lookup(&environ, &error, cache, dirs, name), is_not_null);
+    }
+
+    assert_that(cache->bucket_count, is_greater_than(PATH_CACHE_INITIAL_BUCKETS));
+
+    for(int i = 0; i < PATH_CACHE_INITIAL_BUCKETS * 2; i++)
+    {
+        sprintf(name, "cmd%d", i);
+        assert_that(path_cache_lookup(&environ, &error, cache, dirs, name), is_not_null);
+        remove_file(dir1, name);
+    }
+
+    assert_that(cache->hits, is_equal_to(PATH_CACHE_INITIAL_BUCKETS * 2));
+    path_cache_destroy(&environ, &cache);
+}
+
+Ensure(path_cache, path_cache_max_negative)
+{
+    struct path_cache *cache;
+    char *dirs[] = {dir1, NULL};
+    char name[16];
+
+    cache = path_cache_create(&environ, &error);
+    path_cache_validate(&environ, &error, cache, dir1, dirs);
+
+    for(int i = 0; i < PATH_CACHE_MAX_NEGATIVE + 10; i++)
+    {
+        sprintf(name, "typo%d", i);
+        assert_that(path_cache_lookup(&environ, &error, cache, dirs, name), is_null);
+    }
+
+    assert_that(cache->negative_count, is_equal_to(PATH_CACHE_MAX_NEGATIVE));
+    assert_false(dc_error_has_error(&error));
+    path_cache_destroy(&environ, &cache);
+}
+
+Ensure(path_cache, path_cache_validate)
+{
+    struct path_cache *cache;
+    char *dirs[] = {dir1, dir2, NULL};
+    char path_value[80];
+    char expected[64];
+    struct timespec times[2] = {{0, 0}, {0, 0}};
+
+    sprintf(path_value, "%s:%s", dir1, dir2);
+    make_file(dir2, "tool", 0755);
+    cache = path_cache_create(&environ, &error);
+    assert_true(path_cache_path_changed(&environ, cache, path_value));
+    path_cache_validate(&environ, &error, cache, path_value, dirs);
+    assert_false(path_cache_path_changed(&environ, cache, path_value));
+    path_cache_lookup(&environ, &error, cache, dirs, "tool");
+    assert_that(cache->count, is_equal_to(1));
+
+    // nothing changed
+    path_cache_validate(&environ, &error, cache, path_value, dirs);
+    assert_that(cache->count, is_equal_to(1));
+
+    // a command that was not found is looked for again once it is installed
+    assert_that(path_cache_lookup(&environ, &error, cache, dirs, "later"), is_null);
+    make_file(dir2, "later", 0755);
+    path_cache_validate(&environ, &error, cache, path_value, dirs);
+    sprintf(expected, "%s/later", dir2);
+    assert_that(path_cache_lookup(&environ, &error, cache, dirs, "later")->path, is_equal_to_string(expected));
+    remove_file(dir2, "later");
+
+    // a command shadowing the cached one appears earlier in the path
+    make_file(dir1, "tool", 0755);
+    path_cache_validate(&environ, &error, cache, path_value, dirs);
+    assert_that(cache->count, is_equal_to(0));
+    sprintf(expected, "%s/tool", dir1);
+    assert_that(path_cache_lookup(&environ, &error, cache, dirs, "tool")->path, is_equal_to_string(expected));
+
+    // the mtime is compared, not just moved forward
+    utimensat(AT_FDCWD, dir1, times, 0);
+    path_cache_validate(&environ, &error, cache, path_value, dirs);
+    assert_that(cache->count, is_equal_to(0));
+
+    path_cache_lookup(&environ, &error, cache, dirs, "tool");
+    assert_true(path_cache_path_changed(&environ, cache, dir2));
+    path_cache_validate(&environ, &error, cache, dir2, dirs + 1);
+    assert_that(cache->count, is_equal_to(0));
+
+    assert_true(path_cache_path_changed(&environ, cache, NULL));
+    path_cache_validate(&environ, &error, cache, NULL, NULL);
+    assert_false(path_cache_path_changed(&environ, cache, ""));
+    assert_false(dc_error_has_error(&error));
+
+    path_cache_destroy(&environ, &cache);
+    remove_file(dir1, "tool");
+    remove_file(dir2, "tool");
+}
+
+static void make_file(const char *dir, const char *name, mode_t mode)
+{
+    char path[64];
+    int fd;
+
+    sprintf(path, "%s/%s", dir, name);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    close(fd);
+    chmod(path, mode);
+}
+
+static void remove_file(const char *dir, const char *name)
+{
+    char path[64];
+
+    sprintf(path, "%s/%s", dir, name);
+    unlink(path);
+}
+
+TestSuite *path_cache_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, path_cache, path_cache_lookup);
+    add_test_with_context(suite, path_cache, path_cache_grow);
+    add_test_with_context(suite, path_cache, path_cache_max_negative);
+    add_test_with_context(suite, path_cache, path_cache_validate);
+
+    return suite;
+}
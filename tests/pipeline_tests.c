@@ -0,0 +1,150 @@
+#include "tests.h"
+#include "pipeline.h"
+#include "shell_impl.h"
+#include "command.h"
+#include <unistd.h>
+
+static void test_pipeline(const char *line, bool pipefail, size_t expected_count, int expected_exit_code,
+                          bool expected_exit, const char *expected_out, const char *expected_err);
+
+Describe(pipeline);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+static char out_file[32];
+
+BeforeEach(pipeline)
+{
+    int fd;
+
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+    strcpy(out_file, "/tmp/pipeXXXXXX");
+    fd = mkstemp(out_file);
+    close(fd);
+}
+
+AfterEach(pipeline)
+{
+    unlink(out_file);
+    dc_error_reset(&error);
+}
+
+Ensure(pipeline, pipeline_run)
+{
+    char line[128];
+
+    sprintf(line, "echo hello | tr a-z A-Z > %s", out_file);
+    test_pipeline(line, false, 2, 0, false, "HELLO\n", "");
+
+    sprintf(line, "printf 'b\\na\\nc\\n' | sort | head -2 > %s", out_file);
+    test_pipeline(line, false, 3, 0, false, "a\nb\n", "");
+
+    // every stage runs at the same time, or yes would fill the pipe and never finish
+    sprintf(line, "yes | head -1 > %s", out_file);
+    test_pipeline(line, false, 2, 0, false, "y\n", "");
+
+    sprintf(line, "echo 'a|b' | cat > %s", out_file);
+    test_pipeline(line, false, 2, 0, false, "a|b\n", "");
+
+    test_pipeline("false | true", false, 2, 0, false, "", "");
+    test_pipeline("true | false", false, 2, 1, false, "", "");
+    test_pipeline("true | nosuchcommandxyz", false, 2, 127, false, "", "nosuchcommandxyz: command not found\n");
+    test_pipeline("true | /etc/passwd", false, 2, 126, false, "", "/etc/passwd: Permission denied\n");
+    test_pipeline("exit", false, 1, 0, true, "", "");
+    test_pipeline("true | exit", false, 2, 1, false, "", "exit: cannot run in a pipeline or in the background\n");
+    test_pipeline("cd / | true", false, 2, 0, false, "", "cd: cannot run in a pipeline or in the background\n");
+}
+
+Ensure(pipeline, pipefail)
+{
+    test_pipeline("false | true", true, 2, 1, false, "", "");
+    test_pipeline("sh -c 'exit 3' | sh -c 'exit 4' | true", true, 3, 4, false, "", "");
+    test_pipeline("true | true", true, 2, 0, false, "", "");
+}
+
+Ensure(pipeline, batch_flush)
+{
+    struct state state;
+    char out[64];
+    char line[] = "echo hi";
+
+    memset(out, 0, sizeof(out));
+    memset(&state, 0, sizeof(state));
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = stderr;
+    state.settings.batch = true;
+    init_state(&environ, &error, &state);
+    state.current_line = line;
+    state.current_line_length = strlen(line);
+    separate_commands(&environ, &error, &state);
+    parse_commands(&environ, &error, &state);
+
+    // a builtin that runs in the shell leaves the output buffered, there is no child to go before
+    fputs("before\n", state.stdout);
+    pipeline_run(&environ, &error, &state, state.command, state.command_count, false);
+    assert_false(dc_error_has_error(&error));
+    assert_that(out, is_equal_to_string(""));
+    fflush(state.stdout);
+    assert_that(out, is_equal_to_string("before\nhi\n"));
+
+    fclose(state.stdout);
+    state.current_line = NULL;
+    state.stdout = stdout;
+    destroy_state(&environ, &error, &state);
+}
+
+static void test_pipeline(const char *line, bool pipefail, size_t expected_count, int expected_exit_code,
+                          bool expected_exit, const char *expected_out, const char *expected_err)
+{
+    struct state state;
+    char out[1024];
+    char err[1024];
+    FILE *file;
+    bool exit_shell;
+
+    memset(err, 0, sizeof(err));
+    memset(&state, 0, sizeof(state));
+    state.stdout = stdout;
+    state.stderr = fmemopen(err, sizeof(err), "w");
+    init_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+    state.settings.pipefail = pipefail;
+    state.current_line = strdup(line);
+    state.current_line_length = strlen(line);
+    separate_commands(&environ, &error, &state);
+    parse_commands(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(state.command_count, is_equal_to(expected_count));
+
+    exit_shell = pipeline_run(&environ, &error, &state, state.command, state.command_count, false);
+    fclose(state.stderr);
+    assert_false(dc_error_has_error(&error));
+    assert_that(exit_shell, is_equal_to(expected_exit));
+    assert_that(state.exit_code, is_equal_to(expected_exit_code));
+    assert_that(err, is_equal_to_string(expected_err));
+
+    memset(out, 0, sizeof(out));
+    file = fopen(out_file, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    truncate(out_file, 0);
+    assert_that(out, is_equal_to_string(expected_out));
+
+    free(state.current_line);
+    state.current_line = NULL;
+    state.stderr = stderr;
+    destroy_state(&environ, &error, &state);
+}
+
+TestSuite *pipeline_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, pipeline, pipeline_run);
+    add_test_with_context(suite, pipeline, pipefail);
+    add_test_with_context(suite, pipeline, batch_flush);
+
+    return suite;
+}
@@ -0,0 +1,201 @@
+#include "tests.h"
+#include "jobs.h"
+#include "reactor.h"
+#include "shell.h"
+#include "shell_impl.h"
+#include "state.h"
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+static pid_t start_child(long delay_ms);
+
+Describe(reactor);
+
+static struct dc_posix_env environ;
+static struct dc_error error;
+
+BeforeEach(reactor)
+{
+    dc_posix_env_init(&environ, NULL);
+    dc_error_init(&error, NULL);
+}
+
+AfterEach(reactor)
+{
+    dc_error_reset(&error);
+}
+
+Ensure(reactor, reactor_wait)
+{
+    struct reactor *reactor;
+    struct reactor_event events[REACTOR_MAX_EVENTS];
+    int fds[2];
+
+    reactor = reactor_create(&environ, &error);
+    assert_false(dc_error_has_error(&error));
+    assert_that(pipe(fds), is_equal_to(0));
+
+    reactor_add(&environ, &error, reactor, fds[0], REACTOR_INPUT, -1);
+    assert_false(dc_error_has_error(&error));
+    assert_true(reactor_watches(reactor, fds[0]));
+    assert_false(reactor_watches(reactor, fds[1]));
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, 0), is_equal_to(0));
+
+    assert_that(write(fds[1], "x", 1), is_equal_to(1));
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, -1), is_equal_to(1));
+    assert_that(events[0].source, is_equal_to(REACTOR_INPUT));
+    assert_that(events[0].fd, is_equal_to(fds[0]));
+
+    // a descriptor that was removed is ready but not reported
+    reactor_remove(&environ, reactor, fds[0]);
+    assert_false(reactor_watches(reactor, fds[0]));
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, 0), is_equal_to(0));
+    assert_false(dc_error_has_error(&error));
+
+    close(fds[0]);
+    close(fds[1]);
+    reactor_destroy(&environ, &reactor);
+    assert_that(reactor, is_null);
+}
+
+Ensure(reactor, reactor_watch_signal)
+{
+    struct reactor *reactor;
+    struct reactor_event events[REACTOR_MAX_EVENTS];
+    sigset_t mask;
+
+    reactor = reactor_create(&environ, &error);
+    reactor_watch_signal(&environ, &error, reactor, SIGUSR1);
+    assert_false(dc_error_has_error(&error));
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    assert_that(sigismember(&mask, SIGUSR1), is_equal_to(1));
+
+    raise(SIGUSR1);
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, -1), is_equal_to(1));
+    assert_that(events[0].source, is_equal_to(REACTOR_SIGNAL));
+    assert_that(events[0].signal, is_equal_to(SIGUSR1));
+
+    // the signal was read, and one drained is gone
+    raise(SIGUSR1);
+    reactor_drain_signals(reactor);
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, 0), is_equal_to(0));
+
+    reactor_destroy(&environ, &reactor);
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    assert_that(sigismember(&mask, SIGUSR1), is_equal_to(0));
+}
+
+Ensure(reactor, job_table_watch)
+{
+    struct reactor *reactor;
+    struct job_table *table;
+    struct reactor_event events[REACTOR_MAX_EVENTS];
+    pid_t pids[2];
+    int exit_codes[2] = {0, 0};
+    size_t count;
+    size_t reaped;
+
+    reactor = reactor_create(&environ, &error);
+    table = job_table_create(&environ, &error, 0);
+    job_table_watch(table, reactor);
+    pids[0] = start_child(0);
+    pids[1] = start_child(100);
+    job_table_add(&environ, &error, table, "job", pids, exit_codes, 2, false);
+    assert_false(dc_error_has_error(&error));
+
+    // each stage wakes the reactor for itself, and only it is reaped
+    reaped = 0;
+
+    while(reaped < 2){
+        count = reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, -1);
+        assert_false(dc_error_has_error(&error));
+
+        for(size_t i = 0; i < count; i++){
+            assert_that(events[i].source, is_equal_to(REACTOR_CHILD));
+
+            if(events[i].pid != -1){
+                assert_that(events[i].pid == pids[0] || events[i].pid == pids[1], is_true);
+            }
+
+            reaped += job_table_reap_pid(&environ, &error, table, events[i].pid);
+        }
+    }
+
+    assert_that(job_table_running(table), is_equal_to(0));
+    assert_that(table->jobs[0].exit_codes[0], is_equal_to(0));
+    assert_that(table->jobs[0].exit_codes[1], is_equal_to(1));
+    assert_that(reactor_wait(&environ, &error, reactor, events, REACTOR_MAX_EVENTS, 0), is_equal_to(0));
+
+    job_table_destroy(&environ, &table);
+    reactor_destroy(&environ, &reactor);
+}
+
+Ensure(reactor, wait_for_input)
+{
+    struct state state;
+    char out[1024];
+    int fds[2];
+    int next_state;
+
+    assert_that(pipe(fds), is_equal_to(0));
+    memset(&state, 0, sizeof(state));
+    memset(out, 0, sizeof(out));
+    state.stdin = fdopen(fds[0], "r");
+    state.stdout = fmemopen(out, sizeof(out), "w");
+    state.stderr = stderr;
+    init_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+
+    // nothing to read, the shell waits for the line after the prompt
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(WAIT_FOR_INPUT));
+    assert_that(write(fds[1], "echo a\necho b\n", 14), is_equal_to(14));
+    next_state = wait_for_input(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(SEPARATE_COMMANDS));
+    assert_that(state.current_line, is_equal_to_string("echo a"));
+    reset_state(&environ, &error, &state);
+
+    // the second line was read with the first, it is not waited for
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(SEPARATE_COMMANDS));
+    assert_that(state.current_line, is_equal_to_string("echo b"));
+    reset_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+
+    destroy_state(&environ, &error, &state);
+    fclose(state.stdin);
+    fclose(state.stdout);
+    close(fds[1]);
+}
+
+static pid_t start_child(long delay_ms)
+{
+    pid_t pid;
+
+    pid = fork();
+
+    if(pid == 0){
+        struct timespec delay;
+
+        delay.tv_sec = delay_ms / 1000;
+        delay.tv_nsec = (delay_ms % 1000) * 1000000;
+        nanosleep(&delay, NULL);
+        _exit(delay_ms == 0 ? 0 : 1);
+    }
+
+    return pid;
+}
+
+TestSuite *reactor_tests(void)
+{
+    TestSuite *suite;
+
+    suite = create_test_suite();
+    add_test_with_context(suite, reactor, reactor_wait);
+    add_test_with_context(suite, reactor, reactor_watch_signal);
+    add_test_with_context(suite, reactor, job_table_watch);
+    add_test_with_context(suite, reactor, wait_for_input);
+
+    return suite;
+}
@@ -2,6 +2,7 @@
 #include <dc_util/filesystem.h>
 #include "tests.h"
 #include "util.h"
+#include "input.h"
 #include "shell_impl.h"
 #include "state.h"
 
@@ -12,6 +13,7 @@ static void test_read_commands(const char *command, const char *expected_command
 static void test_separate_commands(const char *command, const char *expected_command, int expected_return);
 static void test_parse_commands(const char *command, const char *expected_command, size_t expected_argc);
 static void test_execute_command(const char *command, int expected_next_state, const char *expected_exit_code, const char *expected_error_message);
+static void test_command_list(const char *line, size_t expected_count, int expected_exit_code, const char *expected_out);
 static void test_handle_error(const char *current_line, bool is_fatal, int expected_error_code, const char *message, const char *expected_error_message, int expected_next_state);
 
 Describe(shell_impl);
@@ -45,6 +47,7 @@ static void test_init_state(const char *expected_prompt, FILE *in, FILE *out, FI
     int next_state;
     long line_length;
 
+    memset(&state, 0, sizeof(state));
     state.stdin  = in;
     state.stdout = out;
     state.stderr = err;
@@ -57,9 +60,6 @@ static void test_init_state(const char *expected_prompt, FILE *in, FILE *out, FI
     assert_that(state.stdin, is_equal_to(in));
     assert_that(state.stdout, is_equal_to(out));
     assert_that(state.stderr, is_equal_to(err));
-    assert_that(state.in_redirect_regex, is_not_null);
-    assert_that(state.out_redirect_regex, is_not_null);
-    assert_that(state.err_redirect_regex, is_not_null);
     assert_that(state.path, is_not_null);
     assert_that(state.prompt, is_equal_to_string(expected_prompt));
     assert_that(state.max_line_length, is_equal_to(line_length));
@@ -80,6 +80,7 @@ static void test_destroy_state(bool initial_fatal)
     struct state state;
     int next_state;
 
+    memset(&state, 0, sizeof(state));
     state.stdin  = stdin;
     state.stdout = stdout;
     state.stderr = stderr;
@@ -92,9 +93,6 @@ static void test_destroy_state(bool initial_fatal)
     assert_that(state.stdin, is_equal_to(stdin));
     assert_that(state.stdout, is_equal_to(stdout));
     assert_that(state.stderr, is_equal_to(stderr));
-    assert_that(state.in_redirect_regex, is_null);
-    assert_that(state.out_redirect_regex, is_null);
-    assert_that(state.err_redirect_regex, is_null);
     assert_that(state.prompt, is_null);
     assert_that(state.path, is_null);
     assert_that(state.max_line_length, is_equal_to(0));
@@ -124,6 +122,7 @@ static void test_reset_state(const char *expected_prompt, bool initial_fatal)
     int next_state;
     long line_length;
 
+    memset(&state, 0, sizeof(state));
     state.stdin  = stdin;
     state.stdout = stdout;
     state.stderr = stderr;
@@ -138,9 +137,6 @@ static void test_reset_state(const char *expected_prompt, bool initial_fatal)
     assert_that(state.stdin, is_equal_to(stdin));
     assert_that(state.stdout, is_equal_to(stdout));
     assert_that(state.stderr, is_equal_to(stderr));
-    assert_that(state.in_redirect_regex, is_not_null);
-    assert_that(state.out_redirect_regex, is_not_null);
-    assert_that(state.err_redirect_regex, is_not_null);
     assert_that(state.prompt, is_equal_to_string(expected_prompt));
     assert_that(state.path, is_not_null);
     assert_that(state.max_line_length, is_equal_to(line_length));
@@ -171,6 +167,7 @@ static void test_read_commands(const char *command, const char *expected_command
     in_buf = strdup(command);
     in = fmemopen(in_buf, strlen(in_buf) + 1, "r");
     out = fmemopen(out_buf, sizeof(out_buf), "w");
+    memset(&state, 0, sizeof(state));
     state.stdin = in;
     state.stdout = out;
     state.stderr = stderr;
@@ -199,6 +196,83 @@ static void test_read_commands(const char *command, const char *expected_command
     free(in_buf);
 }
 
+Ensure(shell_impl, batch)
+{
+    char in_buf[] = "echo a\n";
+    char out_buf[64];
+    struct state state;
+    int next_state;
+
+    memset(&state, 0, sizeof(state));
+    memset(out_buf, 0, sizeof(out_buf));
+    state.stdin = fmemopen(in_buf, strlen(in_buf), "r");
+    state.stdout = fmemopen(out_buf, sizeof(out_buf), "w");
+    state.stderr = stderr;
+    state.settings.batch = true;
+    init_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+
+    // no prompt, so the working directory is never read
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(SEPARATE_COMMANDS));
+    assert_that(state.current_line, is_equal_to_string("echo a"));
+    fflush(state.stdout);
+    assert_that(out_buf, is_equal_to_string(""));
+    assert_that(state.cwd, is_null);
+    reset_state(&environ, &error, &state);
+
+    // the end of the input ends the shell instead of reading empty lines
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(EXIT));
+    assert_false(dc_error_has_error(&error));
+
+    destroy_state(&environ, &error, &state);
+    fclose(state.stdin);
+    fclose(state.stdout);
+}
+
+Ensure(shell_impl, script)
+{
+    char path[] = "/tmp/shell_implXXXXXX";
+    char script[] = "echo a\ncat <<EOF\nbody\nEOF\n";
+    struct state state;
+    int next_state;
+    int fd;
+
+    fd = mkstemp(path);
+    assert_that(write(fd, script, strlen(script)), is_equal_to(strlen(script)));
+    close(fd);
+    memset(&state, 0, sizeof(state));
+    state.stdin = stdin;
+    state.stdout = stdout;
+    state.stderr = stderr;
+    state.settings.batch = true;
+    state.script = script_open(&environ, &error, path);
+    init_state(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+
+    // the lines come from the file, stdin is left for the commands
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(SEPARATE_COMMANDS));
+    assert_that(state.current_line, is_equal_to_string("echo a"));
+    reset_state(&environ, &error, &state);
+
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(SEPARATE_COMMANDS));
+    separate_commands(&environ, &error, &state);
+    parse_commands(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(state.command[0].redirections[0].target, is_equal_to_string("body\n"));
+    reset_state(&environ, &error, &state);
+
+    next_state = read_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(EXIT));
+
+    destroy_state(&environ, &error, &state);
+    script_close(&environ, &state.script);
+    unlink(path);
+}
+
 Ensure(shell_impl, separate_commands)
 {
     test_separate_commands("./a.out", "./a.out", SEPARATE_COMMANDS);
@@ -218,6 +292,7 @@ static void test_separate_commands(const char *command, const char *expected_com
     in_buf = strdup(command);
     in = fmemopen(in_buf, strlen(in_buf) + 1, "r");
     out = fmemopen(out_buf, sizeof(out_buf), "w");
+    memset(&state, 0, sizeof(state));
     state.stdin = in;
     state.stdout = out;
     state.stderr = stderr;
@@ -247,16 +322,14 @@ static void test_separate_commands(const char *command, const char *expected_com
     assert_that(next_state, is_equal_to(PARSE_COMMANDS));
     assert_false(state.fatal_error);
     assert_that(state.command, is_not_null);
+    assert_that(state.command_count, is_equal_to(1));
     assert_that(state.command->line, is_equal_to_string(state.current_line));
     assert_that(state.command->line, is_not_equal_to(state.current_line));
     assert_that(state.command->command, is_null);
     assert_that(state.command->argc, is_equal_to(0));
     assert_that(state.command->argv, is_null);
-    assert_that(state.command->stdin_file, is_null);
-    assert_that(state.command->stdout_file, is_null);
-    assert_false(state.command->stdout_overwrite);
-    assert_that(state.command->stderr_file, is_null);
-    assert_false(state.command->stderr_overwrite);
+    assert_that(state.command->redirections, is_null);
+    assert_that(state.command->redirection_count, is_equal_to(0));
     assert_that(state.command->exit_code, is_equal_to(0));
     fclose(in);
     fclose(out);
@@ -264,6 +337,125 @@ static void test_separate_commands(const char *command, const char *expected_com
     destroy_state(&environ, &error, &state);
 }
 
+Ensure(shell_impl, command_list)
+{
+    test_command_list("echo a; echo b", 2, 0, "a\nb\n");
+    test_command_list("echo a;", 1, 0, "a\n");
+    test_command_list("true && echo a", 2, 0, "a\n");
+    test_command_list("false && echo a", 2, 1, "");
+    test_command_list("false || echo a", 2, 0, "a\n");
+    test_command_list("true || echo a", 2, 0, "");
+    test_command_list("false && echo a || echo b", 3, 0, "b\n");
+    test_command_list("true || echo a && echo b", 3, 0, "b\n");
+    test_command_list("echo a | tr a b >> OUT && echo c; false", 4, 1, "b\nc\n");
+    test_command_list("echo a | false && echo b; echo c | tr c d >> OUT", 5, 0, "d\n");
+    test_command_list("echo 'a;b' \"c&&d\" e\\|f", 1, 0, "a;b c&&d e|f\n");
+}
+
+Ensure(shell_impl, here_documents)
+{
+    struct state state;
+    char input[] = "a\n  b\nEOF\nc\nEND\nd\nEND\nnext line\n";
+    char out_file[32];
+    char line[128];
+    char out[1024];
+    FILE *file;
+    int fd;
+
+    strcpy(out_file, "/tmp/hereXXXXXX");
+    fd = mkstemp(out_file);
+    close(fd);
+    memset(&state, 0, sizeof(state));
+    state.stdin = fmemopen(input, strlen(input), "r");
+    state.stdout = stdout;
+    state.stderr = stderr;
+    init_state(&environ, &error, &state);
+
+    // the bodies follow the line in the order of the <<, the last << of a descriptor wins
+    snprintf(line, sizeof(line), "cat <<EOF >> %s; cat <<END <<'END' | tr a-z A-Z >> %s", out_file, out_file);
+    state.current_line = strdup(line);
+    state.current_line_length = strlen(line);
+    separate_commands(&environ, &error, &state);
+    assert_that(parse_commands(&environ, &error, &state), is_equal_to(EXECUTE_COMMANDS));
+    assert_that(execute_commands(&environ, &error, &state), is_equal_to(RESET_STATE));
+    assert_false(dc_error_has_error(&error));
+
+    memset(out, 0, sizeof(out));
+    file = fopen(out_file, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    unlink(out_file);
+    assert_that(out, is_equal_to_string("a\n  b\nD\n"));
+
+    // the shell reads on after the last body
+    memset(out, 0, sizeof(out));
+    assert_that(fgets(out, sizeof(out), state.stdin), is_not_null);
+    assert_that(out, is_equal_to_string("next line\n"));
+
+    fclose(state.stdin);
+    free(state.current_line);
+    state.current_line = NULL;
+    destroy_state(&environ, &error, &state);
+}
+
+static void test_command_list(const char *line, size_t expected_count, int expected_exit_code, const char *expected_out)
+{
+    struct state state;
+    char out_file[32];
+    char out[1024];
+    const char *file_name;
+    FILE *file;
+    int fd;
+    int next_state;
+
+    strcpy(out_file, "/tmp/listXXXXXX");
+    fd = mkstemp(out_file);
+    close(fd);
+    memset(&state, 0, sizeof(state));
+    state.stdin = stdin;
+    state.stdout = fopen(out_file, "a");
+    state.stderr = stderr;
+    init_state(&environ, &error, &state);
+
+    // OUT in the line is the file, programs append to the file the builtins print to
+    state.current_line = malloc(strlen(line) + sizeof(out_file));
+    file_name = strstr(line, "OUT");
+
+    if(file_name == NULL)
+    {
+        strcpy(state.current_line, line);
+    }
+    else
+    {
+        sprintf(state.current_line, "%.*s%s%s", (int) (file_name - line), line, out_file, file_name + 3);
+    }
+
+    state.current_line_length = strlen(state.current_line);
+    next_state = separate_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(PARSE_COMMANDS));
+    next_state = parse_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(EXECUTE_COMMANDS));
+    assert_that(state.command_count, is_equal_to(expected_count));
+
+    next_state = execute_commands(&environ, &error, &state);
+    assert_that(next_state, is_equal_to(RESET_STATE));
+    assert_false(dc_error_has_error(&error));
+    assert_that(state.exit_code, is_equal_to(expected_exit_code));
+    fclose(state.stdout);
+
+    memset(out, 0, sizeof(out));
+    file = fopen(out_file, "r");
+    fread(out, 1, sizeof(out) - 1, file);
+    fclose(file);
+    unlink(out_file);
+    assert_that(out, is_equal_to_string(expected_out));
+
+    free(state.current_line);
+    state.current_line = NULL;
+    state.stdout = stdout;
+    destroy_state(&environ, &error, &state);
+}
+
 Ensure(shell_impl, parse_commands)
 {
     test_parse_commands("hello\n", "hello", 1);
@@ -282,6 +474,7 @@ static void test_parse_commands(const char *command, const char *expected_comman
     in_buf = strdup(command);
     in = fmemopen(in_buf, strlen(in_buf) + 1, "r");
     out = fmemopen(out_buf, sizeof(out_buf), "w");
+    memset(&state, 0, sizeof(state));
     state.stdin = in;
     state.stdout = out;
     state.stderr = stderr;
@@ -347,6 +540,7 @@ static void test_execute_command(const char *command, int expected_next_state, c
     in = fmemopen(in_buf, strlen(in_buf) + 1, "r");
     out = fmemopen(out_buf, sizeof(out_buf), "w");
     err = fmemopen(err_buf, sizeof(out_buf), "w");
+    memset(&state, 0, sizeof(state));
     state.stdin = in;
     state.stdout = out;
     state.stderr = err;
@@ -391,6 +585,7 @@ Ensure(shell_impl, do_exit)
     struct state state;
     int next_state;
 
+    memset(&state, 0, sizeof(state));
     next_state = init_state(&environ, &error, &state);
     assert_false(dc_error_has_error(&error));
     assert_false(state.fatal_error);
@@ -427,6 +622,7 @@ static void test_handle_error(const char *current_line, bool is_fatal, int expec
     memset(err_buf, 0, sizeof(err_buf));
     out_file = fmemopen(out_buf, sizeof(out_buf), "w");
     err_file = fmemopen(err_buf, sizeof(err_buf), "w");
+    memset(&state, 0, sizeof(state));
     state.stdout = out_file;
     state.stderr = err_file;
     init_state(&environ, &error, &state);
@@ -459,8 +655,12 @@ TestSuite *shell_impl_tests(void)
 
     suite = create_test_suite();
     add_test_with_context(suite, shell_impl, init_state);
-//    add_test_with_context(suite, shell_impl, destroy_state);
-//    add_test_with_context(suite, shell_impl, reset_state);
+    add_test_with_context(suite, shell_impl, destroy_state);
+    add_test_with_context(suite, shell_impl, reset_state);
+    add_test_with_context(suite, shell_impl, command_list);
+    add_test_with_context(suite, shell_impl, here_documents);
+    add_test_with_context(suite, shell_impl, batch);
+    add_test_with_context(suite, shell_impl, script);
 //    add_test_with_context(suite, shell_impl, read_commands);
 //    add_test_with_context(suite, shell_impl, separate_commands);
 //    add_test_with_context(suite, shell_impl, parse_commands);
@@ -4,10 +4,17 @@
 
 #include <cgreen/cgreen.h>
 
+TestSuite *arena_tests(void);
 TestSuite *builtin_tests(void);
 TestSuite *command_tests(void);
 TestSuite *execute_tests(void);
 TestSuite *input_tests(void);
+TestSuite *jobs_tests(void);
+TestSuite *lexer_tests(void);
+TestSuite *parallel_tests(void);
+TestSuite *path_cache_tests(void);
+TestSuite *pipeline_tests(void);
+TestSuite *reactor_tests(void);
 TestSuite *shell_impl_tests(void);
 TestSuite *shell_tests(void);
 TestSuite *util_tests(void);
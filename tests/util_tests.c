@@ -2,7 +2,10 @@
 #include "util.h"
 #include "command.h"
 #include "state.h"
+#include "arena.h"
+#include <dc_util/filesystem.h>
 #include <dc_util/strings.h>
+#include <unistd.h>
 
 static void check_state_reset(const struct dc_error *error, const struct state *state, FILE *in, FILE *out, FILE *err);
 static void test_parse_path(const char *path_str, char **dirs);
@@ -100,13 +103,12 @@ static void test_parse_path(const char *path_str, char **dirs)
 Ensure(util, do_reset_state)
 {
     struct state state;
+    char message[128];
+    FILE *stderr_file;
 
     state.stdin = stdin;
     state.stdout = stdout;
     state.stderr = stderr;
-    state.in_redirect_regex = NULL;
-    state.out_redirect_regex = NULL;
-    state.err_redirect_regex = NULL;
     state.path = NULL;
     state.prompt = NULL;
     state.max_line_length = 0;
@@ -114,6 +116,8 @@ Ensure(util, do_reset_state)
     state.current_line_length = 0;
     state.command = NULL;
     state.fatal_error = false;
+    state.arena = NULL;
+    state.settings.verbose = false;
 
     do_reset_state(&environ, &error, &state);
     check_state_reset(&error, &state, stdin, stdout, stderr);
@@ -141,6 +145,24 @@ Ensure(util, do_reset_state)
     state.fatal_error = true;
     do_reset_state(&environ, &error, &state);
     check_state_reset(&error, &state, stdin, stdout, stderr);
+
+    // verbose reports the arena use of the line
+    memset(message, 0, sizeof(message));
+    stderr_file = fmemopen(message, sizeof(message), "w");
+    state.stderr = stderr_file;
+    state.settings.verbose = true;
+    state.arena = arena_create(&environ, &error, 0);
+    arena_alloc(&environ, &error, state.arena, 64);
+    do_reset_state(&environ, &error, &state);
+    arena_alloc(&environ, &error, state.arena, 32);
+    do_reset_state(&environ, &error, &state);
+    do_reset_state(&environ, &error, &state);
+    fflush(stderr_file);
+    assert_that(message, is_equal_to_string("arena: 64 bytes, high water mark 64 bytes\n"
+                                            "arena: 32 bytes, high water mark 64 bytes\n"));
+    check_state_reset(&error, &state, stdin, stdout, stderr_file);
+    arena_destroy(&environ, &state.arena);
+    fclose(stderr_file);
 }
 
 static void check_state_reset(const struct dc_error *error, const struct state *state, FILE *in, FILE *out, FILE *err)
@@ -166,18 +188,19 @@ static void check_state_reset(const struct dc_error *error, const struct state *
 Ensure(util, state_to_string)
 {
     struct state state;
+    int fds[] = {3, 10};
     char *str;
 
-    state.in_redirect_regex = NULL;
-    state.out_redirect_regex = NULL;
-    state.err_redirect_regex = NULL;
     state.path = NULL;
     state.prompt = NULL;
     state.max_line_length = 0;
     state.current_line = NULL;
     state.current_line_length = 0;
     state.command = NULL;
+    state.fds = NULL;
+    state.fd_count = 0;
     state.fatal_error = false;
+    state.arena = NULL;
 
     state.fatal_error = false;
     state.current_line = NULL;
@@ -216,6 +239,55 @@ Ensure(util, state_to_string)
     assert_that(str, is_equal_to_string("current_line = \"world\", fatal_error = 1"));
     free(str);
     free(state.current_line);
+
+    // the descriptors exec redirected are only listed when there are some
+    state.fds = fds;
+    state.fd_count = 2;
+    state.current_line = NULL;
+    str = state_to_string(&environ, &error, &state);
+    assert_that(str, is_equal_to_string("current_line = NULL, fatal_error = 1, fds = [3, 10]"));
+    free(str);
+
+    // the high-water mark is the biggest line, not the last one
+    state.fds = NULL;
+    state.fd_count = 0;
+    state.arena = arena_create(&environ, &error, 0);
+    arena_alloc(&environ, &error, state.arena, 64);
+    arena_reset(&environ, state.arena);
+    arena_alloc(&environ, &error, state.arena, 16);
+    str = state_to_string(&environ, &error, &state);
+    assert_that(str, is_equal_to_string("current_line = NULL, fatal_error = 1, arena_high_water_mark = 64"));
+    free(str);
+    arena_destroy(&environ, &state.arena);
+}
+
+Ensure(util, current_directory)
+{
+    struct state state;
+    const char *cwd;
+    char *expected;
+
+    memset(&state, 0, sizeof(state));
+    state.cwd_fd = -1;
+    chdir("/tmp");
+    expected = dc_get_working_dir(&environ, &error);
+    cwd = current_directory(&environ, &error, &state);
+    assert_false(dc_error_has_error(&error));
+    assert_that(cwd, is_equal_to_string(expected));
+    assert_that(state.cwd_fd, is_greater_than(2));
+
+    // the same directory is not read again
+    assert_that(current_directory(&environ, &error, &state), is_equal_to(cwd));
+
+    // a chdir behind the back of the state is noticed
+    chdir("/");
+    assert_that(current_directory(&environ, &error, &state), is_equal_to_string("/"));
+
+    forget_current_directory(&environ, &state);
+    assert_that(state.cwd, is_null);
+    assert_that(state.cwd_fd, is_equal_to(-1));
+    chdir("/tmp");
+    free(expected);
 }
 
 TestSuite *util_tests(void)
@@ -228,6 +300,7 @@ TestSuite *util_tests(void)
     add_test_with_context(suite, util, parse_path);
     add_test_with_context(suite, util, do_reset_state);
     add_test_with_context(suite, util, state_to_string);
+    add_test_with_context(suite, util, current_directory);
 
     return suite;
 }